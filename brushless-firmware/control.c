@@ -0,0 +1,388 @@
+//--------------------------------------------------------------------------
+// bibliotecas
+#include "control.h"
+#include "filter.h"
+
+//--------------------------------------------------------------------------
+// media exponencial movel (pulso do PID)
+#define NM 20.0f // numero de medias
+#define ALPHA NM/(NM+1) // coeficiente exponencial
+
+// controlador PID
+#define TUNER
+// PID TUNER
+#ifdef TUNER
+#define Ts 10e-3
+#define KP (0.081f)*50
+#define KI (0.2399f*Ts)*145
+#define KD (0.0068371f/Ts)*165
+#else
+// Ziegler Nichols
+#define KP 0.5002f
+#define KI 0.0548f
+#define KD 2.2811f
+#endif
+
+// preditor de Smith
+// modelo da planta sem atraso: dois polos reais em cascata (s = -5,055 e
+// s = -6,477, raizes de 0.03054 s^2 + 0.3522 s + 1), discretizados em Ts
+// como x += (u - x)*(1 - exp(-Ts/tau)), em ponto fixo Q16
+#define SMITHC1 3231 // (1 - exp(-10ms/197,8ms)) * 2^16
+#define SMITHC2 4110 // (1 - exp(-10ms/154,4ms)) * 2^16
+// ganho incremental do ESC+motor: (6500-1250)rpm / (1600-1200)us = 13,125
+#define SMITHGAIN 210 // rpm/us em Q4
+#define SMITHQ 4 // estados do modelo em rpm Q4
+#define SMITHDELAY 7 // exp(-0.0665*s) ~ 7 amostras de 10ms
+#define SMITHMAXDELAY 15 // tamanho da linha de atraso
+// PI-D sobre a realimentacao predita (us/rpm, por amostra)
+#define SMITHKP 0.0275f
+#define SMITHKI 0.0018f
+#define SMITHKD 0.025f
+
+// anti-windup
+#define AWKB 0.25f // ganho de back-calculation (por amostra)
+#define INTLIMIT ((int32_t)(SERVOMAXPULSE-SERVOSTOPPULSE)<<8) // termo integral (us Q8)
+
+//--------------------------------------------------------------------------
+volatile uint8_t controlMode = CONTROL_PID;
+static volatile uint8_t smithDelay = SMITHDELAY; // atraso do modelo, em amostras
+static volatile uint16_t controlGain = 100; // escala dos ganhos, em %
+static volatile uint8_t windupMode = WINDUP_AUTO; // anti-windup (comando 'w')
+
+static Filter rpmFilter; // banco de filtros da velocidade (filter.c)
+static int16_t rpm = 0; // velocidade em RPM (filtrada)
+static int16_t difRPM = 0; // derivada da velocidade
+static int32_t intTerm = 0; // termo integral KI*integral do erro (us Q8)
+static int16_t pulseMME[2] = {0}; // pulso (media exp movel)
+static int16_t pulseOut = SERVOSTOPPULSE; // ultimo pulso aplicado (limitado)
+static int16_t pulseExcess = 0; // ultimo pulso aplicado - calculado
+
+// preditor de Smith
+static int32_t smithX1 = 0; // 1o polo (rpm Q4)
+static int32_t smithX2 = 0; // 2o polo = saida do modelo sem atraso (rpm Q4)
+static int16_t smithLine[SMITHMAXDELAY] = {0}; // linha de atraso (rpm)
+static uint8_t smithIdx = 0;
+static Filter smithFilter; // mesmo banco da medida, no modelo atrasado
+static int16_t smithFeedback = 0; // realimentacao predita (rpm)
+
+static int16_t smith_step(uint16_t setPoint);
+static int16_t smith_update(int16_t pulse);
+static void smith_seed();
+static void integrate(int16_t error, uint16_t setPoint, float ki);
+static int16_t saturate(int32_t pulse);
+static uint8_t windup();
+
+//==========================================================================
+// CONTROL RESET
+// funcao: zera os estados do filtro, do controlador e do preditor
+// retorno: nenhum
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+void control_reset(){
+    filter_reset(&rpmFilter);
+    rpm = 0;
+    difRPM = 0;
+    intTerm = 0;
+    pulseMME[0] = pulseMME[1] = 0;
+    pulseOut = SERVOSTOPPULSE;
+    pulseExcess = 0;
+
+    smithX1 = smithX2 = 0;
+    for(uint8_t j=0; j<SMITHMAXDELAY; j++){
+        smithLine[j] = 0;
+    }
+    smithIdx = 0;
+    filter_reset(&smithFilter);
+    smithFeedback = 0;
+}
+
+//==========================================================================
+// CONTROL FILTER
+// funcao: filtra a velocidade instantanea (banco de filtros, filter.c) e
+//         calcula a derivada
+// retorno: velocidade filtrada, em rpm (uint16_t)
+// parametros: velocidade instantanea, em rpm (uint16_t)
+// constantes: nenhuma
+//==========================================================================
+uint16_t control_filter(uint16_t rpmInst){
+    // bordas muito proximas do tacometro: satura, a mediana rejeita
+    if(INT16_MAX < rpmInst){
+        rpmInst = INT16_MAX;
+    }
+
+    rpm = filter_run(&rpmFilter, rpmInst);
+    difRPM = filter_derivative(&rpmFilter);
+
+    return (0 > rpm)?0:rpm;
+}
+
+//==========================================================================
+// CONTROL DERIVATIVE
+// funcao: derivada da velocidade usada pelo PID (ultima amostra filtrada)
+// retorno: derivada, em rpm/amostra (int16_t)
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+int16_t control_derivative(){
+    return difRPM;
+}
+
+//==========================================================================
+// CONTROL STEP
+// funcao: calcula o pulso do controlador para a amostra atual. Deve ser
+//         chamada apos control_filter
+// retorno: pulso, em us, limitado a SERVOMINPULSE..SERVOMAXPULSE (int16_t)
+// parametros: velocidade desejada, em rpm (uint16_t)
+// constantes:
+//      KP, KI, KD: ganhos do PID
+//==========================================================================
+int16_t control_step(uint16_t setPoint){
+    if(CONTROL_SMITH == controlMode){
+        return smith_step(setPoint);
+    }
+
+    float gain = controlGain/100.0f;
+
+    int16_t error = setPoint - rpm; // erro
+
+    integrate(error, setPoint, gain*KI);
+
+    // calcula o pulso
+    int32_t pulse = (int32_t)(gain*(
+                                    error*KP +
+                                    -difRPM*KD) +
+                                    (intTerm>>8) +
+                                    SERVOSTOPPULSE);
+
+    // media movel exponencial
+    int32_t raw = ALPHA*pulseMME[0]+(1-ALPHA)*pulse;
+    pulseOut = saturate(raw);
+    pulseExcess = pulseOut - raw;
+
+    // no esquema original (w0) a media continua acumulando fora dos limites
+    pulseMME[1] = (WINDUP_RESET == windup())?(int16_t)raw:pulseOut;
+    pulseMME[0] = pulseMME[1];
+
+    return pulseOut;
+}
+
+//==========================================================================
+// CONTROL COMMAND
+// funcao: aplica um comando de configuracao recebido pela serial
+//         "m0": PID, "m1": PI-D com preditor de Smith (na troca o modelo,
+//               smith_seed, e a integral partem do pulso atual)
+//         "dN": atraso do modelo de Smith, em amostras (d0: sem predicao)
+//         "gN": escala dos ganhos do controlador, em %
+//         "wN": anti-windup (w0: zera fora de 10%, w1: integracao
+//               condicional, w2: back-calculation, w3: padrao, w2)
+//         demais comandos vao para o banco de filtros (filter_command)
+// retorno: true se o comando foi aceito (bool)
+// parametros: comando (char), valor (int16_t)
+// constantes:
+//      SMITHMAXDELAY: maior atraso aceito
+//==========================================================================
+bool control_command(char cmd, int16_t val){
+    switch(cmd){
+        case 'm':
+            if(CONTROL_PID != val && CONTROL_SMITH != val){
+                return false;
+            }
+            if(controlMode != val){
+                // troca sem salto: o modo novo parte do pulso e da
+                // velocidade atuais (o modelo e a media do pulso ficaram
+                // parados no outro modo) e a integral sustenta o pulso
+                smith_seed();
+                pulseMME[0] = pulseMME[1] = pulseOut;
+                intTerm = ((int32_t)(pulseOut - SERVOSTOPPULSE))<<8;
+            }
+            controlMode = val;
+            return true;
+        case 'd':
+            if(0 > val || SMITHMAXDELAY < val){
+                return false;
+            }
+            smithDelay = val;
+            return true;
+        case 'g':
+            if(0 >= val || 1000 < val){
+                return false;
+            }
+            controlGain = val;
+            return true;
+        case 'w':
+            if(WINDUP_RESET > val || WINDUP_AUTO < val){
+                return false;
+            }
+            windupMode = val;
+            return true;
+        default:
+            return filter_command(cmd, val);
+    }
+}
+
+//==========================================================================
+// SMITH STEP
+// funcao: PI-D sobre a velocidade predita sem atraso
+// retorno: pulso, em us, limitado a SERVOMINPULSE..SERVOMAXPULSE (int16_t)
+// parametros: velocidade desejada, em rpm (uint16_t)
+// constantes:
+//      SMITHKP, SMITHKI, SMITHKD: ganhos do PI-D
+//==========================================================================
+static int16_t smith_step(uint16_t setPoint){
+    float gain = controlGain/100.0f;
+
+    // realimentacao = medida + (modelo sem atraso - modelo atrasado)
+    int16_t lastFeedback = smithFeedback;
+    smithFeedback = rpm + smith_update(pulseOut);
+
+    int16_t error = setPoint - smithFeedback;
+
+    integrate(error, setPoint, gain*SMITHKI);
+
+    int32_t raw = (int32_t)(gain*(
+                                error*SMITHKP +
+                                -(smithFeedback - lastFeedback)*SMITHKD) +
+                                (intTerm>>8) +
+                                SERVOSTOPPULSE);
+
+    pulseOut = saturate(raw);
+    pulseExcess = pulseOut - raw;
+
+    return pulseOut;
+}
+
+//==========================================================================
+// SMITH SEED
+// funcao: poe o modelo do preditor em regime no ultimo pulso: os dois
+//         polos, a linha de atraso e o banco de filtros do modelo atrasado
+//         na resposta do modelo a esse pulso, e a realimentacao predita na
+//         velocidade medida (sem salto na derivada)
+// retorno: nenhum
+// parametros: nenhum
+// constantes:
+//      SMITHGAIN: ganho do modelo (rpm/us Q4)
+//      SMITHQ: ponto fixo dos estados do modelo
+//==========================================================================
+static void smith_seed(){
+    smithX1 = smithX2 = (int32_t)(pulseOut - SERVOSTOPPULSE)*SMITHGAIN;
+
+    int16_t out = smithX2>>SMITHQ;
+    for(uint8_t j=0; j<SMITHMAXDELAY; j++){
+        smithLine[j] = out;
+    }
+    smithIdx = 0;
+    filter_seed(&smithFilter, out);
+    smithFeedback = rpm;
+}
+
+//==========================================================================
+// INTEGRATE
+// funcao: acumula o termo integral com o anti-windup selecionado. A soma
+//         satura em +-INTLIMIT, nunca estoura
+// retorno: nenhum
+// parametros: erro (int16_t), set-point (uint16_t), ganho integral (float)
+// constantes:
+//      AWKB: ganho de back-calculation
+//      INTLIMIT: limite do termo integral (faixa util do pulso)
+//==========================================================================
+static void integrate(int16_t error, uint16_t setPoint, float ki){
+    int32_t inc = (int32_t)(256*ki*error);
+
+    switch(windup()){
+        case WINDUP_RESET:
+            // limita a integral do erro em 10%
+            if(error > (0.1f*setPoint) || error < (-0.1f*setPoint)){
+                intTerm = 0;
+                return;
+            }
+            break;
+        case WINDUP_CONDITIONAL:
+            // nao integra se o ultimo pulso saturou no sentido do erro
+            if((0 > pulseExcess && 0 < error) || (0 < pulseExcess && 0 > error)){
+                return;
+            }
+            break;
+        default: // WINDUP_BACKCALC
+            // descarrega a integral pelo excesso do ultimo pulso
+            inc += (int32_t)(256*AWKB*pulseExcess);
+            break;
+    }
+
+    // soma saturada
+    if(0 < inc && intTerm > INTLIMIT - inc){
+        intTerm = INTLIMIT;
+    }else if(0 > inc && intTerm < -INTLIMIT - inc){
+        intTerm = -INTLIMIT;
+    }else{
+        intTerm += inc;
+    }
+}
+
+//==========================================================================
+// WINDUP
+// funcao: anti-windup em uso. WINDUP_AUTO usa back-calculation nos dois
+//         modos; o esquema original (zera fora de 10%) so com "w0". No
+//         simulador, m0 -a 2000 -b 5000 -l 1000: IAE 4032 -> 2635 e queda
+//         com carga 1985 -> 1587 rpm
+// retorno: WINDUP_RESET, WINDUP_CONDITIONAL ou WINDUP_BACKCALC (uint8_t)
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+static uint8_t windup(){
+    if(WINDUP_AUTO == windupMode){
+        return WINDUP_BACKCALC;
+    }
+    return windupMode;
+}
+
+//==========================================================================
+// SATURATE
+// funcao: limita o pulso
+// retorno: pulso, em us (int16_t)
+// parametros: pulso calculado, em us (int32_t)
+// constantes:
+//      SERVOMAXPULSE: limite superior
+//      SERVOMINPULSE: limite para comecar a rodar
+//==========================================================================
+static int16_t saturate(int32_t pulse){
+    if(SERVOMAXPULSE < pulse){
+        return SERVOMAXPULSE;
+    }else if(SERVOMINPULSE > pulse){
+        return SERVOMINPULSE;
+    }
+    return pulse;
+}
+
+//==========================================================================
+// SMITH UPDATE
+// funcao: avanca o modelo da planta e a linha de atraso. A saida atrasada
+//         passa pelo mesmo banco de filtros da medida, assim a correcao
+//         remove da malha tanto o atraso quanto o atraso do filtro
+// retorno: correcao do preditor (modelo sem atraso - modelo atrasado),
+//          em rpm (int16_t)
+// parametros: pulso aplicado, em us (int16_t)
+// constantes:
+//      SMITHC1, SMITHC2, SMITHGAIN, SMITHQ: modelo discreto (ponto fixo)
+//==========================================================================
+static int16_t smith_update(int16_t pulse){
+    int32_t u = (int32_t)(pulse - SERVOSTOPPULSE)*SMITHGAIN;
+
+    smithX1 += ((u - smithX1)*SMITHC1)>>16;
+    smithX2 += ((smithX1 - smithX2)*SMITHC2)>>16;
+
+    int16_t undelayed = smithX2>>SMITHQ;
+    if(0 == smithDelay){
+        return 0; // sem predicao: PI-D direto sobre a medida
+    }
+
+    // linha de atraso circular de smithDelay amostras
+    if(smithIdx >= smithDelay){
+        smithIdx = 0;
+    }
+    int16_t delayed = smithLine[smithIdx];
+    smithLine[smithIdx] = undelayed;
+    smithIdx++;
+
+    return undelayed - filter_run(&smithFilter, delayed);
+}
@@ -0,0 +1,34 @@
+#ifndef _CONTROL_H_
+#define _CONTROL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// servo
+#define SERVOMINPULSE 1200 // aprox 1250 rpm
+#define SERVOSTOPPULSE 1000 // 1ms
+#define SERVOMAXPULSE 1600 // aprox 6500 rpm
+
+// intervalo de velocidade
+#define RPMMAX 6000
+#define RPMMIN 2000
+
+// modos do controlador (comando 'm' pela serial)
+#define CONTROL_PID 0 // PID direto sobre a velocidade medida
+#define CONTROL_SMITH 1 // PI-D + preditor de Smith (compensa o atraso da planta)
+
+// anti-windup (comando 'w' pela serial)
+#define WINDUP_RESET 0 // zera a integral se o erro passar de 10% (original)
+#define WINDUP_CONDITIONAL 1 // nao integra enquanto o pulso satura
+#define WINDUP_BACKCALC 2 // descarrega a integral pelo excesso do pulso
+#define WINDUP_AUTO 3 // padrao: WINDUP_BACKCALC nos dois modos
+
+void control_reset();
+uint16_t control_filter(uint16_t rpmInst);
+int16_t control_derivative();
+int16_t control_step(uint16_t setPoint);
+bool control_command(char cmd, int16_t val);
+
+extern volatile uint8_t controlMode;
+
+#endif
@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------
+// bibliotecas
+#include "filter.h"
+
+//--------------------------------------------------------------------------
+// Butterworth 2a ordem, fs = 100Hz (bilinear), coeficientes em Q14
+// y = b0*(x + 2*x1 + x2) - a1*y1 - a2*y2, a2 ajustado para ganho DC = 1
+typedef struct{
+    uint8_t fc; // frequencia de corte (Hz)
+    int16_t b0, a1, a2;
+}Biquad;
+
+static const Biquad biquadTable[] = {
+    { 2,   59, -29863, 13715},
+    { 3,  128, -28422, 12550},
+    { 5,  329, -25576, 10508},
+    { 8,  756, -21419,  8059},
+    {10, 1105, -18727,  6763},
+    {15, 2148, -12252,  4460},
+    {20, 3384,  -6054,  3206},
+};
+
+#define FILTERNM 20 // media exponencial: numero de medias (original)
+
+//--------------------------------------------------------------------------
+static volatile uint8_t medianSize = 1; // janela da mediana (1: desligada)
+static volatile uint8_t iirMode = FILTER_EMA;
+static volatile uint16_t emaBeta = 32768/(FILTERNM+1); // 1 - ALPHA (Q15)
+static volatile uint8_t biquadIdx = 2; // 5Hz
+static volatile uint16_t difBeta = 0; // derivada (Q15, 0: diferenca da saida)
+
+static int16_t median(Filter* f, int16_t x);
+static int16_t iir(Filter* f, int16_t x);
+
+//==========================================================================
+// FILTER RESET
+// funcao: zera os estados de um banco de filtros
+// retorno: nenhum
+// parametros: banco de filtros (Filter*)
+// constantes: FILTERMAXMEDIAN
+//==========================================================================
+void filter_reset(Filter* f){
+    for(uint8_t j=0; j<FILTERMAXMEDIAN; j++){
+        f->window[j] = 0;
+    }
+    f->idx = 0;
+    f->ema = 0;
+    f->x1 = f->x2 = 0;
+    f->y1 = f->y2 = 0;
+    f->last = 0;
+    f->lastMedian = 0;
+    f->dif = 0;
+}
+
+//==========================================================================
+// FILTER SEED
+// funcao: poe um banco de filtros em regime numa entrada constante, como
+//         se x viesse chegando ha muito tempo (saida x, derivada 0)
+// retorno: nenhum
+// parametros: banco de filtros (Filter*), amostra, em rpm (int16_t)
+// constantes: FILTERMAXMEDIAN
+//==========================================================================
+void filter_seed(Filter* f, int16_t x){
+    for(uint8_t j=0; j<FILTERMAXMEDIAN; j++){
+        f->window[j] = x;
+    }
+    f->idx = 0;
+    f->ema = ((int32_t)x)<<4;
+    f->x1 = f->x2 = x;
+    f->y1 = f->y2 = ((int32_t)x)<<2;
+    f->last = x;
+    f->lastMedian = x;
+    f->dif = 0;
+}
+
+//==========================================================================
+// FILTER RUN
+// funcao: passa uma amostra pela mediana (rejeita bordas falsas do
+//         tacometro) e pelo IIR selecionado. A derivada e filtrada
+//         separadamente, a partir da saida da mediana
+// retorno: amostra filtrada, em rpm (int16_t)
+// parametros: banco de filtros (Filter*), amostra, em rpm (int16_t)
+// constantes: nenhuma
+//==========================================================================
+int16_t filter_run(Filter* f, int16_t x){
+    int16_t m = median(f, x);
+    int16_t y = iir(f, m);
+
+    if(difBeta){
+        // media exponencial da diferenca (rpm/amostra Q4); o produto passa
+        // de 32 bits, diferenca Q4 de ate 2^21 vezes difBeta de ate 2^14
+        f->dif += (int32_t)(((int64_t)((((int32_t)m - f->lastMedian)<<4) - f->dif)*difBeta)>>15);
+    }else{
+        // derivada da saida do banco (original)
+        f->dif = ((int32_t)(y - f->last))<<4;
+    }
+
+    f->lastMedian = m;
+    f->last = y;
+    return y;
+}
+
+//==========================================================================
+// FILTER DERIVATIVE
+// funcao: derivada filtrada da ultima amostra
+// retorno: derivada, em rpm/amostra (int16_t)
+// parametros: banco de filtros (const Filter*)
+// constantes: nenhuma
+//==========================================================================
+int16_t filter_derivative(const Filter* f){
+    return f->dif>>4;
+}
+
+//==========================================================================
+// FILTER COMMAND
+// funcao: configura o banco de filtros pela serial
+//         "nN": janela da mediana (1, 3, 5 ou 7; n1 desliga)
+//         "fN": IIR (f0: nenhum, f1: media exponencial, f2: biquad)
+//         "aN": media exponencial de N medias, ALPHA = N/(N+1)
+//         "cN": corte do biquad, em Hz (2, 3, 5, 8, 10, 15 ou 20)
+//         "eN": derivada filtrada por N medias (e0: diferenca da saida)
+// retorno: true se o comando foi aceito (bool)
+// parametros: comando (char), valor (int16_t)
+// constantes: FILTERMAXMEDIAN
+//==========================================================================
+bool filter_command(char cmd, int16_t val){
+    switch(cmd){
+        case 'n':
+            if(1 > val || FILTERMAXMEDIAN < val || !(val & 1)){
+                return false;
+            }
+            medianSize = val;
+            return true;
+        case 'f':
+            if(FILTER_NONE > val || FILTER_BIQUAD < val){
+                return false;
+            }
+            iirMode = val;
+            return true;
+        case 'a':
+            if(1 > val || 255 < val){
+                return false;
+            }
+            emaBeta = 32768/(val+1);
+            return true;
+        case 'c':
+            for(uint8_t j=0; j<sizeof(biquadTable)/sizeof(*biquadTable); j++){
+                if(biquadTable[j].fc == val){
+                    biquadIdx = j;
+                    return true;
+                }
+            }
+            return false;
+        case 'e':
+            if(0 > val || 255 < val){
+                return false;
+            }
+            difBeta = val?(32768/(val+1)):0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+//==========================================================================
+// MEDIAN
+// funcao: mediana das ultimas medianSize amostras (ordenacao por insercao)
+// retorno: mediana, em rpm (int16_t)
+// parametros: banco de filtros (Filter*), amostra, em rpm (int16_t)
+// constantes: FILTERMAXMEDIAN
+//==========================================================================
+static int16_t median(Filter* f, int16_t x){
+    f->window[f->idx] = x;
+    if(++f->idx >= FILTERMAXMEDIAN){
+        f->idx = 0;
+    }
+
+    if(medianSize <= 1){
+        return x;
+    }
+
+    // copia as medianSize amostras mais recentes, ordenando
+    int16_t sorted[FILTERMAXMEDIAN];
+    uint8_t k = f->idx;
+    for(uint8_t j=0; j<medianSize; j++){
+        k = k?(k-1):(FILTERMAXMEDIAN-1);
+        int16_t v = f->window[k];
+        uint8_t i = j;
+        while(i && sorted[i-1] > v){
+            sorted[i] = sorted[i-1];
+            i--;
+        }
+        sorted[i] = v;
+    }
+
+    return sorted[medianSize>>1];
+}
+
+//==========================================================================
+// IIR
+// funcao: aplica o filtro IIR selecionado
+// retorno: amostra filtrada, em rpm (int16_t)
+// parametros: banco de filtros (Filter*), amostra, em rpm (int16_t)
+// constantes: nenhuma
+//==========================================================================
+static int16_t iir(Filter* f, int16_t x){
+    int32_t y;
+
+    switch(iirMode){
+        case FILTER_EMA:
+            // produto em 64 bits: diferenca Q4 de ate 2^20 vezes emaBeta
+            f->ema += (int32_t)(((int64_t)((((int32_t)x)<<4) - f->ema)*emaBeta)>>15);
+            return f->ema>>4;
+        case FILTER_BIQUAD:{
+            const Biquad* c = &biquadTable[biquadIdx];
+            // x1 e x2 em 32 bits antes da soma (int de 16 bits no MSP430);
+            // a1*y1 passa de 32 bits acima de ~18000rpm, soma em 64 bits
+            y = (int32_t)(((int64_t)c->b0*((int32_t)x + 2*(int32_t)f->x1 + (int32_t)f->x2)*4
+                           - (int64_t)c->a1*f->y1
+                           - (int64_t)c->a2*f->y2 + 8192)>>14);
+            f->x2 = f->x1;
+            f->x1 = x;
+            f->y2 = f->y1;
+            f->y1 = y;
+            return y>>2;
+        }
+        default: // FILTER_NONE
+            return x;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FILTERMAXMEDIAN 7 // maior janela da mediana
+
+// filtro IIR (comando 'f' pela serial)
+#define FILTER_NONE 0 // sem filtro
+#define FILTER_EMA 1 // media exponencial movel (1a ordem)
+#define FILTER_BIQUAD 2 // Butterworth passa-baixas de 2a ordem
+
+// estados de um banco de filtros (mediana -> IIR, derivada em paralelo)
+typedef struct{
+    int16_t window[FILTERMAXMEDIAN]; // ultimas amostras (mediana)
+    uint8_t idx;
+    int32_t ema; // media exponencial (rpm Q4)
+    int16_t x1, x2; // entradas anteriores do biquad (rpm)
+    int32_t y1, y2; // saidas anteriores do biquad (rpm Q2)
+    int16_t last; // saida anterior do banco (rpm)
+    int16_t lastMedian; // saida anterior da mediana (rpm)
+    int32_t dif; // derivada filtrada (rpm/amostra Q4)
+}Filter;
+
+void filter_reset(Filter* f);
+void filter_seed(Filter* f, int16_t x);
+int16_t filter_run(Filter* f, int16_t x);
+int16_t filter_derivative(const Filter* f);
+bool filter_command(char cmd, int16_t val);
+
+#endif
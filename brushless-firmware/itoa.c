@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------
+// conversao de inteiros para texto (telemetria e mensagens). Sem
+// registros do MSP430: o simulador confere os limites (-i)
+#include "itoa.h"
+
+static void reverse(char* begin, char* end);
+
+//==========================================================================
+// ITOA BASE 10
+// funcao: converte um numero inteiro para c_string. Os digitos saem do
+//         resto em 32 bits (int tem 16 bits no MSP430)
+// retorno: nenhum
+// parametros: numero (int32_t), string (char*)
+// constantes: nenhuma
+//==========================================================================
+void itoa_base_10(int32_t num, char* str){
+
+    char* ptr = str;
+    int32_t int_tmp;
+
+    do{
+        int_tmp = num;
+        num /= 10;
+        const char charTable[] = "zyxwvutsrqponmlkjihgfedcba9876543210"
+                                 "123456789abcdefghijklmnopqrstuvwxyz";
+        *ptr++ = charTable[35 + (int_tmp - num * 10)];
+    }while(num);
+
+    if(int_tmp < 0) *ptr++ = '-';
+
+    *ptr = '\0';
+    reverse(str, ptr - 1);
+}
+
+//==========================================================================
+// UTOA BASE 10
+// funcao: converte um numero sem sinal para c_string (seq e tick da
+//         telemetria passam de 32767 em 5,5 min)
+// retorno: nenhum
+// parametros: numero (uint32_t), string (char*)
+// constantes: nenhuma
+//==========================================================================
+void utoa_base_10(uint32_t num, char* str){
+
+    char* ptr = str;
+
+    do{
+        *ptr++ = '0' + num%10;
+        num /= 10;
+    }while(num);
+
+    *ptr = '\0';
+    reverse(str, ptr - 1);
+}
+
+//==========================================================================
+// REVERSE
+// funcao: inverte os caracteres de begin a end (inclusive)
+// retorno: nenhum
+// parametros: primeiro e ultimo caractere (char*)
+// constantes: nenhuma
+//==========================================================================
+static void reverse(char* begin, char* end){
+    char char_tmp;
+
+    while(begin < end){
+        char_tmp = *end;
+        *end-- = *begin;
+        *begin++ = char_tmp;
+    }
+}
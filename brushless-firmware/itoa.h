@@ -0,0 +1,9 @@
+#ifndef _ITOA_H_
+#define _ITOA_H_
+
+#include <stdint.h>
+
+void itoa_base_10(int32_t num, char* str); // ate 12 bytes ("-2147483648")
+void utoa_base_10(uint32_t num, char* str); // ate 11 bytes ("4294967295")
+
+#endif
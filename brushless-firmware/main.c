@@ -40,6 +40,8 @@
 #include <stdbool.h> // bool
 
 #include "serial_uart.h"
+#include "control.h"
+#include "itoa.h"
 
 //--------------------------------------------------------------------------
 // GPIO
@@ -48,36 +50,12 @@
 #define MOTORINPIN BIT4 // P1.4
 #define MOTOROUTPIN BIT6 // P1.6 / TA01 (GREEN LED)
 
-// servo
-const int16_t SERVOMINPULSE = 1200; // aprox 1250 rpm
-const int16_t SERVOSTOPPULSE = 1000; // 1ms
-const int16_t SERVOMAXPULSE = 1600; // aprox 6500 rpm
-
-// intervalo de velocidade
-const int16_t RPMMAX = 6000;
-const int16_t RPMMIN = 2000;
-
 // amostragem
 #define SAMPLINGINTERVAL (10000<<1)-1 // 10 ms
+#define SAMPLINGTICKS 20000 // TA0R por amostra (2MHz * 10ms)
 
-// media exponencial movel
-#define NM 20.0f // numero de medias
-#define ALPHA NM/(NM+1) // coeficiente exponencial
-
-// controlador PID
-#define TUNER
-// PID TUNER
-#ifdef TUNER
-#define Ts 10e-3
-#define KP (0.081f)*50
-#define KI (0.2399f*Ts)*145
-#define KD (0.0068371f/Ts)*165
-#else
-// Ziegler Nichols
-#define KP 0.5002f
-#define KI 0.0548f
-#define KD 2.2811f
-#endif
+// ociosidade
+#define IDLEWINDOW 100 // amostras por relatorio (1s)
 //--------------------------------------------------------------------------
 // clock
 void clock_config();
@@ -90,8 +68,13 @@ void cronometro_config();
 void gpio_config();
 // amostragem
 void sampling_config();
+uint16_t ta0_elapsed(uint16_t start);
+void idle_report(uint32_t idleTicks);
+void telemetry_send(uint16_t seq, uint32_t tick, uint16_t rpm, uint16_t setPoint, uint16_t pulse);
+// serial
+void serial_poll();
+void serial_command(const char* line);
 // miscelanea
-void itoa_base_10(int32_t num, char* str);
 void delay_ms(uint16_t ms);
 
 //--------------------------------------------------------------------------
@@ -100,12 +83,11 @@ volatile uint16_t nextPulse = 0; // prox. pulso
 volatile uint16_t setPoint = 5000; // vel. desejada
 // amostragem
 volatile bool amostrar = false;
+volatile uint32_t sampleTick = 0; // ticks de amostragem desde o reset
 // timer
 volatile uint16_t timerCount = 0;
 volatile uint16_t timerOverflow = 0;
 volatile uint16_t overTimer = 0;
-// calculo
-char strSerialValue[8] = {'\0'}; // string de uso geral
 // serial
 volatile bool writeMode = true;
 //==========================================================================
@@ -130,176 +112,140 @@ int main(){
     // acende o led em modo WRITE
     P1OUT |= REDLEDPIN;
 
-    char generalStr[16] = {'\0'}; // string de uso geral
+    uint16_t seq = 0; // numero da amostra enviada
+    uint32_t tick = 0; // tick de amostragem da amostra
     uint16_t rpmInst = 0; // velocidade instantanea
-    uint16_t rpm[2] = {0}; // velocidade em RPM (media exp movel)
-    int16_t intError = 0; // integral do erro
-    uint16_t pulseMME[2] = {0}; // pulso (media exp movel)
+    uint16_t rpm = 0; // velocidade em RPM (filtrada)
+    uint32_t idleTicks = 0; // tempo em LPM0 na janela (TA0R, 0,5us)
+    uint8_t idleSamples = 0; // amostras na janela
 
     // loop principal
     while(1){
-        if(amostrar){ // intervalo de amostragem controlado por TIMER0_A1
-
-            amostrar = false; // prox amostragem
-
-            // calcula a velocidade
-            float delta_t = (62.5e-9f*timerCount + 3.125e-3f*overTimer);
-            if(delta_t > 0){ // previne divisao por zero
-                rpmInst = (uint16_t)(8.5714f/delta_t); // 8.5714 = 60s/7(polos motor)
-            }
-
-            // media exponencial movel
-            rpm[1] = ALPHA*rpm[0]+(1-ALPHA)*rpmInst;
-            
-            // derivada
-            int16_t difRPM = rpm[1] - rpm[0];
-            rpm[0] = rpm[1];
-
-            if(writeMode){
-                // envia velocidade pela serial
-                itoa_base_10(rpm[0], generalStr);
-                serial_print_string(generalStr);
-                serial_print_byte('\n');
-                
-                continue; // retorna para o loop
-            }
-
-            int16_t error = setPoint - rpm[1]; // erro
-
-            // limita a integral do erro em 10%
-            if(error > (0.1f*setPoint) || error < (-0.1f*setPoint)){
-                intError = 0;
+        // dorme em LPM0 ate TIMER0_A1 sinalizar a amostra. GIE e LPM0 sao
+        // ligados juntos, entao a interrupcao nao se perde entre o teste
+        // de amostrar e o sono. As linhas recebidas (USCI0RX_ISR) sao
+        // tratadas aqui, uma por vez, conferindo a amostra entre elas
+        uint16_t sleepStart = TA0R;
+        uint16_t busyTicks = 0; // tratando comandos (nao conta como ocioso)
+        __disable_interrupt();
+        while(!amostrar){
+            if(serial_rx_count()){
+                __enable_interrupt();
+                uint16_t busyStart = TA0R;
+                serial_poll();
+                busyTicks += ta0_elapsed(busyStart);
+                __disable_interrupt();
             }else{
-                intError += error;
+                __bis_SR_register(LPM0_bits | GIE);
+                __disable_interrupt();
             }
+        }
+        tick = sampleTick; // 32 bits: le com interrupcoes desligadas
+        amostrar = false; // prox amostragem
+        __enable_interrupt();
+
+        // tempo dormindo
+        uint16_t slept = ta0_elapsed(sleepStart);
+        idleTicks += (slept > busyTicks)?(slept - busyTicks):0;
+
+        if(++idleSamples >= IDLEWINDOW){
+            idle_report(idleTicks);
+            idleTicks = 0;
+            idleSamples = 0;
+        }
+
+        // calcula a velocidade
+        float delta_t = (62.5e-9f*timerCount + 3.125e-3f*overTimer);
+        if(delta_t > 0){ // previne divisao por zero
+            rpmInst = (uint16_t)(8.5714f/delta_t); // 8.5714 = 60s/7(polos motor)
+        }
 
-            // calcula o pulso
-            int16_t pulse = (int16_t)(  
-                                        error*KP + 
-                                        intError*KI + 
-                                        -difRPM*KD + 
-                                        SERVOSTOPPULSE);
+        // filtra a velocidade (control.c)
+        rpm = control_filter(rpmInst);
 
-            // media movel exponencial
-            pulseMME[1] = ALPHA*pulseMME[0]+(1-ALPHA)*pulse;
-            pulseMME[0] = pulseMME[1];
+        if(!writeMode){
+            // calcula o pulso (PID ou PI-D + preditor de Smith)
+            int16_t pulse = control_step(setPoint);
 
             // aplica o controlador
-            servo_write_pulse(pulseMME[1]);
-            
-            // envia dados pela serial
-            // itoa_base_10(setPoint, generalStr);
-            // serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            itoa_base_10(rpm[0], generalStr);
-            serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            // itoa_base_10(error, generalStr);
-            // serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            // itoa_base_10(intError, generalStr);
-            // serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            // itoa_base_10(difRPM, generalStr);
-            // serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            // itoa_base_10(pulse, generalStr);
-            // serial_print_string(generalStr);
-            // serial_print_byte('\t');
-
-            // itoa_base_10((nextPulse+1)>>1, generalStr);
-            // serial_print_string(generalStr);
-            serial_print_byte('\n');
+            servo_write_pulse(pulse);
         }
+
+        // envia a amostra pela serial (modo WRITE: set-point 0)
+        telemetry_send(seq++, tick, rpm, writeMode?0:setPoint, (nextPulse+1)>>1);
     }
 
     return 0;
 }
 
 //==========================================================================
-// USCI0RX ISR
-// funcao: servico de interrupcao UART. Recebe valores pela serial e concatena
-//         na string strSerialValue. Limite de digitos 6 (+ end line)
-//         Se receber um valor valido, atualiza o set-point
+// SERIAL POLL
+// funcao: trata a prox. linha completa do buffer de recepcao (serial_rx.c).
+//         Uma linha longa demais responde "*** invalid ***"
 // retorno: nenhum
 // parametros: nenhum
-// constantes:
-//      SERIAL_DBG: debug
-//      MOTORINPIN: saida do filtro
+// constantes: nenhuma
 //==========================================================================
-#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
-#pragma vector=USCIAB0RX_VECTOR
-__interrupt void USCI0RX_ISR(void)
-#elif defined(__GNUC__)
-void __attribute__ ((interrupt(USCIAB0RX_VECTOR))) USCI0RX_ISR(void)
-#else
-#error Compiler not supported!
-#endif
-{
-    static uint8_t i = 0;
-
-    static bool overflow = false;
+void serial_poll(){
+    const char* line;
 
-    char val = UCA0RXBUF;
-
-    if (7 == i && '\n' != val){
-
-        overflow = true;
+    switch(serial_read_line(&line)){
+        case SERIALLINE:
+            serial_command(line);
+            break;
+        case SERIALLONG:
+            serial_print_string("*** invalid ***\n");
+            break;
+        default:
+            break;
+    }
+}
 
-#ifdef SERIAL_DBG
-        serial_print_string("\n*** buffer overflow ***\n");
-#endif
+//==========================================================================
+// SERIAL COMMAND
+// funcao: interpreta uma linha recebida pela serial. Um valor atualiza o
+//         set-point (ou o pulso, em modo WRITE). Linhas que comecam com
+//         uma letra sao comandos do controlador (control.c), exceto "oN",
+//         que troca o modo WRITE (malha aberta). Responde com o eco
+//         "*** linha ***"; fora da ISR, o eco nao parte mais uma linha de
+//         amostra ao meio e dispensa as linhas em branco em volta
+// retorno: nenhum
+// parametros: linha sem o '\n' (const char*)
+// constantes:
+//      RPMMIN, RPMMAX: limites do set-point
+//      REDLEDPIN: led vermelho (modo WRITE)
+//==========================================================================
+void serial_command(const char* line){
+    int16_t serialVal = atoi(line);
 
-        for(uint8_t j=0; j<8; j++){
-            strSerialValue[j]=0;
+    if('o' == line[0]){
+        // "o1": malha aberta (modo WRITE, valores sao pulsos)
+        // "o0": malha fechada. Mesmo efeito do botao
+        writeMode = (0 != atoi(line+1));
+        P1OUT = (writeMode)?(P1OUT|REDLEDPIN):(P1OUT&~REDLEDPIN);
+    }else if('a' <= line[0] && 'z' >= line[0]){
+        if(!control_command(line[0], atoi(line+1))){
+            serial_print_string("*** invalid ***\n");
         }
-
-        i = 0;
-    }else if(7 >= i){
-
-        strSerialValue[i] = val;
-        i++;
-
-        if ('\n' == val){
-            if(!overflow){
-                strSerialValue[i-1] = '\0';
-                int16_t serialVal = atoi(strSerialValue);
-
-                if(writeMode){
-                    servo_write_pulse(serialVal);
-                }else{
-                    if(0 == serialVal){
-                        servo_write_pulse(SERVOSTOPPULSE); // para o motor
-                    }else{
-                        if(RPMMIN > serialVal){
-                            serialVal = RPMMIN;
-                        }else if(RPMMAX < serialVal){
-                            serialVal = RPMMAX;
-                        }
-                        setPoint = serialVal;
-                    }
-                }
-
-                // informa atualizacao
-                serial_print_string("\n*** ");
-                serial_print_string(strSerialValue);
-                serial_print_string(" ***\n\n");
-
-            }else{
-                overflow=false;
-            }
-
-            i = 0;
-            for(uint8_t j=0; j<8; j++){
-                strSerialValue[j]=0;
+    }else if(writeMode){
+        servo_write_pulse(serialVal);
+    }else{
+        if(0 == serialVal){
+            servo_write_pulse(SERVOSTOPPULSE); // para o motor
+        }else{
+            if(RPMMIN > serialVal){
+                serialVal = RPMMIN;
+            }else if(RPMMAX < serialVal){
+                serialVal = RPMMAX;
             }
+            setPoint = serialVal;
         }
     }
+
+    // informa atualizacao
+    serial_print_string("*** ");
+    serial_print_string(line);
+    serial_print_string(" ***\n");
 }
 
 //==========================================================================
@@ -385,7 +331,7 @@ void __attribute__ ((interrupt(TIMER1_A0_VECTOR))) Timer1_A0(void)
 //==========================================================================
 // TIMER 0 A1
 // funcao: servico de interrupcao TIMER 0 A1. Atualiza PWM (TA0CCR1),
-//         prox. amostragem (TA0CCR2), gatilho para amostra
+//         prox. amostragem (TA0CCR2), gatilho para amostra (sai de LPM0)
 // retorno: nenhum
 // parametros: nenhum
 // constantes:
@@ -409,14 +355,19 @@ void __attribute__ ((interrupt(TIMER0_A1_VECTOR))) Timer0_A1 (void)
 //        case TA0IV_TACCR1: break;
         case TA0IV_TACCR2:
             amostrar = true; // habilita envio
-            TA0CCR2 += SAMPLINGINTERVAL; // prox. envio
+            ++sampleTick;
+            // TA0CCR2 fica no meio do periodo: somar SAMPLINGINTERVAL aqui
+            // gerava um 3o tick em 19,999ms, colado ao TA0IV_TAIFG
+            __bic_SR_register_on_exit(LPM0_bits); // acorda o loop principal
             break;
 //        case TA0IV_6: break;
 //        case TA0IV_8: break;
         case TA0IV_TAIFG:
             amostrar = true; // habilita envio
+            ++sampleTick;
             TA0CCR1 = nextPulse; // atualiza pwm
             TA0CCR2 = SAMPLINGINTERVAL; // prox.envio
+            __bic_SR_register_on_exit(LPM0_bits); // acorda o loop principal
             break;
         default:
 //            amostrar = true; // habilita amostragem
@@ -529,36 +480,87 @@ void sampling_config(){
 }
 
 //==========================================================================
-// ITOA BASE 10
-// funcao: converte um numero inteiro para c_string
-// retorno: nenhum
-// parametros: numero (uint32_t), string (char*)
+// TA0 ELAPSED
+// funcao: tempo desde uma leitura anterior de TA0R (TA0R conta de 0 a
+//         TA0CCR0 em 20ms; intervalos menores que isso)
+// retorno: ciclos de TA0R, 0,5us (uint16_t)
+// parametros: leitura anterior de TA0R (uint16_t)
 // constantes: nenhuma
 //==========================================================================
-void itoa_base_10(int32_t num, char* str){
-
-    char* ptr = str, *ptr1 = str, char_tmp;
-    int int_tmp;
-
-    do{
-        int_tmp = num;
-        num /= 10;
-        const char charTable[] = "zyxwvutsrqponmlkjihgfedcba9876543210"
-                                 "123456789abcdefghijklmnopqrstuvwxyz";
-        *ptr++ = charTable[35 + (int_tmp - num * 10)];
-    }while(num);
-
-    if(int_tmp < 0) *ptr++ = '-';
+uint16_t ta0_elapsed(uint16_t start){
+    uint16_t now = TA0R;
 
-    *ptr-- = '\0';
+    if(now < start){
+        return now + (TA0CCR0 + 1 - start);
+    }
+    return now - start;
+}
 
-    while(ptr1 < ptr){
-        char_tmp = *ptr;
-        *ptr--= *ptr1;
-        *ptr1++ = char_tmp;
+//==========================================================================
+// IDLE REPORT
+// funcao: envia a fracao do tempo que o loop principal passou em LPM0 na
+//         ultima janela, em "*** idle 97.5% ***". O tempo das ISRs que
+//         rodam durante o sono conta como ocioso; o de tratar comandos,
+//         nao. Bytes perdidos na recepcao desde o ultimo relatorio saem
+//         em "*** rx lost N ***"
+// retorno: nenhum
+// parametros: tempo dormindo na janela, em ciclos de TA0R (uint32_t)
+// constantes: IDLEWINDOW, SAMPLINGTICKS
+//==========================================================================
+void idle_report(uint32_t idleTicks){
+    static uint16_t rxLost = 0;
+    char str[8];
+    // 2.000.000 ciclos * 1000 cabe em 32 bits
+    uint16_t permille = idleTicks*1000/((uint32_t)IDLEWINDOW*SAMPLINGTICKS);
+
+    serial_print_string("*** idle ");
+    itoa_base_10(permille/10, str);
+    serial_print_string(str);
+    serial_print_byte('.');
+    serial_print_byte('0' + permille%10);
+    serial_print_string("% ***\n");
+
+    uint16_t lost = serialRxLost;
+    if(lost != rxLost){
+        serial_print_string("*** rx lost ");
+        utoa_base_10((uint16_t)(lost - rxLost), str);
+        serial_print_string(str);
+        serial_print_string(" ***\n");
+        rxLost = lost;
     }
 }
 
+//==========================================================================
+// TELEMETRY SEND
+// funcao: envia uma amostra em "seq\ttick\trpm\tsetpoint\tpulse\n". seq
+//         conta as linhas enviadas (detecta perdas no painel) e tick os
+//         periodos de 10ms (base de tempo; salto maior que o de seq indica
+//         amostra perdida no proprio firmware). Campos sem sinal
+//         (utoa_base_10: seq e tick passam de 32767 em 5,5 min)
+// retorno: nenhum
+// parametros: seq (uint16_t), tick (uint32_t), rpm, set-point e pulso (us)
+// constantes: nenhuma
+//==========================================================================
+void telemetry_send(uint16_t seq, uint32_t tick, uint16_t rpm, uint16_t setPoint, uint16_t pulse){
+    char str[12];
+
+    utoa_base_10(seq, str);
+    serial_print_string(str);
+    serial_print_byte('\t');
+    utoa_base_10(tick, str);
+    serial_print_string(str);
+    serial_print_byte('\t');
+    utoa_base_10(rpm, str);
+    serial_print_string(str);
+    serial_print_byte('\t');
+    utoa_base_10(setPoint, str);
+    serial_print_string(str);
+    serial_print_byte('\t');
+    utoa_base_10(pulse, str);
+    serial_print_string(str);
+    serial_print_byte('\n');
+}
+
 //==========================================================================
 // DELAY MS
 // funcao: pausa o programa
@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------
+// buffer de recepcao UART e montagem das linhas de comando. Sem registros
+// do MSP430: o simulador usa o mesmo codigo (-u)
+//
+// fila de um produtor (USCI0RX_ISR) e um consumidor (loop principal) sem
+// trava: so a ISR escreve rxHead e so o loop principal escreve rxTail,
+// ambos de 8 bits (leitura e escrita atomicas)
+#include "serial_rx.h"
+
+//--------------------------------------------------------------------------
+// buffer de recepcao (cheio pela interrupcao de RX)
+static volatile char rxBuffer[SERIALRXSIZE];
+static volatile uint8_t rxHead = 0; // prox. posicao livre
+static volatile uint8_t rxTail = 0; // prox. byte a ler
+volatile uint16_t serialRxLost = 0;
+
+// linha em montagem (loop principal)
+static char rxLine[SERIALLINESIZE];
+static uint8_t rxLen = 0;
+static bool rxLong = false; // a linha atual passou de SERIALLINESIZE-1
+
+//==========================================================================
+// SERIAL RX PUSH
+// funcao: coloca um byte recebido no buffer de recepcao. Chamada pela
+//         interrupcao de RX; com o buffer cheio o byte e descartado e
+//         contado em serialRxLost
+// retorno: false se o byte foi perdido (bool)
+// parametros: caractere recebido (const char)
+// constantes: SERIALRXSIZE
+//==========================================================================
+bool serial_rx_push(const char data){
+    uint8_t next = (rxHead+1)&(SERIALRXSIZE-1);
+
+    if(next == rxTail){
+        serialRxLost++;
+        return false;
+    }
+
+    rxBuffer[rxHead] = data;
+    rxHead = next;
+    return true;
+}
+
+//==========================================================================
+// SERIAL RX COUNT
+// funcao: bytes recebidos que o loop principal ainda nao leu
+// retorno: quantidade (uint8_t)
+// parametros: nenhum
+// constantes: SERIALRXSIZE
+//==========================================================================
+uint8_t serial_rx_count(){
+    return (rxHead - rxTail)&(SERIALRXSIZE-1);
+}
+
+//==========================================================================
+// SERIAL READ LINE
+// funcao: consome o buffer de recepcao ate o fim de uma linha ('\n'). Os
+//         bytes de uma linha incompleta ficam guardados para a prox.
+//         chamada; uma linha longa demais e descartada inteira (nao
+//         contamina a seguinte)
+// retorno: SERIALLINE, SERIALNONE ou SERIALLONG (int8_t)
+// parametros: linha sem o '\n', valida ate a prox. chamada (const char**)
+// constantes: SERIALRXSIZE, SERIALLINESIZE
+//==========================================================================
+int8_t serial_read_line(const char** line){
+    while(rxTail != rxHead){
+        char data = rxBuffer[rxTail];
+        rxTail = (rxTail+1)&(SERIALRXSIZE-1);
+
+        if('\n' == data){
+            bool tooLong = rxLong;
+            rxLine[rxLen] = '\0';
+            rxLen = 0;
+            rxLong = false;
+            *line = rxLine;
+            return tooLong?SERIALLONG:SERIALLINE;
+        }
+
+        if(rxLen < SERIALLINESIZE-1){
+            rxLine[rxLen++] = data;
+        }else{
+            rxLong = true;
+        }
+    }
+
+    return SERIALNONE;
+}
+
+//==========================================================================
+// SERIAL RX RESET
+// funcao: esvazia o buffer de recepcao e descarta a linha em montagem
+// retorno: nenhum
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+void serial_rx_reset(){
+    rxTail = rxHead;
+    rxLen = 0;
+    rxLong = false;
+    serialRxLost = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef _SERIAL_RX_H_
+#define _SERIAL_RX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SERIALRXSIZE 64 // buffer de recepcao (potencia de 2)
+#define SERIALLINESIZE 16 // maior linha de comando (+ '\0')
+
+// retorno de serial_read_line
+#define SERIALNONE 0 // linha ainda incompleta
+#define SERIALLINE 1 // linha completa
+#define SERIALLONG -1 // linha maior que SERIALLINESIZE-1, descartada
+
+bool serial_rx_push(const char data);
+uint8_t serial_rx_count();
+int8_t serial_read_line(const char** line);
+void serial_rx_reset();
+
+extern volatile uint16_t serialRxLost; // bytes perdidos com o buffer cheio
+
+#endif
@@ -3,6 +3,13 @@
 #include <msp430.h>
 #include "serial_uart.h"
 
+//--------------------------------------------------------------------------
+// buffer de transmissao (esvaziado pela interrupcao de TX)
+static volatile char txBuffer[SERIALTXSIZE];
+static volatile uint8_t txHead = 0; // prox. posicao livre
+static volatile uint8_t txTail = 0; // prox. byte a enviar
+static volatile bool txWaiting = false; // loop principal dormindo em buffer cheio
+
 //==========================================================================
 // SERIAL CONFIG
 // funcao: configura a comunicacao serial UART
@@ -94,14 +101,36 @@ void serial_config(){
 
 //==========================================================================
 // SERIAL PRINT BYTE
-// funcao: envia um byte pela porta serial UART
+// funcao: coloca um byte no buffer de transmissao UART. Com o buffer cheio,
+//         o loop principal dorme em LPM0 ate a interrupcao de TX liberar
+//         espaco; dentro de uma ISR (GIE desligado) envia por polling
 // retorno: nenhum
 // parametros: caractere ASCII (const int8_t)
-// constantes: nenhuma
+// constantes: SERIALTXSIZE
 //==========================================================================
 void serial_print_byte(const char data){
-    while(!(IFG2 & UCA0TXIFG));
-    UCA0TXBUF = data;
+    const bool gie = __get_SR_register() & GIE;
+
+    __disable_interrupt();
+    while(((txHead+1)&(SERIALTXSIZE-1)) == txTail){
+        if(gie){
+            txWaiting = true;
+            __bis_SR_register(LPM0_bits | GIE); // acorda em USCI0TX_ISR
+            __disable_interrupt();
+        }else{
+            while(!(IFG2 & UCA0TXIFG));
+            UCA0TXBUF = txBuffer[txTail];
+            txTail = (txTail+1)&(SERIALTXSIZE-1);
+        }
+    }
+
+    txBuffer[txHead] = data;
+    txHead = (txHead+1)&(SERIALTXSIZE-1);
+    IE2 |= UCA0TXIE; // inicia/continua a transmissao
+
+    if(gie){
+        __enable_interrupt();
+    }
 }
 
 //==========================================================================
@@ -117,3 +146,63 @@ void serial_print_string(const char* data){
         data++;
     }
 }
+
+//==========================================================================
+// USCI0TX ISR
+// funcao: servico de interrupcao UART. Envia o prox. byte do buffer e
+//         acorda o loop principal se ele espera por espaco
+// retorno: nenhum
+// parametros: nenhum
+// constantes: SERIALTXSIZE
+//==========================================================================
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector=USCIAB0TX_VECTOR
+__interrupt void USCI0TX_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(USCIAB0TX_VECTOR))) USCI0TX_ISR(void)
+#else
+#error Compiler not supported!
+#endif
+{
+    if(txTail != txHead){
+        UCA0TXBUF = txBuffer[txTail];
+        txTail = (txTail+1)&(SERIALTXSIZE-1);
+    }
+
+    if(txTail == txHead){
+        IE2 &= ~UCA0TXIE; // buffer vazio
+    }
+
+    if(txWaiting){
+        txWaiting = false;
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
+
+//==========================================================================
+// USCI0RX ISR
+// funcao: servico de interrupcao UART. So guarda o byte no buffer de
+//         recepcao; as linhas sao interpretadas no loop principal, entre
+//         as amostras. Acorda o loop no fim de uma linha, ou antes de o
+//         buffer encher
+// retorno: nenhum
+// parametros: nenhum
+// constantes: SERIALRXSIZE
+//==========================================================================
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector=USCIAB0RX_VECTOR
+__interrupt void USCI0RX_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(USCIAB0RX_VECTOR))) USCI0RX_ISR(void)
+#else
+#error Compiler not supported!
+#endif
+{
+    char data = UCA0RXBUF;
+
+    serial_rx_push(data);
+
+    if('\n' == data || serial_rx_count() >= SERIALRXSIZE/2){
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "serial_rx.h"
+
 // #define SERIAL_DBG
 #define SERIAL_SMCLK 16000000
 // #define SERIAL_BAUD 115200
@@ -13,6 +15,8 @@
 #define SERIALRXPIN BIT1 // P1.1
 #define SERIALTXPIN BIT2 // P1.2
 
+#define SERIALTXSIZE 64 // buffer de transmissao (potencia de 2)
+
 void serial_config();
 void serial_print_byte(const char data);
 void serial_print_string(const char* data);
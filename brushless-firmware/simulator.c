@@ -0,0 +1,846 @@
+//==========================================================================
+//
+// TE149-motor-brushless
+// Simulador em malha fechada do controlador (compilado para o host)
+//
+// Executa o mesmo control.c do firmware contra o modelo identificado da
+// planta:
+//
+//                26.57
+//      -------------------------- * exp(-0.0665*s)
+//      0.03054 s^2 + 0.3522 s + 1
+//
+// com o ganho estatico do ESC+motor levado para rpm a partir dos limites
+// do servo (SERVOMINPULSE ~ 1250 rpm, SERVOMAXPULSE ~ 6500 rpm). O PWM so
+// e atualizado a cada periodo de 20ms, como no TIMER0_A1 do firmware.
+//
+// uso: simulator.run [-m modo] [-d atraso] [-k ganho] [-w anti-windup]
+//                     [-c comando] [-M margem] [-a rpm] [-b rpm] [-l carga]
+//                     [-n ruido] [-s bordas] [-r arquivo] [-u baud] [-i] [-v]
+//      -m: modo do controlador (0: PID, 1: PI-D + Smith)
+//      -d: atraso do modelo de Smith, em amostras (0: sem predicao)
+//      -k: escala dos ganhos do controlador, em % (100)
+//      -w: anti-windup (0: zera fora de 10%, 1: condicional, 2: back-calc.,
+//          3: padrao do firmware, 2)
+//      -c: comando da serial, ex. "-c n5 -c f2 -c c10" (pode repetir)
+//      -M: procura a escala dos ganhos que resulta nesta margem de ganho
+//      -a: set-point inicial (3000)
+//      -b: set-point apos o degrau (5000)
+//      -l: perturbacao de carga em SIMLOAD, em rpm de queda em regime (0)
+//      -n: desvio padrao do ruido do tacometro, em rpm (0)
+//      -s: probabilidade de borda falsa do tacometro por amostra (0)
+//      -r: compara ruido x atraso do banco de filtros sobre a velocidade
+//          gravada em arquivo (coluna rpm das linhas de amostra, "-" para
+//          stdin, ou gravacao compactada .bla do painel). Para gravar sem
+//          filtro: comandos "n1" e "f0" no firmware
+//      -u: teste da recepcao serial (serial_rx.c) nesta taxa: rajadas de
+//          comandos sem intervalo contra o loop principal do firmware
+//          (amostras de 10ms, telemetria e eco pelo buffer de TX), em
+//          tempos de byte. Sai com erro se algum byte se perder ou alguma
+//          linha chegar diferente da enviada
+//      -i: confere itoa_base_10/utoa_base_10 (itoa.c) nos limites de 16 e
+//          32 bits contra o printf. Sai com erro se algum diferir
+//      -v: imprime as amostras como o firmware (seq, tick, rpm, set-point,
+//          pulso)
+//
+// alem das metricas da resposta, mede o tempo de CPU do host gasto em
+// control_filter + control_step por amostra e a ociosidade correspondente
+// no periodo de 10ms (o firmware envia a sua em "*** idle ... ***") e a
+// taxa de passos da propria simulacao (sim_steps_per_s, usada pelo
+// "make bench")
+//
+// a margem de ganho e o maior multiplicador do ganho da planta que ainda
+// nao leva a malha a oscilar. Ex.: comparar o preditor com o mesmo PI-D
+// sem predicao, na mesma margem:
+//      simulator.run -m 1 -d 0 -M 1.9
+//      simulator.run -m 1 -d 7 -M 1.9
+// ou o anti-windup num degrau grande seguido de carga:
+//      simulator.run -m 1 -w 0 -a 2000 -b 5000 -l 1000
+//      simulator.run -m 1 -w 2 -a 2000 -b 5000 -l 1000
+//      simulator.run -m 0 -w 0 -a 2000 -b 5000 -l 1000
+//      simulator.run -m 0 -w 2 -a 2000 -b 5000 -l 1000
+//
+//==========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "control.h"
+#include "serial_rx.h"
+#include "itoa.h"
+
+//--------------------------------------------------------------------------
+// planta
+#define PLANTTAU1 0.19781 // s, 1o polo
+#define PLANTTAU2 0.15439 // s, 2o polo
+#define PLANTDELAY 0.0665 // s
+#define PLANTGAIN 13.125 // rpm/us
+#define PLANTZERO 1104.8 // us, pulso de rpm nulo
+
+// simulacao
+#define SIMDT 0.5e-3 // passo de integracao
+#define SIMSAMPLE 20 // passos por amostra do controlador (10ms)
+#define SIMPWM 40 // passos por periodo do PWM (20ms)
+#define SIMSTEP 3.0 // instante do degrau de set-point (s)
+#define SIMLOAD 7.0 // instante da perturbacao de carga (s)
+#define SIMEND 13.0 // fim da simulacao (s)
+#define SIMTAIL 3.0 // janela final para detectar oscilacao (s)
+#define SIMMAXMARGIN 8.0 // limite da busca de margem de ganho
+#define SIMMAXCMD 16 // comandos por configuracao
+
+// comparacao do banco de filtros (-r)
+#define REPLAYMAX 100000 // amostras lidas do arquivo
+#define REPLAYREF 5 // referencia: media centrada de +-5 amostras da mediana de 5
+#define REPLAYMAXLAG 50 // maior atraso procurado (amostras)
+#define ARCHIVECOLUMNS 7 // colunas do arquivo compactado (archive.h do painel)
+#define ARCHIVERPM 4 // coluna do rpm
+
+// teste da recepcao serial (-u), em ciclos de SMCLK
+#define UARTSMCLK 16000000 // SERIAL_SMCLK
+#define UARTBITS 10 // bits por byte (8N1)
+#define UARTTXSIZE 64 // SERIALTXSIZE
+#define UARTTICK 160000 // periodo de amostragem (10ms)
+#define UARTCONTROL 4000 // velocidade + filtro + controlador + telemetria ("idle 97.5%")
+#define UARTPARSE 800 // serial_command: atoi, control_command
+#define UARTPRINT 40 // serial_print_byte, por byte
+#define UARTISR 40 // entrada e saida de USCI0RX_ISR/USCI0TX_ISR
+#define UARTTELEMETRY 25 // bytes de uma amostra ("1234\t12345\t5000\t5000\t1450\n")
+#define UARTBURST 16 // comandos da rajada verificada
+#define UARTMAXBURST 200 // maior rajada procurada
+#define UARTPHASES 16 // inicios da rajada ao longo do periodo
+
+//--------------------------------------------------------------------------
+typedef struct{
+    double x1, x2; // estados dos polos (rpm)
+    double line[133]; // atraso de transporte: PLANTDELAY/SIMDT
+    int idx;
+    double gain; // multiplicador do ganho (teste de margem)
+    double load; // queda de velocidade imposta pela carga (rpm)
+}Plant;
+
+typedef struct{
+    double rise; // tempo de subida 10-90% (s)
+    double overshoot; // sobressinal (%)
+    double settling; // acomodacao em 2% (s)
+    double iae; // integral do erro absoluto ate SIMLOAD (rpm*s)
+    double dip; // maior queda apos a carga (rpm)
+    double recovery; // retorno a 2% do set-point apos a carga (s)
+    double peakToPeak; // oscilacao na janela final (rpm)
+    int crossings; // cruzamentos da media na janela final
+    double tickMean; // tempo medio de control_filter + control_step (s)
+    double tickMax; // pior tempo de control_filter + control_step (s)
+}Metrics;
+
+// cabecalho de bloco do arquivo compactado (Archive_Block_Header do painel)
+typedef struct{
+    char magic[4]; // "BLCK"
+    uint32_t count;
+    uint32_t messageBytes;
+    uint32_t columnBytes;
+    int64_t first[ARCHIVECOLUMNS];
+    int64_t step[ARCHIVECOLUMNS];
+    uint8_t bits[ARCHIVECOLUMNS];
+    uint8_t pad;
+}ArchiveBlock;
+
+static double plant_step(Plant* p, double pulse);
+static double gaussian();
+static Metrics simulate(uint16_t spA, uint16_t spB, double load, double noise, double gain, bool verbose);
+static double gain_margin(uint16_t spA, uint16_t spB);
+static bool oscillates(Metrics m, uint16_t sp);
+static bool apply(char* const cmds[], int n);
+static int replay(const char* path, char* const cmds[], int n);
+static int archive_rpm(FILE* fp, int16_t* x, int max);
+
+typedef struct{
+    int lines; // linhas lidas
+    int bad; // linhas diferentes das enviadas
+    uint16_t lost; // bytes perdidos (serialRxLost)
+    uint8_t peak; // maior ocupacao do buffer de recepcao
+    double replyMax; // '\n' recebido -> eco no buffer de TX (s)
+}UartRun;
+
+static UartRun uart_burst(long baud, int ncmds, long phase);
+static int uart_test(long baud);
+static int itoa_test();
+
+static double spikeRate = 0; // bordas falsas do tacometro por amostra
+
+//==========================================================================
+//
+//==========================================================================
+int main(int argc, char* argv[]){
+    int16_t mode = CONTROL_PID, delay = -1, scale = 100, windup = WINDUP_AUTO;
+    uint16_t spA = 3000, spB = 5000;
+    double noise = 0, target = 0, load = 0;
+    bool verbose = false;
+    long uartBaud = 0;
+    const char* replayPath = NULL;
+    char* cmds[SIMMAXCMD];
+    int ncmds = 0;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "m:d:k:w:c:M:a:b:l:n:s:r:u:iv"))){
+        switch(opt){
+            case 'm': mode = atoi(optarg); break;
+            case 'd': delay = atoi(optarg); break;
+            case 'k': scale = atoi(optarg); break;
+            case 'w': windup = atoi(optarg); break;
+            case 'c':
+                if(ncmds < SIMMAXCMD){
+                    cmds[ncmds++] = optarg;
+                }
+                break;
+            case 'M': target = atof(optarg); break;
+            case 'a': spA = atoi(optarg); break;
+            case 'b': spB = atoi(optarg); break;
+            case 'l': load = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 's': spikeRate = atof(optarg); break;
+            case 'r': replayPath = optarg; break;
+            case 'u': uartBaud = atol(optarg); break;
+            case 'i': return itoa_test();
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "uso: %s [-m modo] [-d atraso] [-k ganho] [-w anti-windup] [-c comando] [-M margem] [-a rpm] [-b rpm] [-l carga] [-n ruido] [-s bordas] [-r arquivo] [-u baud] [-i] [-v]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(replayPath){
+        return replay(replayPath, cmds, ncmds);
+    }
+
+    if(uartBaud > 0){
+        return uart_test(uartBaud);
+    }
+
+    if(!control_command('m', mode) || !control_command('w', windup) ||
+       (delay >= 0 && !control_command('d', delay)) || !apply(cmds, ncmds)){
+        fprintf(stderr, "parametro invalido\n");
+        return EXIT_FAILURE;
+    }
+
+    // maior escala dos ganhos (passos de 5%) que atinge a margem pedida
+    if(target > 0){
+        for(scale = 1000; scale > 1; scale = scale*20/21){
+            control_command('g', scale);
+            if(gain_margin(spA, spB) >= target){
+                break;
+            }
+        }
+    }
+    control_command('g', scale);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    Metrics m = simulate(spA, spB, load, noise, 1, verbose);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall = (t1.tv_sec - t0.tv_sec) + 1e-9*(t1.tv_nsec - t0.tv_nsec);
+    double margin = gain_margin(spA, spB);
+
+    printf("mode\t%d\n", mode);
+    printf("gain_pct\t%d\n", scale);
+    printf("rise_ms\t%.0f\n", 1e3*m.rise);
+    printf("overshoot_pct\t%.1f\n", m.overshoot);
+    printf("settling_ms\t%.0f\n", 1e3*m.settling);
+    printf("iae_rpm_s\t%.1f\n", m.iae);
+    if(load > 0){
+        printf("load_dip_rpm\t%.0f\n", m.dip);
+        printf("load_recovery_ms\t%.0f\n", 1e3*m.recovery);
+    }
+    printf("gain_margin\t%.2f\n", margin);
+    printf("tick_mean_us\t%.2f\n", 1e6*m.tickMean);
+    printf("tick_max_us\t%.2f\n", 1e6*m.tickMax);
+    printf("idle_pct\t%.2f\n", 100*(1 - m.tickMean/(SIMSAMPLE*SIMDT)));
+    printf("sim_steps_per_s\t%.0f\n", (SIMEND/SIMDT)/wall);
+    printf("sim_realtime_x\t%.1f\n", SIMEND/wall);
+
+    return 0;
+}
+
+//==========================================================================
+// GAIN MARGIN
+// funcao: maior multiplicador do ganho da planta (passos de 5%) para o qual
+//         a malha ainda nao oscila na janela final SIMTAIL (mais de
+//         2 cruzamentos da media com amplitude acima de 1% do set-point)
+// retorno: margem de ganho (double)
+// parametros: set-points
+// constantes: SIMMAXMARGIN
+//==========================================================================
+static double gain_margin(uint16_t spA, uint16_t spB){
+    double margin = 1;
+    if(oscillates(simulate(spA, spB, 0, 0, 1, false), spB)){
+        return 0; // instavel no ganho nominal
+    }
+    while(margin < SIMMAXMARGIN){
+        if(oscillates(simulate(spA, spB, 0, 0, margin*1.05, false), spB)){
+            break;
+        }
+        margin *= 1.05;
+    }
+    return margin;
+}
+
+static bool oscillates(Metrics m, uint16_t sp){
+    return m.crossings > 2 && m.peakToPeak > 0.01*sp;
+}
+
+//==========================================================================
+// SIMULATE
+// funcao: malha fechada com degrau de set-point spA -> spB em SIMSTEP e
+//         perturbacao de carga em SIMLOAD
+// retorno: metricas da resposta ao degrau e a carga (Metrics)
+// parametros: set-points, carga (rpm), ruido (rpm), ganho da planta,
+//             imprime serie
+// constantes: SIMDT, SIMSAMPLE, SIMPWM, SIMSTEP, SIMEND
+//==========================================================================
+static Metrics simulate(uint16_t spA, uint16_t spB, double load, double noise, double gain, bool verbose){
+    Plant p = {0};
+    p.gain = gain;
+
+    control_reset();
+
+    Metrics m = {0};
+    double t10 = -1, t90 = -1, peak = 0, settled = 0, recovered = 0;
+    double lastMin = 1e9, lastMax = -1e9, lastSum = 0;
+    static double tail[6000]; // SIMTAIL/SIMDT
+    int tailLen = 0;
+    double rpm = 0, pwm = SERVOSTOPPULSE;
+    int16_t nextPulse = SERVOSTOPPULSE;
+    uint16_t setPoint = spA;
+    const double step = spB - (double)spA;
+    const long steps = SIMEND/SIMDT;
+    long ticks = 0;
+
+    for(long k=0; k<steps; k++){
+        double t = k*SIMDT;
+
+        if(0 == k%SIMPWM){
+            pwm = nextPulse; // TA0IV_TAIFG
+        }
+
+        p.load = (t < SIMLOAD)?0:load;
+        rpm = plant_step(&p, pwm);
+
+        if(0 == k%SIMSAMPLE){
+            setPoint = (t < SIMSTEP)?spA:spB;
+
+            double meas = rpm + noise*gaussian();
+            if(spikeRate > 0 && rand() < spikeRate*RAND_MAX){
+                meas *= 2; // borda falsa: meio periodo
+            }
+            uint16_t rpmInst = (meas > 0)?(uint16_t)meas:0;
+
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            uint16_t rpmFilt = control_filter(rpmInst);
+            nextPulse = control_step(setPoint);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+
+            double busy = (t1.tv_sec - t0.tv_sec) + 1e-9*(t1.tv_nsec - t0.tv_nsec);
+            m.tickMean += busy;
+            if(busy > m.tickMax) m.tickMax = busy;
+            ticks++;
+
+            // servo_write_pulse
+            if(SERVOMAXPULSE < nextPulse){
+                nextPulse = SERVOMAXPULSE;
+            }else if(SERVOMINPULSE > nextPulse){
+                nextPulse = SERVOMINPULSE;
+            }
+
+            if(verbose){
+                printf("%ld\t%ld\t%u\t%u\t%d\n", ticks - 1, ticks - 1, rpmFilt, setPoint, nextPulse);
+            }
+        }
+
+        if(t < SIMSTEP){
+            continue;
+        }
+
+        // metricas sobre a velocidade real (sem filtro e sem ruido)
+        if(t >= SIMLOAD){
+            if(spB - rpm > m.dip) m.dip = spB - rpm;
+            if(fabs(rpm - spB) > 0.02*spB) recovered = t - SIMLOAD;
+        }else{
+            double ts = t - SIMSTEP;
+            double frac = (rpm - spA)/step;
+            if(t10 < 0 && frac >= 0.1) t10 = ts;
+            if(t90 < 0 && frac >= 0.9) t90 = ts;
+            if(frac > peak) peak = frac;
+            if(fabs(rpm - spB) > 0.02*fabs(step)) settled = ts;
+            m.iae += fabs(spB - rpm)*SIMDT;
+        }
+        if(t > SIMEND - SIMTAIL && tailLen < (int)(sizeof(tail)/sizeof(*tail))){
+            if(rpm < lastMin) lastMin = rpm;
+            if(rpm > lastMax) lastMax = rpm;
+            lastSum += rpm;
+            tail[tailLen++] = rpm;
+        }
+    }
+
+    double mean = lastSum/tailLen;
+    for(int j=1; j<tailLen; j++){
+        if((tail[j-1] - mean)*(tail[j] - mean) < 0){
+            m.crossings++;
+        }
+    }
+
+    m.rise = (t10 >= 0 && t90 >= 0)?(t90 - t10):(SIMLOAD - SIMSTEP);
+    m.recovery = recovered;
+    m.overshoot = (peak > 1)?100*(peak - 1):0;
+    m.settling = settled;
+    m.peakToPeak = lastMax - lastMin;
+    m.tickMean /= ticks;
+    return m;
+}
+
+//==========================================================================
+// APPLY
+// funcao: aplica comandos no formato da serial ("n5", "f2", ...)
+// retorno: false se algum comando foi recusado (bool)
+// parametros: comandos (char* const[]), quantidade (int)
+// constantes: nenhuma
+//==========================================================================
+static bool apply(char* const cmds[], int n){
+    for(int j=0; j<n; j++){
+        if(!control_command(cmds[j][0], atoi(cmds[j]+1))){
+            fprintf(stderr, "comando invalido: %s\n", cmds[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+//==========================================================================
+// REPLAY
+// funcao: passa a velocidade gravada pelo banco de filtros em varias
+//         configuracoes (ou so na dada por -c) e compara ruido x atraso.
+//         A referencia e a mediana de 5 seguida de media centrada (fase
+//         zero); o atraso e o deslocamento que minimiza o RMS da
+//         diferenca para ela, e esse RMS e o ruido
+// retorno: codigo de saida (int)
+// parametros: arquivo, comandos (char* const[]), quantidade (int)
+// constantes: REPLAYMAX, REPLAYREF, REPLAYMAXLAG
+//==========================================================================
+static int replay(const char* path, char* const cmds[], int n){
+    static char* presets[][5] = {
+        {"n1", "f1", "a20", "e0"}, // original: media exponencial de 20
+        {"n1", "f0", "e0"}, // sem filtro
+        {"n3", "f1", "a10", "e0"},
+        {"n3", "f1", "a5", "e4"},
+        {"n5", "f1", "a5", "e4"},
+        {"n3", "f2", "c10", "e4"},
+        {"n3", "f2", "c5", "e8"},
+        {"n5", "f2", "c3", "e8"},
+    };
+    static int16_t x[REPLAYMAX], y[REPLAYMAX], d[REPLAYMAX];
+    static double ref[REPLAYMAX];
+
+    FILE* fp = strcmp(path, "-")?fopen(path, "r"):stdin;
+    if(!fp){
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    // gravacao compactada: le direto a coluna do rpm
+    int len = 0;
+    char magic[4];
+    bool archive = false;
+    if(fp != stdin){
+        archive = 4 == fread(magic, 1, 4, fp) && 0 == memcmp(magic, "BLAR", 4);
+        if(archive){
+            len = archive_rpm(fp, x, REPLAYMAX);
+        }else{
+            rewind(fp);
+        }
+    }
+
+    // rpm e a 3a coluna de "seq tick rpm setpoint pulse" (ou a unica, em
+    // gravacoes antigas); ignora as mensagens do firmware ("*** ... ***")
+    char line[128];
+    while(!archive && len < REPLAYMAX && fgets(line, sizeof(line), fp)){
+        long col[3];
+        int ncol = 0;
+        char* ptr = line;
+        while(ncol < 3){
+            char* end;
+            col[ncol] = strtol(ptr, &end, 10);
+            if(end == ptr) break;
+            ncol++;
+            ptr = end;
+        }
+        if(0 == ncol || 2 == ncol) continue;
+        long v = col[ncol - 1];
+        if(v >= 0){
+            x[len++] = (v > INT16_MAX)?INT16_MAX:v;
+        }
+    }
+    if(fp != stdin){
+        fclose(fp);
+    }
+    if(len < 4*REPLAYMAXLAG){
+        fprintf(stderr, "poucas amostras (%d)\n", len);
+        return EXIT_FAILURE;
+    }
+
+    // referencia de fase zero
+    for(int k=0; k<len; k++){
+        double sum = 0;
+        int cnt = 0;
+        for(int j=k-REPLAYREF; j<=k+REPLAYREF; j++){
+            if(j < 2 || j >= len-2) continue;
+            int16_t w[5] = {x[j-2], x[j-1], x[j], x[j+1], x[j+2]};
+            for(int a=1; a<5; a++){
+                for(int b=a; b && w[b-1] > w[b]; b--){
+                    int16_t t = w[b]; w[b] = w[b-1]; w[b-1] = t;
+                }
+            }
+            sum += w[2];
+            cnt++;
+        }
+        ref[k] = cnt?sum/cnt:x[k];
+    }
+
+    printf("config\tlag_ms\tnoise_rpm\tdiff_noise_rpm\n");
+    int npresets = n?1:(int)(sizeof(presets)/sizeof(*presets));
+    for(int p=0; p<npresets; p++){
+        char* const* cfg = n?cmds:presets[p];
+        int ncfg = n;
+        if(!n){
+            for(ncfg=0; ncfg<5 && cfg[ncfg]; ncfg++);
+        }
+
+        control_reset();
+        if(!apply(cfg, ncfg)){
+            return EXIT_FAILURE;
+        }
+        for(int k=0; k<len; k++){
+            y[k] = control_filter(x[k]);
+            d[k] = control_derivative();
+        }
+
+        // atraso: deslocamento de menor erro em relacao a referencia
+        int start = 2*REPLAYMAXLAG; // descarta o transitorio inicial
+        double noise = 1e300;
+        int lag = 0;
+        for(int l=0; l<=REPLAYMAXLAG; l++){
+            double e2 = 0;
+            for(int k=start; k<len; k++){
+                double e = y[k] - ref[k-l];
+                e2 += e*e;
+            }
+            if(e2 < noise){
+                noise = e2;
+                lag = l;
+            }
+        }
+        noise = sqrt(noise/(len-start));
+
+        double dnoise = 0;
+        for(int k=start; k<len; k++){
+            double de = d[k] - (ref[k-lag] - ref[k-lag-1]);
+            dnoise += de*de;
+        }
+        dnoise = sqrt(dnoise/(len-start));
+
+        for(int j=0; j<ncfg; j++){
+            printf("%s%s", j?" ":"", cfg[j]);
+        }
+        printf("\t%d\t%.1f\t%.1f\n", 10*lag, noise, dnoise);
+    }
+
+    return 0;
+}
+
+//==========================================================================
+// ARCHIVE RPM
+// funcao: le a coluna do rpm de uma gravacao compactada do painel (ver
+//         archive.h), a partir do primeiro bloco. Em cada bloco a coluna
+//         guarda o 1o valor e a 1a diferenca (step); as demais amostras sao
+//         o zigzag da diferenca menos o step, com bits[c] bits cada, em
+//         palavras de 64 bits e com a quantidade arredondada para 64
+// retorno: amostras lidas (int)
+// parametros: arquivo apos o cabecalho, destino (int16_t*), maximo (int)
+// constantes: ARCHIVECOLUMNS, ARCHIVERPM
+//==========================================================================
+static int archive_rpm(FILE* fp, int16_t* x, int max){
+    static uint64_t words[4096];
+    ArchiveBlock b;
+    int len = 0;
+
+    if(fseek(fp, 16, SEEK_SET)) return 0;
+    while(len < max && 1 == fread(&b, sizeof(b), 1, fp) && 0 == memcmp(b.magic, "BLCK", 4)){
+        long groups = (b.count + 63)/64;
+        long skip = 0;
+        for(int c=0; c<ARCHIVERPM; c++){
+            skip += groups*b.bits[c];
+        }
+        long nwords = groups*b.bits[ARCHIVERPM];
+        if(b.bits[ARCHIVERPM] > 64 || nwords > (long)(sizeof(words)/sizeof(*words))) break;
+        if(fseek(fp, 8*skip, SEEK_CUR)) break;
+        if(nwords && (size_t)nwords != fread(words, 8, nwords, fp)) break;
+
+        unsigned bits = b.bits[ARCHIVERPM];
+        uint64_t mask = bits?(~0ull >> (64 - bits)):0;
+        int64_t v = b.first[ARCHIVERPM];
+        for(uint32_t i=0; i<b.count && len < max; i++){
+            if(i){
+                uint64_t z = 0;
+                if(bits){
+                    uint64_t pos = (uint64_t)i*bits;
+                    unsigned shift = pos & 63;
+                    z = words[pos >> 6] >> shift;
+                    if(shift + bits > 64) z |= words[(pos >> 6) + 1] << (64 - shift);
+                    z &= mask;
+                }
+                v += (int64_t)((z >> 1) ^ (0 - (z & 1))) + b.step[ARCHIVERPM];
+            }
+            if(v >= 0){
+                x[len++] = (v > INT16_MAX)?INT16_MAX:v;
+            }
+        }
+
+        // demais colunas e mensagens
+        long rest = 0;
+        for(int c=ARCHIVERPM+1; c<ARCHIVECOLUMNS; c++){
+            rest += groups*b.bits[c];
+        }
+        if(fseek(fp, 8*rest + b.messageBytes, SEEK_CUR)) break;
+    }
+    return len;
+}
+
+//==========================================================================
+// ITOA TEST
+// funcao: converte valores nos limites de 16 e 32 bits (seq e tick da
+//         telemetria passam de 32767 apos 5,5 min) e compara com o printf
+// retorno: codigo de saida (int)
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+static int itoa_test(){
+    static const uint32_t unsignedValues[] = {0, 9, 10, 32767, 32768, 65535, 65536, 2147483647u, 2147483648u, 4294967295u};
+    static const int32_t signedValues[] = {0, -1, 32767, 32768, -32768, -32769, 65535, INT32_MAX, INT32_MIN};
+    char str[12], ref[12];
+    int checked = 0, bad = 0;
+
+    for(size_t j=0; j<sizeof(unsignedValues)/sizeof(*unsignedValues); j++){
+        utoa_base_10(unsignedValues[j], str);
+        snprintf(ref, sizeof(ref), "%" PRIu32, unsignedValues[j]);
+        if(strcmp(str, ref)){
+            fprintf(stderr, "utoa_base_10(%s): %s\n", ref, str);
+            bad++;
+        }
+        checked++;
+    }
+    for(size_t j=0; j<sizeof(signedValues)/sizeof(*signedValues); j++){
+        itoa_base_10(signedValues[j], str);
+        snprintf(ref, sizeof(ref), "%" PRId32, signedValues[j]);
+        if(strcmp(str, ref)){
+            fprintf(stderr, "itoa_base_10(%s): %s\n", ref, str);
+            bad++;
+        }
+        checked++;
+    }
+
+    printf("itoa_checked\t%d\n", checked);
+    printf("itoa_bad\t%d\n", bad);
+    return bad?EXIT_FAILURE:0;
+}
+
+//==========================================================================
+// UART TEST
+// funcao: rajada de UARTBURST comandos, iniciada em UARTPHASES pontos do
+//         periodo de amostragem, e a maior rajada sem perda de bytes
+// retorno: codigo de saida (int)
+// parametros: taxa da serial, em bps (long)
+// constantes: UARTBURST, UARTMAXBURST, UARTPHASES, UARTTICK
+//==========================================================================
+static int uart_test(long baud){
+    UartRun worst = {0};
+    int maxBurst = 0;
+
+    for(int p=0; p<UARTPHASES; p++){
+        UartRun r = uart_burst(baud, UARTBURST, (long)UARTTICK*p/UARTPHASES);
+        worst.lines += r.lines;
+        worst.bad += r.bad;
+        if(r.lost > worst.lost) worst.lost = r.lost;
+        if(r.peak > worst.peak) worst.peak = r.peak;
+        if(r.replyMax > worst.replyMax) worst.replyMax = r.replyMax;
+    }
+
+    for(int n=1; n<=UARTMAXBURST; n++){
+        bool lossless = true;
+        for(int p=0; p<UARTPHASES && lossless; p++){
+            lossless = 0 == uart_burst(baud, n, (long)UARTTICK*p/UARTPHASES).lost;
+        }
+        if(!lossless) break;
+        maxBurst = n;
+    }
+
+    printf("uart_baud\t%ld\n", baud);
+    printf("uart_burst_cmds\t%d\n", UARTBURST);
+    printf("uart_lines\t%d\n", worst.lines);
+    printf("uart_bad_lines\t%d\n", worst.bad);
+    printf("uart_lost_bytes\t%u\n", worst.lost);
+    printf("uart_ring_peak\t%u\n", worst.peak);
+    printf("uart_reply_max_us\t%.0f\n", 1e6*worst.replyMax);
+    printf("uart_max_burst_cmds\t%d\n", maxBurst);
+
+    return (0 == worst.lost && 0 == worst.bad)?0:EXIT_FAILURE;
+}
+
+//==========================================================================
+// UART BURST
+// funcao: modelo do firmware em passos de um tempo de byte. A cada passo
+//         chega um byte da rajada (USCI0RX_ISR -> serial_rx_push), sai um
+//         byte do buffer de TX, e o loop principal gasta o resto do tempo
+//         como em main.c: a amostra (UARTCONTROL, depois UARTTELEMETRY
+//         bytes) tem prioridade; entre amostras, uma linha por vez
+//         (serial_read_line, UARTPARSE e o eco). Com o buffer de TX cheio
+//         o loop espera, e so a recepcao continua. Uma linha do meio da
+//         rajada e longa demais (deve voltar SERIALLONG)
+// retorno: linhas, perdas e ocupacao (UartRun)
+// parametros: taxa (bps), comandos da rajada, ciclo da 1a amostra
+// constantes: UARTBITS, UARTSMCLK, UARTTXSIZE, UARTTICK, UARTCONTROL,
+//             UARTPARSE, UARTPRINT, UARTISR, UARTTELEMETRY
+//==========================================================================
+static UartRun uart_burst(long baud, int ncmds, long phase){
+    static const char* cmds[] = {"5000", "o0", "g100", "2500", "n3", "f1", "a5", "w2", "3000", "o1", "1400", "e4"};
+    static const char* tooLong = "12345678901234567890";
+    static char burst[UARTMAXBURST*24];
+    static long newline[UARTMAXBURST]; // ciclo de chegada de cada '\n'
+    const int ncycle = sizeof(cmds)/sizeof(*cmds);
+    const long byteCycles = (long)UARTBITS*UARTSMCLK/baud;
+
+    long len = 0;
+    for(int j=0; j<ncmds; j++){
+        len += sprintf(burst + len, "%s\n", (ncmds > 2 && j == ncmds/2)?tooLong:cmds[j%ncycle]);
+    }
+
+    serial_rx_reset();
+    UartRun r = {0};
+    long sent = 0, nlines = 0, cycle = 0, nextTick = phase, busy = 0;
+    int txCount = 0, outLeft = 0, replyLine = -1;
+    bool tickPending = false;
+
+    while(cycle < UARTSMCLK){
+        long budget = byteCycles;
+
+        // USCI0RX_ISR
+        if(sent < len){
+            if('\n' == burst[sent]){
+                newline[nlines++] = cycle;
+            }
+            serial_rx_push(burst[sent++]);
+            if(serial_rx_count() > r.peak){
+                r.peak = serial_rx_count();
+            }
+            budget -= UARTISR;
+        }
+
+        // USCI0TX_ISR
+        if(txCount){
+            txCount--;
+            budget -= UARTISR;
+        }
+
+        // TIMER0_A1
+        if(cycle >= nextTick){
+            tickPending = true;
+            nextTick += UARTTICK;
+        }
+
+        // loop principal
+        while(budget > 0){
+            if(busy){
+                long d = (busy < budget)?busy:budget;
+                busy -= d;
+                budget -= d;
+            }else if(outLeft){
+                if(txCount >= UARTTXSIZE-1){
+                    break; // serial_print_byte: dorme ate a USCI0TX_ISR
+                }
+                txCount++;
+                budget -= UARTPRINT;
+                if(0 == --outLeft && replyLine >= 0){
+                    double reply = (double)(cycle + byteCycles - budget - newline[replyLine])/UARTSMCLK;
+                    if(reply > r.replyMax) r.replyMax = reply;
+                    replyLine = -1;
+                }
+            }else if(tickPending){
+                tickPending = false;
+                busy = UARTCONTROL;
+                outLeft = UARTTELEMETRY;
+            }else if(serial_rx_count()){
+                const char* line;
+                int8_t status = serial_read_line(&line);
+                if(SERIALNONE == status){
+                    break; // linha incompleta: dorme ate o '\n'
+                }
+                bool expectLong = ncmds > 2 && r.lines == ncmds/2;
+                const char* expected = expectLong?tooLong:cmds[r.lines%ncycle];
+                if((SERIALLONG == status) != expectLong || (!expectLong && strcmp(line, expected))){
+                    r.bad++;
+                }
+                busy = UARTPARSE;
+                outLeft = (SERIALLINE == status)?(int)strlen(line) + 9:16; // "*** linha ***\n"
+                replyLine = r.lines++;
+            }else{
+                break; // LPM0
+            }
+        }
+
+        cycle += byteCycles;
+        if(sent == len && !serial_rx_count() && !busy && !outLeft && !txCount){
+            break;
+        }
+    }
+
+    r.lost = serialRxLost;
+    return r;
+}
+
+//==========================================================================
+// PLANT STEP
+// funcao: avanca o modelo continuo da planta em SIMDT
+// retorno: velocidade, em rpm (double)
+// parametros: planta (Plant*), pulso aplicado, em us (double)
+// constantes: PLANTTAU1, PLANTTAU2, PLANTGAIN, PLANTZERO
+//      a carga atua no eixo, depois do atraso do ESC
+//==========================================================================
+static double plant_step(Plant* p, double pulse){
+    const int len = sizeof(p->line)/sizeof(*p->line);
+
+    double u = p->gain*PLANTGAIN*(pulse - PLANTZERO);
+    double ud = p->line[p->idx];
+    p->line[p->idx] = (u > 0)?u:0;
+    p->idx = (p->idx + 1)%len;
+
+    ud -= p->load;
+    p->x1 += (ud - p->x1)*(1 - exp(-SIMDT/PLANTTAU1));
+    p->x2 += (p->x1 - p->x2)*(1 - exp(-SIMDT/PLANTTAU2));
+    return p->x2;
+}
+
+//==========================================================================
+// GAUSSIAN
+// funcao: amostra normal padrao (Box-Muller)
+// retorno: amostra (double)
+// parametros: nenhum
+// constantes: nenhuma
+//==========================================================================
+static double gaussian(){
+    double u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
@@ -0,0 +1,841 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "archive.h"
+
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+
+// ------------------------------------------------------------------------------
+//   Bit Packing
+// ------------------------------------------------------------------------------
+// 64 values of B bits in B words. With B a template parameter the shifts
+// are constants and each width gets its own straight-line loop.
+template <unsigned B>
+static void
+pack64(const uint64_t *in, uint64_t *out)
+{
+    for (unsigned w = 0; w < B; w++)
+    {
+        out[w] = 0;
+    }
+    for (unsigned i = 0; i < 64; i++)
+    {
+        unsigned pos   = i*B;
+        unsigned word  = pos >> 6;
+        unsigned shift = pos & 63;
+        out[word] |= in[i] << shift;
+        if (shift + B > 64)
+        {
+            out[word + 1] |= in[i] >> (64 - shift);
+        }
+    }
+}
+
+template <unsigned B>
+static void
+unpack64(const uint64_t *in, uint64_t *out)
+{
+    const uint64_t mask = ~0ull >> (64 - B);
+    for (unsigned i = 0; i < 64; i++)
+    {
+        unsigned pos   = i*B;
+        unsigned word  = pos >> 6;
+        unsigned shift = pos & 63;
+        uint64_t value = in[word] >> shift;
+        if (shift + B > 64)
+        {
+            value |= in[word + 1] << (64 - shift);
+        }
+        out[i] = value & mask;
+    }
+}
+
+typedef void (*Pack_Function)(const uint64_t *in, uint64_t *out);
+
+struct Pack_Table
+{
+    Pack_Function pack[65];
+    Pack_Function unpack[65];
+};
+
+template <unsigned B>
+struct Pack_Fill
+{
+    static void fill(Pack_Table &table)
+    {
+        table.pack[B]   = pack64<B>;
+        table.unpack[B] = unpack64<B>;
+        Pack_Fill<B - 1>::fill(table);
+    }
+};
+
+template <>
+struct Pack_Fill<0>
+{
+    static void fill(Pack_Table &table)
+    {
+        table.pack[0]   = NULL; // no words
+        table.unpack[0] = NULL;
+    }
+};
+
+static const Pack_Table&
+pack_table()
+{
+    struct Filled : Pack_Table
+    {
+        Filled() { Pack_Fill<64>::fill(*this); }
+    };
+    static const Filled table;
+    return table;
+}
+
+static inline uint32_t
+padded(uint32_t count)
+{
+    return (count + 63) & ~63u;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Columns
+// ------------------------------------------------------------------------------
+static void
+column_values(const Telemetry_Sample *s, uint32_t count, int column, int64_t *v)
+{
+    switch (column)
+    {
+        case ARCHIVE_SEQ:       for (uint32_t i = 0; i < count; i++) v[i] = s[i].seq;                   break;
+        case ARCHIVE_TICK:      for (uint32_t i = 0; i < count; i++) v[i] = s[i].tick;                  break;
+        case ARCHIVE_TIME:      for (uint32_t i = 0; i < count; i++) v[i] = llround(1e6*s[i].time);      break;
+        case ARCHIVE_HOST_TIME: for (uint32_t i = 0; i < count; i++) v[i] = llround(1e6*s[i].host_time); break;
+        case ARCHIVE_RPM:       for (uint32_t i = 0; i < count; i++) v[i] = s[i].rpm;                   break;
+        case ARCHIVE_SETPOINT:  for (uint32_t i = 0; i < count; i++) v[i] = s[i].setpoint;              break;
+        case ARCHIVE_PULSE:     for (uint32_t i = 0; i < count; i++) v[i] = s[i].pulse;                 break;
+    }
+}
+
+static void
+set_column(Telemetry_Sample *s, uint32_t count, int column, const int64_t *v)
+{
+    switch (column)
+    {
+        case ARCHIVE_SEQ:       for (uint32_t i = 0; i < count; i++) s[i].seq       = (uint32_t)v[i];  break;
+        case ARCHIVE_TICK:      for (uint32_t i = 0; i < count; i++) s[i].tick      = (uint32_t)v[i];  break;
+        case ARCHIVE_TIME:      for (uint32_t i = 0; i < count; i++) s[i].time      = 1e-6*v[i];       break;
+        case ARCHIVE_HOST_TIME: for (uint32_t i = 0; i < count; i++) s[i].host_time = 1e-6*v[i];       break;
+        case ARCHIVE_RPM:       for (uint32_t i = 0; i < count; i++) s[i].rpm       = (int)v[i];       break;
+        case ARCHIVE_SETPOINT:  for (uint32_t i = 0; i < count; i++) s[i].setpoint  = (int)v[i];       break;
+        case ARCHIVE_PULSE:     for (uint32_t i = 0; i < count; i++) s[i].pulse     = (int)v[i];       break;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Block Codec
+// ------------------------------------------------------------------------------
+// Groups of 64 like the packing: a fixed trip count and unaliased arrays,
+// so the compiler vectorizes the delta/zigzag passes at -O2. Only the
+// prefix sum of the decode is sequential.
+static void
+zigzag64(const int64_t *__restrict value, const int64_t *__restrict previous, uint64_t step,
+         uint64_t *__restrict out)
+{
+    for (unsigned i = 0; i < 64; i++)
+    {
+        int64_t d = (int64_t)((uint64_t)value[i] - (uint64_t)previous[i] - step);
+        out[i] = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+    }
+}
+
+static void
+unzigzag64(const uint64_t *__restrict in, uint64_t step, int64_t *__restrict out)
+{
+    for (unsigned i = 0; i < 64; i++)
+    {
+        out[i] = (int64_t)(((in[i] >> 1) ^ (0 - (in[i] & 1))) + step);
+    }
+}
+
+static void
+encode_block(const Telemetry_Sample *s, uint32_t count,
+             const Archive_Message *messages, size_t message_count, std::string &out)
+{
+    const Pack_Table &table = pack_table();
+    const uint32_t n = padded(count);
+
+    Archive_Block_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "BLCK", 4);
+    header.count = count;
+
+    std::vector<int64_t>  v(n + 1);  // v[0]: before the first sample
+    std::vector<uint64_t> zigzag(n);
+    std::vector<uint64_t> words;
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+    {
+        column_values(s, count, c, &v[1]);
+        const int64_t  first = count ? v[1] : 0;
+        const uint64_t step  = count > 1 ? (uint64_t)v[2] - (uint64_t)v[1] : 0;
+
+        // the first sample and the padding encode as 0
+        v[0] = (int64_t)((uint64_t)first - step);
+        for (uint32_t i = count; i < n; i++)
+        {
+            v[i + 1] = (int64_t)((uint64_t)v[i] + step);
+        }
+
+        // difference to the step, zigzag: small magnitudes -> few bits
+        uint64_t any = 0;
+        for (uint32_t g = 0; g < n/64; g++)
+        {
+            zigzag64(&v[64*g + 1], &v[64*g], step, &zigzag[64*g]);
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            any |= zigzag[i];
+        }
+
+        unsigned bits = any ? 64 - __builtin_clzll(any) : 0;
+        header.first[c] = first;
+        header.step[c]  = (int64_t)step;
+        header.bits[c]  = (uint8_t)bits;
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        size_t at = words.size();
+        words.resize(at + (size_t)n/64*bits);
+        for (uint32_t g = 0; g < n/64; g++)
+        {
+            table.pack[bits](&zigzag[64*g], &words[at + (size_t)g*bits]);
+        }
+    }
+
+    std::string text;
+    for (size_t m = 0; m < message_count; m++)
+    {
+        uint32_t sample = (uint32_t)messages[m].sample;
+        uint16_t length = (uint16_t)std::min(messages[m].text.size(), (size_t)UINT16_MAX);
+        text.append((const char*)&sample, sizeof(sample));
+        text.append((const char*)&length, sizeof(length));
+        text.append(messages[m].text, 0, length);
+    }
+
+    header.column_bytes  = (uint32_t)(words.size()*sizeof(uint64_t));
+    header.message_bytes = (uint32_t)text.size();
+
+    out.clear();
+    out.reserve(sizeof(header) + header.column_bytes + header.message_bytes);
+    out.append((const char*)&header, sizeof(header));
+    out.append((const char*)words.data(), header.column_bytes);
+    out.append(text);
+}
+
+static bool
+valid_block(const Archive_Block_Header &header)
+{
+    if (memcmp(header.magic, "BLCK", 4) != 0 || header.count > ARCHIVE_BLOCK)
+    {
+        return false;
+    }
+    size_t words = 0;
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+    {
+        if (header.bits[c] > 64)
+        {
+            return false;
+        }
+        words += (size_t)padded(header.count)/64*header.bits[c];
+    }
+    return words*sizeof(uint64_t) == header.column_bytes;
+}
+
+static void
+decode_block(const Archive_Block_Header &header, const uint64_t *words, const std::string &text,
+             Telemetry_Sample *out, uint64_t first_sample, std::vector<Archive_Message> *messages)
+{
+    const Pack_Table &table = pack_table();
+    const uint32_t count = header.count;
+    const uint32_t n     = padded(count);
+
+    std::vector<uint64_t> zigzag(n);
+    std::vector<int64_t>  v(n);
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+    {
+        unsigned bits = header.bits[c];
+        if (bits == 0)
+        {
+            std::fill(zigzag.begin(), zigzag.end(), 0);
+        }
+        else
+        {
+            for (uint32_t g = 0; g < n/64; g++)
+            {
+                table.unpack[bits](&words[(size_t)g*bits], &zigzag[64*g]);
+            }
+            words += (size_t)n/64*bits;
+        }
+
+        const uint64_t step = (uint64_t)header.step[c];
+        for (uint32_t g = 0; g < n/64; g++)
+        {
+            unzigzag64(&zigzag[64*g], step, &v[64*g]);
+        }
+        if (count)
+        {
+            v[0] = header.first[c];
+        }
+        for (uint32_t i = 1; i < count; i++)
+        {
+            v[i] = (int64_t)((uint64_t)v[i - 1] + (uint64_t)v[i]);
+        }
+        set_column(out, count, c, v.data());
+    }
+
+    if (!messages)
+    {
+        return;
+    }
+    size_t at = 0;
+    while (at + 6 <= text.size())
+    {
+        uint32_t sample;
+        uint16_t length;
+        memcpy(&sample, &text[at], sizeof(sample));
+        memcpy(&length, &text[at + 4], sizeof(length));
+        at += 6;
+        if (at + length > text.size())
+        {
+            break;
+        }
+        Archive_Message message;
+        message.sample = first_sample + sample;
+        message.text.assign(text, at, length);
+        messages->push_back(message);
+        at += length;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Threads
+// ------------------------------------------------------------------------------
+struct Parallel_Job
+{
+    std::atomic<size_t> next;
+    size_t count;
+    std::function<void(size_t)> work;
+};
+
+static void*
+parallel_thread(void *args)
+{
+    Parallel_Job *job = (Parallel_Job*)args;
+    size_t i;
+    while ((i = job->next.fetch_add(1)) < job->count)
+    {
+        job->work(i);
+    }
+    return NULL;
+}
+
+// work(0 .. count-1) on `threads` threads (0: one per CPU), the caller's included
+static void
+parallel_for(size_t count, int threads, const std::function<void(size_t)> &work)
+{
+    if (threads <= 0)
+    {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    threads = (int)std::max((size_t)1, std::min((size_t)threads, count));
+
+    Parallel_Job job;
+    job.next.store(0);
+    job.count = count;
+    job.work  = work;
+
+    std::vector<pthread_t> tids;
+    for (int t = 1; t < threads; t++)
+    {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, &parallel_thread, &job) == 0)
+        {
+            tids.push_back(tid);
+        }
+    }
+    parallel_thread(&job);
+    for (size_t t = 0; t < tids.size(); t++)
+    {
+        pthread_join(tids[t], NULL);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Writer
+// ------------------------------------------------------------------------------
+Archive_Writer::
+Archive_Writer()
+{
+    file    = NULL;
+    failed  = false;
+    samples = 0;
+    bytes   = 0;
+}
+
+Archive_Writer::
+~Archive_Writer()
+{
+    close();
+}
+
+bool
+Archive_Writer::
+open(const char *path)
+{
+    close();
+
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    Archive_Header header;
+    memcpy(header.magic, ARCHIVE_MAGIC, 4);
+    header.version       = ARCHIVE_VERSION;
+    header.columns       = ARCHIVE_COLUMNS;
+    header.block_samples = ARCHIVE_BLOCK;
+
+    failed  = fwrite(&header, sizeof(header), 1, file) != 1;
+    samples = 0;
+    bytes   = sizeof(header);
+    pending.clear();
+    pending_messages.clear();
+    index.clear();
+    return !failed;
+}
+
+bool
+Archive_Writer::
+close()
+{
+    if (!file)
+    {
+        return true;
+    }
+
+    if (!pending.empty() || !pending_messages.empty())
+    {
+        std::string block;
+        encode_block(pending.data(), pending.size(), pending_messages.data(), pending_messages.size(), block);
+        put(block, pending.size(), pending.empty() ? 0 : pending[0].time);
+        pending.clear();
+        pending_messages.clear();
+    }
+
+    Archive_Trailer trailer;
+    trailer.index_offset = bytes;
+    trailer.blocks       = index.size();
+    memcpy(trailer.magic, "BLIX", 4);
+    if (!index.empty() && fwrite(index.data(), sizeof(index[0]), index.size(), file) != index.size())
+    {
+        failed = true;
+    }
+    if (fwrite(&trailer, sizeof(trailer), 1, file) != 1 || fclose(file) != 0)
+    {
+        failed = true;
+    }
+    file = NULL;
+    index.clear();
+    if (failed)
+    {
+        fprintf(stderr, "archive: write error\n");
+    }
+    return !failed;
+}
+
+bool
+Archive_Writer::
+is_open() const
+{
+    return file != NULL;
+}
+
+void
+Archive_Writer::
+write(const Telemetry_Sample &sample)
+{
+    if (!file)
+    {
+        return;
+    }
+
+    pending.push_back(sample);
+    samples++;
+    if (pending.size() == ARCHIVE_BLOCK)
+    {
+        std::string block;
+        encode_block(pending.data(), pending.size(), pending_messages.data(), pending_messages.size(), block);
+        put(block, pending.size(), pending[0].time);
+        pending.clear();
+        pending_messages.clear();
+    }
+}
+
+void
+Archive_Writer::
+write_message(const std::string &message)
+{
+    if (!file)
+    {
+        return;
+    }
+
+    Archive_Message m;
+    m.sample = pending.size();
+    m.text   = message;
+    pending_messages.push_back(m);
+}
+
+bool
+Archive_Writer::
+write_all(const std::vector<Telemetry_Sample> &all, const std::vector<Archive_Message> &messages, int threads)
+{
+    if (!file)
+    {
+        return false;
+    }
+    if (!pending.empty() || !pending_messages.empty())
+    {
+        fprintf(stderr, "archive: write_all after write\n");
+        return false;
+    }
+
+    size_t count = std::max((size_t)1, (all.size() + ARCHIVE_BLOCK - 1)/ARCHIVE_BLOCK);
+
+    // messages of each block, relative to it (sorted by sample)
+    std::vector<std::vector<Archive_Message> > block_messages(count);
+    for (size_t m = 0; m < messages.size(); m++)
+    {
+        size_t b = std::min((size_t)(messages[m].sample/ARCHIVE_BLOCK), count - 1);
+        Archive_Message relative = messages[m];
+        relative.sample = std::min(messages[m].sample - (uint64_t)b*ARCHIVE_BLOCK, (uint64_t)ARCHIVE_BLOCK);
+        block_messages[b].push_back(relative);
+    }
+
+    std::vector<std::string> blocks(count);
+    parallel_for(count, threads, [&](size_t b){
+        size_t first = b*ARCHIVE_BLOCK;
+        size_t n     = std::min((size_t)ARCHIVE_BLOCK, all.size() - std::min(first, all.size()));
+        encode_block(all.data() + first, n, block_messages[b].data(), block_messages[b].size(), blocks[b]);
+    });
+
+    for (size_t b = 0; b < count && !failed; b++)
+    {
+        size_t first = b*ARCHIVE_BLOCK;
+        size_t n     = std::min((size_t)ARCHIVE_BLOCK, all.size() - std::min(first, all.size()));
+        put(blocks[b], n, n ? all[first].time : 0);
+    }
+    samples += all.size();
+    return !failed;
+}
+
+bool
+Archive_Writer::
+put(const std::string &block, uint32_t count, double first_time)
+{
+    Archive_Index_Entry entry;
+    entry.offset       = bytes;
+    entry.first_sample = index.empty() ? 0 : index.back().first_sample + index.back().count;
+    entry.first_time   = first_time;
+    entry.count        = count;
+    entry.pad          = 0;
+
+    if (fwrite(block.data(), 1, block.size(), file) != block.size())
+    {
+        failed = true;
+        return false;
+    }
+    index.push_back(entry);
+    bytes += block.size();
+    return true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Reader
+// ------------------------------------------------------------------------------
+Archive_Reader::
+Archive_Reader()
+{
+    fd = -1;
+}
+
+Archive_Reader::
+~Archive_Reader()
+{
+    close();
+}
+
+bool
+Archive_Reader::
+is_archive(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    char magic[4];
+    bool is = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, ARCHIVE_MAGIC, 4) == 0;
+    fclose(file);
+    return is;
+}
+
+bool
+Archive_Reader::
+open(const char *path_)
+{
+    close();
+    path = path_;
+
+    fd = ::open(path_, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path_);
+        close();
+        return false;
+    }
+    uint64_t size = st.st_size;
+
+    Archive_Header header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, ARCHIVE_MAGIC, 4) != 0 ||
+        header.version != ARCHIVE_VERSION || header.columns != ARCHIVE_COLUMNS)
+    {
+        fprintf(stderr, "%s: not an archive (version %d)\n", path_, ARCHIVE_VERSION);
+        close();
+        return false;
+    }
+
+    Archive_Trailer trailer;
+    if (size >= sizeof(header) + sizeof(trailer) &&
+        pread(fd, &trailer, sizeof(trailer), size - sizeof(trailer)) == (ssize_t)sizeof(trailer) &&
+        memcmp(trailer.magic, "BLIX", 4) == 0 &&
+        trailer.index_offset + (uint64_t)trailer.blocks*sizeof(Archive_Index_Entry) + sizeof(trailer) == size)
+    {
+        index.resize(trailer.blocks);
+        ssize_t length = index.size()*sizeof(Archive_Index_Entry);
+        if (pread(fd, index.data(), length, trailer.index_offset) == length)
+        {
+            return true;
+        }
+    }
+
+    // not closed: the blocks that made it to the disk
+    fprintf(stderr, "%s: no index, scanning the blocks\n", path_);
+    return scan(size);
+}
+
+void
+Archive_Reader::
+close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    index.clear();
+}
+
+bool
+Archive_Reader::
+scan(uint64_t size)
+{
+    index.clear();
+    uint64_t offset = sizeof(Archive_Header);
+    uint64_t sample = 0;
+    Archive_Block_Header header;
+    while (offset + sizeof(header) <= size &&
+           pread(fd, &header, sizeof(header), offset) == (ssize_t)sizeof(header) && valid_block(header))
+    {
+        uint64_t end = offset + sizeof(header) + header.column_bytes + header.message_bytes;
+        if (end > size)
+        {
+            break;
+        }
+        Archive_Index_Entry entry;
+        entry.offset       = offset;
+        entry.first_sample = sample;
+        entry.first_time   = 1e-6*header.first[ARCHIVE_TIME];
+        entry.count        = header.count;
+        entry.pad          = 0;
+        index.push_back(entry);
+        sample += header.count;
+        offset  = end;
+    }
+    return true;
+}
+
+uint64_t
+Archive_Reader::
+samples() const
+{
+    return index.empty() ? 0 : index.back().first_sample + index.back().count;
+}
+
+const std::vector<Archive_Index_Entry>&
+Archive_Reader::
+blocks() const
+{
+    return index;
+}
+
+size_t
+Archive_Reader::
+find(double time) const
+{
+    size_t lo = 0, hi = index.size();
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi)/2;
+        if (index[mid].first_time <= time)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool
+Archive_Reader::
+read_block(size_t block, std::vector<Telemetry_Sample> &samples, std::vector<Archive_Message> *messages) const
+{
+    if (block >= index.size())
+    {
+        return false;
+    }
+    const Archive_Index_Entry &entry = index[block];
+
+    Archive_Block_Header header;
+    if (pread(fd, &header, sizeof(header), entry.offset) != (ssize_t)sizeof(header) ||
+        !valid_block(header) || header.count != entry.count)
+    {
+        fprintf(stderr, "%s: bad block %zu\n", path.c_str(), block);
+        return false;
+    }
+
+    std::vector<uint64_t> words(header.column_bytes/sizeof(uint64_t));
+    std::string text(header.message_bytes, '\0');
+    uint64_t at = entry.offset + sizeof(header);
+    if (pread(fd, words.data(), header.column_bytes, at) != (ssize_t)header.column_bytes ||
+        pread(fd, &text[0], header.message_bytes, at + header.column_bytes) != (ssize_t)header.message_bytes)
+    {
+        fprintf(stderr, "%s: short block %zu\n", path.c_str(), block);
+        return false;
+    }
+
+    samples.resize(header.count);
+    decode_block(header, words.data(), text, samples.data(), entry.first_sample, messages);
+    return true;
+}
+
+bool
+Archive_Reader::
+read_all(std::vector<Telemetry_Sample> &samples_, int threads, std::vector<Archive_Message> *messages) const
+{
+    samples_.resize(samples());
+
+    std::vector<std::vector<Archive_Message> > block_messages(index.size());
+    std::atomic<bool> ok(true);
+    parallel_for(index.size(), threads, [&](size_t b){
+        std::vector<Telemetry_Sample> block;
+        if (!read_block(b, block, messages ? &block_messages[b] : NULL))
+        {
+            ok.store(false);
+            return;
+        }
+        std::copy(block.begin(), block.end(), samples_.begin() + index[b].first_sample);
+    });
+
+    if (messages)
+    {
+        for (size_t b = 0; b < block_messages.size(); b++)
+        {
+            messages->insert(messages->end(), block_messages[b].begin(), block_messages[b].end());
+        }
+    }
+    return ok.load();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Conversion
+// ------------------------------------------------------------------------------
+bool
+archive_convert(const char *tsv_path, const char *archive_path, int threads)
+{
+    FILE *file = fopen(tsv_path, "r");
+    if (!file)
+    {
+        perror(tsv_path);
+        return false;
+    }
+
+    std::vector<Telemetry_Sample> samples;
+    std::vector<Archive_Message>  messages;
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#')
+        {
+            if (strncmp(line, "# seq\t", 6) != 0) // the header
+            {
+                Archive_Message m;
+                m.sample = samples.size();
+                m.text   = line[1] == ' ' ? line + 2 : line + 1;
+                messages.push_back(m);
+            }
+            continue;
+        }
+
+        Telemetry_Sample s;
+        if (7 == sscanf(line, "%u %u %d %d %d %lf %lf", &s.seq, &s.tick, &s.rpm, &s.setpoint, &s.pulse,
+                        &s.time, &s.host_time))
+        {
+            samples.push_back(s);
+        }
+    }
+    fclose(file);
+
+    Archive_Writer writer;
+    if (!writer.open(archive_path))
+    {
+        return false;
+    }
+    bool ok = writer.write_all(samples, messages, threads);
+    return writer.close() && ok;
+}
@@ -0,0 +1,192 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "telemetry.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define ARCHIVE_MAGIC     "BLAR"
+#define ARCHIVE_VERSION   1
+#define ARCHIVE_EXTENSION ".bla"
+#define ARCHIVE_BLOCK     4096  // samples per block (41 s at 100 Hz), a multiple of 64
+#define ARCHIVE_COLUMNS   7
+
+// column order in a block
+#define ARCHIVE_SEQ       0
+#define ARCHIVE_TICK      1
+#define ARCHIVE_TIME      2     // firmware time base, us
+#define ARCHIVE_HOST_TIME 3     // host arrival time, us
+#define ARCHIVE_RPM       4
+#define ARCHIVE_SETPOINT  5
+#define ARCHIVE_PULSE     6
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+// on disk, little endian (x86 and ARM hosts)
+struct Archive_Header
+{
+    char     magic[4];      // ARCHIVE_MAGIC
+    uint32_t version;
+    uint32_t columns;
+    uint32_t block_samples;
+};
+
+struct Archive_Block_Header
+{
+    char     magic[4];      // "BLCK"
+    uint32_t count;         // samples in the block
+    uint32_t message_bytes; // after the columns
+    uint32_t column_bytes;  // all the columns
+    int64_t  first[ARCHIVE_COLUMNS];
+    int64_t  step[ARCHIVE_COLUMNS];
+    uint8_t  bits[ARCHIVE_COLUMNS];
+    uint8_t  pad;
+};
+
+struct Archive_Index_Entry
+{
+    uint64_t offset;        // of the Archive_Block_Header
+    uint64_t first_sample;
+    double   first_time;    // firmware time base, s
+    uint32_t count;
+    uint32_t pad;
+};
+
+struct Archive_Trailer
+{
+    uint64_t index_offset;
+    uint32_t blocks;
+    char     magic[4];      // "BLIX"
+};
+
+// a firmware message, written before sample number `sample`
+struct Archive_Message
+{
+    uint64_t    sample;
+    std::string text;
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Archive Writer Class
+// ----------------------------------------------------------------------------------
+/*
+ * Archive Writer Class
+ *
+ * Compressed columnar file for long captures (weeks at 100 Hz). The
+ * samples go in blocks of ARCHIVE_BLOCK, one column per field. In a block
+ * each column keeps its first value and its first difference (step); the
+ * other samples are stored as the zigzag of their difference minus the
+ * step, bit-packed at the width of the largest one. Slowly changing RPM
+ * and set-points take a few bits a sample, and the time columns, whose
+ * differences are the tick period, next to none.
+ *
+ *      Archive_Header
+ *      block: Archive_Block_Header, the columns in column order (each
+ *             count rounded up to 64 values of bits[c] bits, LSB first, in
+ *             64 bit words), then the messages: u32 sample in the block,
+ *             u16 length, text
+ *      ...
+ *      index: an Archive_Index_Entry per block
+ *      Archive_Trailer
+ *
+ * Blocks are independent, so they are encoded (write_all) and decoded
+ * (Archive_Reader::read_all) on several threads. The index at the end
+ * gives random seek; a file whose writer never closed it (no trailer) is
+ * still read, by walking the block headers.
+ */
+class Archive_Writer
+{
+
+public:
+
+    Archive_Writer();
+    ~Archive_Writer();
+
+    bool open(const char *path);
+    bool close(); // writes the last block and the index
+    bool is_open() const;
+
+    // streaming, a block is encoded when it fills
+    void write(const Telemetry_Sample &sample);
+    void write_message(const std::string &message);
+
+    // a whole capture, blocks encoded on `threads` threads
+    bool write_all(const std::vector<Telemetry_Sample> &samples,
+                   const std::vector<Archive_Message> &messages, int threads);
+
+    uint64_t samples; // written since open
+    uint64_t bytes;   // of the file so far
+
+private:
+
+    FILE *file;
+    bool  failed;
+
+    std::vector<Telemetry_Sample>    pending;
+    std::vector<Archive_Message>     pending_messages; // sample relative to the block
+    std::vector<Archive_Index_Entry> index;
+
+    bool put(const std::string &block, uint32_t count, double first_time);
+
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Archive Reader Class
+// ----------------------------------------------------------------------------------
+/*
+ * Archive Reader Class
+ *
+ * Reads an Archive_Writer file. Blocks are read with pread(), so
+ * read_block() may be called from several threads at once.
+ */
+class Archive_Reader
+{
+
+public:
+
+    Archive_Reader();
+    ~Archive_Reader();
+
+    static bool is_archive(const char *path);
+
+    bool open(const char *path);
+    void close();
+
+    uint64_t samples() const;
+    const std::vector<Archive_Index_Entry>& blocks() const;
+    size_t find(double time) const; // block holding this firmware time
+
+    bool read_block(size_t block, std::vector<Telemetry_Sample> &samples,
+                    std::vector<Archive_Message> *messages = NULL) const;
+    bool read_all(std::vector<Telemetry_Sample> &samples, int threads,
+                  std::vector<Archive_Message> *messages = NULL) const;
+
+private:
+
+    int         fd;
+    std::string path;
+    std::vector<Archive_Index_Entry> index;
+
+    bool scan(uint64_t size); // index from the block headers
+
+};
+
+// recording (recorder.h) -> archive
+bool archive_convert(const char *tsv_path, const char *archive_path, int threads);
+
+
+#endif // ARCHIVE_H_
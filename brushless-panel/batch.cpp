@@ -0,0 +1,343 @@
+// Step response metrics of many recorded runs at once, for a directory of
+// captures.
+//
+// usage: brushless_batch.run [-j threads] [-q] directory|recording ...
+//      -j: worker threads (0: one per CPU)
+//      -q: no progress or timing lines on stderr
+//
+// Takes the *.tsv and *.bla recordings of each directory (see recorder.h
+// and archive.h) and any recording named directly. Each run is streamed:
+// text recordings line by line through Telemetry::parse_line, archives
+// block by block, into a Live_Stats, the same code as the panel's Stats
+// window. The runs are spread over a Work_Pool (work stealing), so a few
+// long captures don't hold up the rest.
+//
+// stdout, tab separated, a line per run in name order and "all" (sums of
+// the counts, means of the metrics over the runs that have them):
+//      run samples dropped steps rise_s overshoot_pct settling_s sse_rpm noise_rpm
+//
+//      steps          set-point changes of LIVE_STEP_MIN rpm or more
+//      rise_s         mean over the steps, change -> 90% (dead time included)
+//      overshoot_pct  mean over the steps
+//      settling_s     mean over the settled steps (LIVE_SETTLE_BAND)
+//      sse_rpm        mean set-point - rpm once settled
+//      noise_rpm      standard deviation of set-point - rpm once settled
+// "-" when a run has no (settled) step, e.g. open loop.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include "telemetry.h"
+#include "live_stats.h"
+#include "archive.h"
+#include "work_pool.h"
+
+#define BATCH_LINE   256
+#define BATCH_BUFFER 262144 // stdio buffer of each recording
+
+struct Run_Result
+{
+    std::string path;
+    bool     ok;
+    uint64_t samples;
+    uint32_t dropped;
+    uint32_t steps;
+    uint32_t risen;         // steps that reached 90%
+    uint32_t settled;
+    double   rise_sum;
+    double   overshoot_sum;
+    double   settling_sum;
+    double   error_sum;     // settled samples
+    double   error_sum2;
+    uint64_t error_count;
+};
+
+// follows the steps of Live_Stats sample by sample: a step is counted
+// once its snapshot is replaced by the next one, or at the end
+struct Run_Analysis
+{
+    Live_Stats    stats;
+    Live_Snapshot snapshot;
+    Step_Response step;
+    bool          in_step;
+    Run_Result   *result;
+
+    void start(Run_Result *result_){
+        stats.reset();
+        step = Step_Response();
+        step.start = -1;
+        in_step = false;
+        result  = result_;
+    }
+
+    void add(const Telemetry_Sample &sample){
+        stats.update(sample);
+        stats.snapshot(snapshot);
+        const Step_Response &s = snapshot.step;
+        if(s.start != step.start || s.to != step.to){
+            finish();
+            in_step = s.to > 0 && abs(s.to - s.from) >= LIVE_STEP_MIN;
+        }
+        step = s;
+        result->samples++;
+
+        // steady state: after settling, while the set-point holds
+        if(in_step && step.done && step.settling_time >= 0 && sample.setpoint == step.to){
+            double error = sample.setpoint - sample.rpm;
+            result->error_sum  += error;
+            result->error_sum2 += error*error;
+            result->error_count++;
+        }
+    }
+
+    void finish(){
+        if(!in_step){
+            return;
+        }
+        in_step = false;
+        result->steps++;
+        result->overshoot_sum += step.overshoot;
+        if(step.rise_time >= 0){
+            result->rise_sum += step.rise_time;
+            result->risen++;
+        }
+        if(step.settling_time >= 0){
+            result->settling_sum += step.settling_time;
+            result->settled++;
+        }
+    }
+};
+
+static bool has_suffix(const std::string &s, const char *suffix){
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static bool is_recording(const std::string &path){
+    return has_suffix(path, ".tsv") || has_suffix(path, ARCHIVE_EXTENSION);
+}
+
+// the recordings of a directory, or the file itself
+static bool list_runs(const char *path, std::vector<std::string> &runs){
+    struct stat st;
+    if(stat(path, &st) != 0){
+        perror(path);
+        return false;
+    }
+    if(!S_ISDIR(st.st_mode)){
+        runs.push_back(path);
+        return true;
+    }
+
+    DIR *dir = opendir(path);
+    if(!dir){
+        perror(path);
+        return false;
+    }
+    std::string base = path;
+    if(!base.empty() && base[base.size() - 1] != '/'){
+        base += '/';
+    }
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        std::string name = base + entry->d_name;
+        if(entry->d_name[0] != '.' && is_recording(name)){
+            runs.push_back(name);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+static bool analyze_text(const char *path, Run_Analysis &analysis){
+    FILE *file = fopen(path, "r");
+    if(!file){
+        perror(path);
+        return false;
+    }
+    std::vector<char> buffer(BATCH_BUFFER);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    // "seq tick rpm setpoint pulse time host_time": the firmware line is
+    // the first five columns, which go through the panel's parser
+    Telemetry telemetry;
+    Telemetry_Sample sample;
+    char line[BATCH_LINE];
+    std::string firmware_line;
+    while(fgets(line, sizeof(line), file)){
+        if(line[0] == '#'){
+            continue;
+        }
+        char *end = line;
+        for(int tabs = 0; *end && *end != '\n'; end++){
+            if(*end == '\t' && ++tabs == 5){
+                break;
+            }
+        }
+        firmware_line.assign(line, end - line);
+        if(telemetry.parse_line(firmware_line, 0, sample)){
+            analysis.add(sample);
+        }
+    }
+    fclose(file);
+    analysis.result->dropped = telemetry.dropped;
+    return true;
+}
+
+static bool analyze_archive(const char *path, Run_Analysis &analysis){
+    Archive_Reader reader;
+    if(!reader.open(path)){
+        return false;
+    }
+    std::vector<Telemetry_Sample> block;
+    uint32_t last_seq = 0;
+    bool first = true;
+    for(size_t b = 0; b < reader.blocks().size(); b++){
+        if(!reader.read_block(b, block)){
+            return false;
+        }
+        for(size_t i = 0; i < block.size(); i++){
+            // seq is already unwrapped: gaps are the lost lines
+            if(!first && block[i].seq > last_seq + 1){
+                analysis.result->dropped += block[i].seq - last_seq - 1;
+            }
+            first = false;
+            last_seq = block[i].seq;
+            analysis.add(block[i]);
+        }
+    }
+    return true;
+}
+
+static void print_metric(double sum, uint32_t count, const char *format){
+    if(count){
+        printf(format, sum/count);
+    }else{
+        printf("\t-");
+    }
+}
+
+static void print_row(const char *name, uint64_t samples, uint64_t dropped, uint32_t steps,
+                      double rise, uint32_t risen, double overshoot, uint32_t overshoots,
+                      double settling, uint32_t settled, double sse, uint32_t sse_count,
+                      double noise, uint32_t noise_count){
+    printf("%s\t%llu\t%llu\t%u", name, (unsigned long long)samples, (unsigned long long)dropped, steps);
+    print_metric(rise, risen, "\t%.3f");
+    print_metric(overshoot, overshoots, "\t%.1f");
+    print_metric(settling, settled, "\t%.3f");
+    print_metric(sse, sse_count, "\t%.1f");
+    print_metric(noise, noise_count, "\t%.1f");
+    printf("\n");
+}
+
+int main(int argc, char *argv[]){
+    int threads = 0;
+    bool quiet = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "j:q"))){
+        switch(opt){
+            case 'j': threads = atoi(optarg); break;
+            case 'q': quiet = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-j threads] [-q] directory|recording ...\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind >= argc){
+        fprintf(stderr, "usage: %s [-j threads] [-q] directory|recording ...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> runs;
+    for(int i = optind; i < argc; i++){
+        if(!list_runs(argv[i], runs)){
+            return EXIT_FAILURE;
+        }
+    }
+    std::sort(runs.begin(), runs.end());
+    if(runs.empty()){
+        fprintf(stderr, "no recordings (*.tsv, *%s)\n", ARCHIVE_EXTENSION);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Run_Result> results(runs.size());
+    Work_Pool pool(threads);
+    std::vector<Run_Analysis*> analyses(pool.threads()); // one per worker, Live_Stats is large
+    for(size_t i = 0; i < analyses.size(); i++){
+        analyses[i] = new Run_Analysis;
+    }
+
+    std::atomic<uint32_t> done(0);
+    const bool progress = !quiet && isatty(STDERR_FILENO);
+    const double start = Telemetry::now();
+    pool.run(runs.size(), [&](size_t task, int worker){
+        Run_Result &result = results[task];
+        result = Run_Result();
+        result.path = runs[task];
+
+        Run_Analysis &analysis = *analyses[worker];
+        analysis.start(&result);
+        const char *path = runs[task].c_str();
+        result.ok = Archive_Reader::is_archive(path) ? analyze_archive(path, analysis)
+                                                     : analyze_text(path, analysis);
+        analysis.finish();
+
+        uint32_t n = ++done;
+        if(progress && (n % 16 == 0 || n == runs.size())){
+            fprintf(stderr, "\r%u/%zu runs", n, runs.size());
+        }
+    });
+    const double elapsed = Telemetry::now() - start;
+    for(size_t i = 0; i < analyses.size(); i++){
+        delete analyses[i];
+    }
+
+    printf("run\tsamples\tdropped\tsteps\trise_s\tovershoot_pct\tsettling_s\tsse_rpm\tnoise_rpm\n");
+    uint64_t samples = 0, dropped = 0;
+    uint32_t steps = 0, failed = 0;
+    double   rise = 0, overshoot = 0, settling = 0, sse = 0, noise = 0;
+    uint32_t risen = 0, overshoots = 0, settled = 0, steady = 0;
+    for(size_t i = 0; i < results.size(); i++){
+        const Run_Result &r = results[i];
+        if(!r.ok){
+            failed++;
+            continue;
+        }
+        double mean  = r.error_count ? r.error_sum/r.error_count : 0;
+        double var   = r.error_count > 1 ? (r.error_sum2 - r.error_count*mean*mean)/(r.error_count - 1) : 0;
+        double sigma = sqrt(std::max(0.0, var));
+        uint32_t has_steady = r.error_count > 0;
+        print_row(r.path.c_str(), r.samples, r.dropped, r.steps, r.rise_sum, r.risen,
+                  r.overshoot_sum, r.steps, r.settling_sum, r.settled, mean, has_steady, sigma, has_steady);
+
+        samples += r.samples;
+        dropped += r.dropped;
+        steps   += r.steps;
+        if(r.risen){ rise += r.rise_sum/r.risen; risen++; }
+        if(r.steps){ overshoot += r.overshoot_sum/r.steps; overshoots++; }
+        if(r.settled){ settling += r.settling_sum/r.settled; settled++; }
+        if(has_steady){ sse += mean; noise += sigma; steady++; }
+    }
+    print_row("all", samples, dropped, steps, rise, risen, overshoot, overshoots, settling, settled,
+              sse, steady, noise, steady);
+
+    if(!quiet){
+        fprintf(stderr, "%s%zu runs, %llu samples in %.2f s (%.1f M samples/s, %d threads, %u stolen)\n",
+                progress ? "\r" : "", runs.size(), (unsigned long long)samples, elapsed, 1e-6*samples/elapsed,
+                pool.threads(), pool.steals());
+    }
+    if(failed){
+        fprintf(stderr, "%u runs could not be read\n", failed);
+    }
+    return failed ? EXIT_FAILURE : 0;
+}
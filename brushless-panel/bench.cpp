@@ -0,0 +1,1472 @@
+// Benchmarks of the telemetry path and of the controller, for "make bench".
+//
+// usage: bench.run [-n lines] [-c cycles] [-H cycles] [-m motors]
+//                  [-S simulator] [-b baseline.tsv] [-r pct] [-R name]
+//      -n: lines sent through the pty in the throughput run (50000)
+//      -c: open/close cycles of the reconnect run (1000). Built with
+//          BENCH_FLAGS=-fsanitize=thread (or address) it doubles as the
+//          lifecycle stress test of Serial_Port/BrushlessSerial
+//      -H: unplug/replug cycles of the hot-plug run (20)
+//      -m: largest motor count of the scaling run, by powers of 2 (16, 0
+//          skips it)
+//      -S: also runs this simulator.run and reports its step rate and the
+//          firmware RX test; its step response is what the motors of the
+//          scaling run send
+//      -b: compares against an earlier output of bench.run and prints a
+//          "regression" line for each result more than -r % worse; the exit
+//          status is then 2
+//      -r: tolerance of the comparison, in % (20)
+//      -R: only the reconnect and hot-plug runs, with the results named
+//          name_reconnect_*, name_hotplug_*. For builds of Serial_Port
+//          with another read strategy (SERIAL_PORT_READ), which must see
+//          the adapter go as the default one does
+//
+// stdout, tab separated, one "name value" per line. The unit is the suffix
+// of the name; *_per_s and *_x are better when higher, the rest (times)
+// when lower:
+//      parse_ns             Telemetry::parse_line, per line
+//      consumers_ns         System_Id + Live_Stats update, per sample
+//      server_publish_ns    Telemetry_Server::publish, subscribers stalled
+//      control_pid_ns       control_filter + control_step (host build)
+//      control_smith_ns     same, PI-D + Smith predictor
+//      store_push_ns        Sample_Store::push, per sample (all channels)
+//      plot_decimate_us     min/max of 3 channels x 8192 samples into 1000
+//                           pixel columns (one Strip_Plot redraw)
+//      pty_lines_per_s      burst through a pty into BrushlessSerial
+//      pty_mbytes_per_s
+//      pty_latency_p50_us   write to the master -> on_data, at 1 kHz
+//      pty_latency_p99_us
+//      handoff_p50_us       on_data -> consumer thread holding the sample
+//      handoff_p99_us
+//      plot_update_ns       values (store view) + telemetry_stats (one UI frame)
+//      plot_update_busy_ns  same, during the burst
+//      command_ack_p50_us   BrushlessSerial::command -> firmware echo (pty)
+//      command_ack_p99_us
+//      command_burst_writes lines written for 1000 set-points queued at once
+//      reconnect_open_p50_us    Serial_Port + BrushlessSerial start, 10 kHz
+//      reconnect_open_p99_us    lines flowing
+//      reconnect_line_p50_us    open -> first sample
+//      reconnect_close_p50_us   BrushlessSerial + Serial_Port stop
+//      reconnect_close_p99_us
+//      hotplug_p50_ms           pty symlink created -> first sample, 100 Hz
+//      hotplug_max_ms           lines (auto reconnect, target < 100 ms)
+//      port_R_B_F_p50_us        write to the master -> read_message, at 1 kHz,
+//      port_R_B_F_p99_us        of Basic_Serial_Port with read strategy R
+//      port_R_B_F_cpu_pct       (blocking, poll, busy), buffer B (byte,
+//                               chunk) and flow control F (none, rtscts;
+//                               no effect on a pty); CPU of the read loop
+//      scale_pool_cpu_pct_N     CPU of N motors at 100 Hz read by the Io_Pool
+//      scale_threads_cpu_pct_N  same, a read thread per motor
+//      scale_frame_us_N         one Motor_Dashboard frame of N motors
+//      archive_encode_per_s samples into an archive (archive.h), all CPUs
+//      archive_decode_per_s samples out of it
+//      archive_seek_us      open + find + decode of one block
+//      archive_ratio_x      recorder text size over archive size
+//      sim_steps_per_s      simulator integration steps (0.5 ms)
+//      sim_realtime_x       simulated time over wall time
+//      uart_lost_bytes      firmware RX bytes lost to bursts of 16 commands
+//                           at 460800 bps (simulator -u, must be 0)
+//      ident_gain_error_pct System_Id on the simulator step response (PI-D +
+//      ident_pole_error_pct Smith, unfiltered): gain and sum of the poles
+//                           against the nominal plant; fails when drifted,
+//                           unstable or invalid
+//      itoa_bad             firmware itoa/utoa results that differ from
+//                           printf (simulator -i, must be 0)
+//      regression name baseline value change_pct (with -b)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <atomic>
+#include <algorithm>
+#include "serial_port.h"
+#include "brushless_serial.h"
+#include "telemetry.h"
+#include "system_id.h"
+#include "live_stats.h"
+#include "io_pool.h"
+#include "telemetry_server.h"
+#include "archive.h"
+#include "sample_store.h"
+#include "plot_decimation.h"
+
+#include "control.h" // control.c and filter.c are built as C++ here
+
+#define BENCH_LATENCY_LINES 2000   // lines of the 1 kHz latency run
+#define BENCH_PORT_LINES    500    // same, per Serial_Port policy combination
+#define BENCH_TIMEOUT       20.0   // s, gives up on a stalled pty
+#define BENCH_REPEAT        3      // micro benchmarks report the best run
+#define BENCH_SCALE_TIME    1.0    // s of CPU time measured per motor count
+#define BENCH_ARCHIVE_SAMPLES 2000000 // 5.5 h at 100 Hz
+#define BENCH_DASHBOARD_PLOT    256  // DASHBOARD_PLOT_LEN, DASHBOARD_HISTORY (no
+#define BENCH_DASHBOARD_HISTORY 1024 // imgui here)
+#define BENCH_DASHBOARD_COLUMNS 530  // plot width of a row, default window
+#define BENCH_PLOT_SAMPLES  8192
+#define BENCH_PLOT_COLUMNS  1000
+
+static std::vector<std::pair<std::string, double> > results;
+
+static std::string result_prefix; // -R
+
+static void report(const char *name, double value){
+    std::string full = result_prefix + name;
+    printf("%s\t%.3f\n", full.c_str(), value);
+    fflush(stdout);
+    results.push_back(std::make_pair(full, value));
+}
+
+static double percentile(std::vector<double> v, double p){
+    if(v.empty()){
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p*(v.size() - 1))];
+}
+
+static int format_line(char *buf, size_t len, uint32_t n){
+    int rpm = 3000 + (int)(n*37 % 200) - 100;
+    return snprintf(buf, len, "%u\t%u\t%d\t%d\t%d\n", n & 0xffff, n, rpm, 3000, 1300 + (int)(n % 50));
+}
+
+static void sleep_until(double t){
+    double wait = t - Telemetry::now();
+    if(wait > 0){
+        struct timespec ts;
+        ts.tv_sec  = (time_t)wait;
+        ts.tv_nsec = (long)((wait - ts.tv_sec)*1e9);
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Micro benchmarks
+// ------------------------------------------------------------------------------
+static void bench_parse(){
+    const int lines = 200000;
+    std::vector<std::string> text(1024);
+    char buf[64];
+    for(size_t i = 0; i < text.size(); i++){
+        int len = format_line(buf, sizeof(buf), i);
+        text[i].assign(buf, len - 1);
+    }
+
+    Telemetry telemetry;
+    Telemetry_Sample sample;
+    double best = 1e9;
+    for(int run = 0; run < BENCH_REPEAT; run++){
+        uint32_t parsed = 0;
+        double t0 = Telemetry::now();
+        for(int i = 0; i < lines; i++){
+            if((i % text.size()) == 0){
+                telemetry.reset(); // the same seq again would be a restart
+            }
+            parsed += telemetry.parse_line(text[i % text.size()], t0, sample);
+        }
+        best = std::min(best, Telemetry::now() - t0);
+        if(parsed != (uint32_t)lines){
+            fprintf(stderr, "parse: %u of %d lines\n", parsed, lines);
+        }
+    }
+    report("parse_ns", 1e9*best/lines);
+}
+
+static void bench_consumers(){
+    const int samples = 200000;
+    Telemetry_Sample sample = Telemetry_Sample();
+    double best = 1e9;
+    for(int run = 0; run < BENCH_REPEAT; run++){
+        System_Id identifier;
+        Live_Stats stats;
+        double t0 = Telemetry::now();
+        for(int i = 0; i < samples; i++){
+            sample.seq      = i;
+            sample.tick     = i;
+            sample.time     = i*TELEMETRY_TICK_PERIOD;
+            sample.setpoint = ((i/500) & 1) ? 3500 : 3000;
+            sample.pulse    = 1300 + (i*7 % 40);
+            sample.rpm      = sample.setpoint + (i*37 % 200) - 100;
+            identifier.update(sample);
+            stats.update(sample);
+        }
+        best = std::min(best, Telemetry::now() - t0);
+    }
+    report("consumers_ns", 1e9*best/samples);
+}
+
+// publish() with stalled subscribers: their rings fill up and the samples
+// are dropped and counted, the ingest side must stay as fast
+static bool bench_server(){
+    const int samples = 100000;
+    const int clients = SERVER_MAX_CLIENTS/2;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench-sock-%d", (int)getpid());
+
+    Telemetry_Server server;
+    if(!server.start(std::string("unix:") + path)){
+        return false;
+    }
+    std::vector<int> fds;
+    for(int i = 0; i < clients; i++){
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+            perror(path);
+        }
+        fds.push_back(fd); // never read
+    }
+    std::vector<Subscriber_Stats> subscribers;
+    double t_wait = Telemetry::now();
+    while(server.subscribers(subscribers), (int)subscribers.size() < clients && Telemetry::now() - t_wait < 2){
+        usleep(1000);
+    }
+
+    Telemetry_Sample sample = Telemetry_Sample();
+    double t0 = Telemetry::now();
+    for(int i = 0; i < samples; i++){
+        sample.seq = sample.tick = i;
+        sample.rpm = 3000 + (i*37 % 200) - 100;
+        server.publish(sample);
+    }
+    double elapsed = Telemetry::now() - t0;
+
+    server.subscribers(subscribers);
+    bool ok = (int)subscribers.size() == clients;
+    for(size_t i = 0; i < subscribers.size(); i++){
+        const Subscriber_Stats &sub = subscribers[i];
+        if(sub.dropped == 0 || sub.sent + sub.dropped + sub.queued > (uint32_t)samples){
+            ok = false;
+        }
+    }
+    if(!ok){
+        fprintf(stderr, "server: %zu of %d subscribers, drops not counted\n", subscribers.size(), clients);
+    }
+    server.stop();
+    for(size_t i = 0; i < fds.size(); i++){
+        close(fds[i]);
+    }
+
+    report("server_publish_ns", 1e9*elapsed/samples);
+    return ok;
+}
+
+// the firmware control.c, built for the host
+static void bench_control(const char *name, int mode){
+    const int steps = 1000000;
+    volatile int16_t sink = 0;
+    double best = 1e9;
+    for(int run = 0; run < BENCH_REPEAT; run++){
+        control_reset();
+        control_command('m', mode);
+        double t0 = Telemetry::now();
+        for(int i = 0; i < steps; i++){
+            uint16_t rpm = 3000 + (i*37 % 200) - 100;
+            control_filter(rpm);
+            sink = control_step(((i/500) & 1) ? 3500 : 3000);
+        }
+        best = std::min(best, Telemetry::now() - t0);
+    }
+    (void)sink;
+    report(name, 1e9*best/steps);
+}
+
+static void bench_store(){
+    const int samples = 1000000;
+    Sample_Store store;
+    Telemetry_Sample sample = Telemetry_Sample();
+    double best = 1e9;
+    for(int run = 0; run < BENCH_REPEAT; run++){
+        store.reset();
+        double t0 = Telemetry::now();
+        for(int i = 0; i < samples; i++){
+            sample.time = i*TELEMETRY_TICK_PERIOD;
+            sample.rpm = 3000 + (i*37 % 200);
+            sample.setpoint = 3100;
+            store.push(sample);
+        }
+        best = std::min(best, Telemetry::now() - t0);
+    }
+    Sample_View view;
+    store.view(view);
+    if(view.count != store.capacity() - store.capacity()/SAMPLE_STORE_GUARD){
+        fprintf(stderr, "store: %u samples in view\n", view.count);
+    }
+    report("store_push_ns", 1e9*best/samples);
+}
+
+static void bench_plot_decimate(){
+    const int channels = 3, frames = 2000;
+    std::vector<float> ring[channels];
+    for(int k = 0; k < channels; k++){
+        ring[k].resize(BENCH_PLOT_SAMPLES);
+        for(int i = 0; i < BENCH_PLOT_SAMPLES; i++){
+            ring[k][i] = 3000 + 500*k + (i*37 % 200);
+        }
+    }
+    std::vector<float> lo(BENCH_PLOT_COLUMNS), hi(BENCH_PLOT_COLUMNS);
+    volatile float sink = 0;
+    double best = 1e9;
+    for(int run = 0; run < BENCH_REPEAT; run++){
+        double t0 = Telemetry::now();
+        for(int f = 0; f < frames; f++){
+            for(int k = 0; k < channels; k++){
+                decimate_min_max(ring[k].data(), BENCH_PLOT_SAMPLES, f % BENCH_PLOT_SAMPLES, BENCH_PLOT_SAMPLES, 0,
+                                 BENCH_PLOT_SAMPLES, BENCH_PLOT_COLUMNS, lo.data(), hi.data());
+                sink = sink + lo[f % BENCH_PLOT_COLUMNS];
+            }
+        }
+        best = std::min(best, Telemetry::now() - t0);
+    }
+    (void)sink;
+    report("plot_decimate_us", 1e6*best/frames);
+}
+
+
+// ------------------------------------------------------------------------------
+//   End to end: pty -> Serial_Port -> BrushlessSerial
+// ------------------------------------------------------------------------------
+struct Pty_Bench
+{
+    int master;
+    std::string slave;
+
+    BrushlessSerial *b_serial;
+
+    // filled by on_data (read thread)
+    std::atomic<uint32_t> lines;
+    std::atomic<uint64_t> data_time_ns;
+    std::atomic<bool>     timing;    // latency run
+    // by seq; atomic since TSan does not see the pty as a sync point
+    std::atomic<uint64_t> sent_ns[BENCH_LATENCY_LINES];
+    std::vector<double> latency;
+
+    // consumer thread (stands in for the UI woken by Frame_Scheduler)
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            wake;
+    bool            quit;
+    std::vector<double> handoff;
+};
+
+static bool open_pty(Pty_Bench &pty){
+    pty.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pty.master < 0 || grantpt(pty.master) < 0 || unlockpt(pty.master) < 0){
+        perror("posix_openpt");
+        return false;
+    }
+    struct termios config;
+    tcgetattr(pty.master, &config);
+    cfmakeraw(&config);
+    tcsetattr(pty.master, TCSANOW, &config);
+    pty.slave = ptsname(pty.master);
+    return true;
+}
+
+static double ns_to_s(uint64_t ns){
+    return 1e-9*ns;
+}
+
+static uint64_t s_to_ns(double s){
+    return (uint64_t)(s*1e9);
+}
+
+static void* consumer_thread(void *args){
+    Pty_Bench *pty = (Pty_Bench*)args;
+
+    pthread_mutex_lock(&pty->lock);
+    while(!pty->quit){
+        if(!pty->wake){
+            pthread_cond_wait(&pty->cond, &pty->lock);
+            continue;
+        }
+        pty->wake = false;
+        pthread_mutex_unlock(&pty->lock);
+
+        Telemetry_Sample sample;
+        pty->b_serial->last_sample(sample);
+        double done = Telemetry::now();
+        pty->handoff.push_back(done - ns_to_s(pty->data_time_ns.load()));
+
+        pthread_mutex_lock(&pty->lock);
+    }
+    pthread_mutex_unlock(&pty->lock);
+    return NULL;
+}
+
+static double plot_update_ns(BrushlessSerial &b_serial, int frames){
+    Sample_View view;
+    double t0 = Telemetry::now();
+    for(int i = 0; i < frames; i++){
+        b_serial.values(view);
+        Telemetry stats = b_serial.telemetry_stats();
+        (void)stats;
+    }
+    return 1e9*(Telemetry::now() - t0)/frames;
+}
+
+static bool write_all(int fd, const char *buf, size_t len){
+    while(len > 0){
+        ssize_t n = write(fd, buf, len);
+        if(n <= 0){
+            perror("write");
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool bench_pty(uint32_t burst_lines){
+    Pty_Bench pty;
+    if(!open_pty(pty)){
+        return false;
+    }
+    pty.lines.store(0);
+    pty.data_time_ns.store(0);
+    pty.timing.store(false);
+    pthread_mutex_init(&pty.lock, NULL);
+    pthread_cond_init(&pty.cond, NULL);
+    pty.wake = false;
+    pty.quit = false;
+
+    Serial_Port serial_port(pty.slave.c_str(), 230400);
+    try {
+        serial_port.start();
+    }
+    catch (int error){
+        return false;
+    }
+
+    BrushlessSerial b_serial(&serial_port);
+    pty.b_serial = &b_serial;
+    b_serial.on_data = [&pty](){
+        double now = Telemetry::now();
+        uint32_t n = pty.lines.load();
+        if(pty.timing.load() && n < BENCH_LATENCY_LINES){
+            pty.latency.push_back(now - ns_to_s(pty.sent_ns[n].load()));
+        }
+        pty.data_time_ns.store(s_to_ns(now));
+        pty.lines.store(n + 1); // only this thread counts
+        pthread_mutex_lock(&pty.lock);
+        pty.wake = true;
+        pthread_cond_signal(&pty.cond);
+        pthread_mutex_unlock(&pty.lock);
+    };
+    try {
+        b_serial.start();
+    }
+    catch (int error){
+        serial_port.handle_quit();
+        return false;
+    }
+
+    report("plot_update_ns", plot_update_ns(b_serial, 20000));
+
+    // --------------------------------------------------------------------------
+    //   LATENCY (paced, 1 kHz)
+    // --------------------------------------------------------------------------
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, consumer_thread, &pty);
+
+    pty.latency.reserve(BENCH_LATENCY_LINES);
+    pty.timing.store(true);
+    char buf[64];
+    double t = Telemetry::now();
+    for(uint32_t i = 0; i < BENCH_LATENCY_LINES; i++){
+        t += 1e-3;
+        sleep_until(t);
+        int len = format_line(buf, sizeof(buf), i);
+        pty.sent_ns[i].store(s_to_ns(Telemetry::now()));
+        if(!write_all(pty.master, buf, len)){
+            break;
+        }
+    }
+    double deadline = Telemetry::now() + 1;
+    while(pty.lines.load() < BENCH_LATENCY_LINES && Telemetry::now() < deadline){
+        usleep(1000);
+    }
+
+    pthread_mutex_lock(&pty.lock);
+    pty.quit = true;
+    pthread_cond_signal(&pty.cond);
+    pthread_mutex_unlock(&pty.lock);
+    pthread_join(consumer, NULL);
+    pty.timing.store(false);
+
+    report("pty_latency_p50_us", 1e6*percentile(pty.latency, 0.50));
+    report("pty_latency_p99_us", 1e6*percentile(pty.latency, 0.99));
+    report("handoff_p50_us", 1e6*percentile(pty.handoff, 0.50));
+    report("handoff_p99_us", 1e6*percentile(pty.handoff, 0.99));
+
+    // --------------------------------------------------------------------------
+    //   THROUGHPUT (burst)
+    // --------------------------------------------------------------------------
+    std::string text;
+    for(uint32_t i = 0; i < burst_lines; i++){
+        int len = format_line(buf, sizeof(buf), BENCH_LATENCY_LINES + i);
+        text.append(buf, len);
+    }
+    uint32_t target = pty.lines.load() + burst_lines;
+
+    double t0 = Telemetry::now();
+    const size_t chunk = 4096;
+    double busy_ns = 0;
+    int busy_frames = 0;
+    for(size_t off = 0; off < text.size(); off += chunk){
+        if(!write_all(pty.master, text.data() + off, std::min(chunk, text.size() - off))){
+            break;
+        }
+        if((off/chunk) % 16 == 0){
+            busy_ns += plot_update_ns(b_serial, 10);
+            busy_frames++;
+        }
+    }
+    while(pty.lines.load() < target && Telemetry::now() - t0 < BENCH_TIMEOUT){
+        usleep(100);
+    }
+    double elapsed = ns_to_s(pty.data_time_ns.load()) - t0;
+    uint32_t received = burst_lines - (target - pty.lines.load());
+    if(received < burst_lines){
+        fprintf(stderr, "pty: %u of %u lines\n", received, burst_lines);
+    }
+
+    report("pty_lines_per_s", received/elapsed);
+    report("pty_mbytes_per_s", 1e-6*text.size()*received/burst_lines/elapsed);
+    report("plot_update_busy_ns", busy_frames ? busy_ns/busy_frames : 0);
+
+    b_serial.handle_quit();
+    serial_port.handle_quit();
+    close(pty.master);
+    pthread_cond_destroy(&pty.cond);
+    pthread_mutex_destroy(&pty.lock);
+    return true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Reconnect: open/close against a pty that keeps sending
+// ------------------------------------------------------------------------------
+struct Pty_Writer
+{
+    int master;
+    double period;
+    std::atomic<bool> quit;
+};
+
+// a line per period, and drains what the panel writes so tcdrain() returns
+static void* pty_writer_thread(void *args){
+    Pty_Writer *writer = (Pty_Writer*)args;
+    char buf[64];
+    uint32_t n = 0;
+    double t = Telemetry::now();
+    while(!writer->quit.load()){
+        int len = format_line(buf, sizeof(buf), n++);
+        ssize_t written = write(writer->master, buf, len); // EAGAIN/EIO while closed
+        (void)written;
+        while(read(writer->master, buf, sizeof(buf)) > 0){
+        }
+        t += writer->period;
+        sleep_until(t);
+    }
+    return NULL;
+}
+
+static void quiet_stderr(int &saved){
+    fflush(stderr);
+    saved = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+}
+
+static void restore_stderr(int saved){
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+}
+
+// ------------------------------------------------------------------------------
+//   Commands: the firmware echo as the ack
+// ------------------------------------------------------------------------------
+struct Echo_Firmware
+{
+    int master;
+    std::atomic<bool> quit;
+};
+
+// answers every line like the RX interrupt: "\n*** line ***\n\n"
+static void* echo_firmware_thread(void *args){
+    Echo_Firmware *fw = (Echo_Firmware*)args;
+    std::string in;
+    char buf[256];
+    while(!fw->quit.load()){
+        struct pollfd pfd = {fw->master, POLLIN, 0};
+        if(poll(&pfd, 1, 10) <= 0){
+            continue;
+        }
+        ssize_t n = read(fw->master, buf, sizeof(buf));
+        if(n <= 0){
+            continue;
+        }
+        in.append(buf, n);
+        size_t end;
+        while((end = in.find('\n')) != std::string::npos){
+            std::string echo = "\n*** " + in.substr(0, end) + " ***\n\n";
+            in.erase(0, end + 1);
+            write_all(fw->master, echo.c_str(), echo.size());
+        }
+    }
+    return NULL;
+}
+
+static bool bench_commands(){
+    Pty_Bench pty;
+    if(!open_pty(pty)){
+        return false;
+    }
+    Echo_Firmware fw;
+    fw.master = pty.master;
+    fw.quit.store(false);
+    pthread_t fw_tid;
+    pthread_create(&fw_tid, NULL, echo_firmware_thread, &fw);
+
+    int saved_stderr;
+    quiet_stderr(saved_stderr);
+
+    bool ok = true;
+    Command_Stats one_by_one, burst;
+    uint32_t burst_writes = 0;
+    {
+        Serial_Port serial_port(pty.slave.c_str(), 230400);
+        BrushlessSerial b_serial(&serial_port);
+        serial_port.start();
+        b_serial.start();
+
+        // one at a time: the ack latency alone
+        double t0;
+        for(int i = 0; i < COMMAND_HISTORY; i++){
+            b_serial.command(std::to_string(3000 + i));
+            t0 = Telemetry::now();
+            while(b_serial.commands.stats().acked <= (uint32_t)i && Telemetry::now() - t0 < 1){
+                usleep(20);
+            }
+        }
+        one_by_one = b_serial.commands.stats();
+
+        // a slider drag: every set-point replaces the waiting one
+        const int pushes = 1000;
+        for(int i = 0; i < pushes; i++){
+            b_serial.command(std::to_string(2000 + i));
+        }
+        t0 = Telemetry::now();
+        burst = b_serial.commands.stats();
+        while(burst.acked + burst.coalesced + burst.timeouts < burst.queued && Telemetry::now() - t0 < 2){
+            usleep(100);
+            burst = b_serial.commands.stats();
+        }
+        burst_writes = burst.sent - one_by_one.sent;
+    }
+
+    restore_stderr(saved_stderr);
+    fw.quit.store(true);
+    pthread_join(fw_tid, NULL);
+    close(pty.master);
+
+    if(one_by_one.acked != COMMAND_HISTORY || burst.timeouts){
+        fprintf(stderr, "commands: %u of %d acked, %u timeouts\n", one_by_one.acked, COMMAND_HISTORY, burst.timeouts);
+        ok = false;
+    }
+    report("command_ack_p50_us", 1e6*one_by_one.p50);
+    report("command_ack_p99_us", 1e6*one_by_one.p99);
+    report("command_burst_writes", burst_writes);
+    return ok;
+}
+
+
+static bool bench_reconnect(int cycles){
+    Pty_Bench pty;
+    if(!open_pty(pty)){
+        return false;
+    }
+    fcntl(pty.master, F_SETFL, fcntl(pty.master, F_GETFL) | O_NONBLOCK);
+
+    Pty_Writer writer;
+    writer.master = pty.master;
+    writer.period = 1e-4;
+    writer.quit.store(false);
+    pthread_t writer_tid;
+    pthread_create(&writer_tid, NULL, pty_writer_thread, &writer);
+
+    // OPEN PORT / CLOSE PORT on every cycle
+    int saved_stderr;
+    quiet_stderr(saved_stderr);
+
+    std::vector<double> open_time, line_time, close_time;
+    int failures = 0;
+    {
+        Serial_Port serial_port(pty.slave.c_str(), 230400);
+        BrushlessSerial b_serial(&serial_port);
+        Sample_View view;
+        std::vector<std::string> messages;
+
+        for(int i = 0; i < cycles; i++){
+            double t0 = Telemetry::now();
+            try {
+                serial_port.start();
+                b_serial.start();
+            }
+            catch (int error){
+                failures++;
+                serial_port.handle_quit();
+                continue;
+            }
+            double t1 = Telemetry::now();
+            open_time.push_back(t1 - t0);
+
+            // what the UI does between two toggles
+            Telemetry_Sample sample;
+            while(!b_serial.last_sample(sample) && Telemetry::now() - t1 < 0.1){
+                usleep(50);
+            }
+            if(b_serial.last_sample(sample)){
+                line_time.push_back(Telemetry::now() - t1);
+            }
+            b_serial.values(view);
+            b_serial.telemetry_stats();
+            b_serial.take_messages(messages);
+            b_serial.write_message(3000);
+
+            double t2 = Telemetry::now();
+            b_serial.handle_quit();
+            serial_port.handle_quit();
+            close_time.push_back(Telemetry::now() - t2);
+        }
+
+        // left open: the destructors stop the threads and close the port
+        try {
+            serial_port.start();
+            b_serial.start();
+        }
+        catch (int error){
+            failures++;
+        }
+    }
+
+    restore_stderr(saved_stderr);
+
+    writer.quit.store(true);
+    pthread_join(writer_tid, NULL);
+    close(pty.master);
+
+    if(failures || line_time.size() < open_time.size()){
+        fprintf(stderr, "reconnect: %d failed opens, %zu of %zu cycles without a sample\n",
+                failures, open_time.size() - line_time.size(), open_time.size());
+    }
+    report("reconnect_open_p50_us", 1e6*percentile(open_time, 0.50));
+    report("reconnect_open_p99_us", 1e6*percentile(open_time, 0.99));
+    report("reconnect_line_p50_us", 1e6*percentile(line_time, 0.50));
+    report("reconnect_close_p50_us", 1e6*percentile(close_time, 0.50));
+    report("reconnect_close_p99_us", 1e6*percentile(close_time, 0.99));
+    return failures == 0;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Hot-plug: the "adapter" is a pty behind a symlink that comes and goes
+// ------------------------------------------------------------------------------
+static bool bench_hotplug(int cycles){
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench-tty-%d", (int)getpid());
+    unlink(path);
+
+    int saved_stderr;
+    quiet_stderr(saved_stderr);
+
+    std::vector<double> reconnect;
+    int missed_hangups = 0;
+    {
+        // started with nothing there: the read thread waits for the device
+        Serial_Port serial_port(path, 230400);
+        BrushlessSerial b_serial(&serial_port);
+        b_serial.start();
+
+        for(int i = 0; i < cycles; i++){
+            Pty_Bench pty;
+            if(!open_pty(pty)){
+                break;
+            }
+            fcntl(pty.master, F_SETFL, fcntl(pty.master, F_GETFL) | O_NONBLOCK);
+            Pty_Writer writer;
+            writer.master = pty.master;
+            writer.period = TELEMETRY_TICK_PERIOD; // like the firmware
+            writer.quit.store(false);
+            pthread_t writer_tid;
+            pthread_create(&writer_tid, NULL, pty_writer_thread, &writer);
+
+            // plug in, and wait for the read thread to count the reconnect
+            double plugged = Telemetry::now();
+            if(symlink(pty.slave.c_str(), path) < 0){
+                perror(path);
+            }
+            while(b_serial.link_status().reconnects <= (uint32_t)i && Telemetry::now() - plugged < 2){
+                usleep(100);
+            }
+            if(b_serial.link_status().reconnects > (uint32_t)i){
+                reconnect.push_back(Telemetry::now() - plugged);
+            }
+
+            // unplug: the node goes away and the slave hangs up, which
+            // the read thread must see whatever the read strategy
+            unlink(path);
+            writer.quit.store(true);
+            pthread_join(writer_tid, NULL);
+            close(pty.master);
+            double unplugged = Telemetry::now();
+            while(b_serial.link_status().connected && Telemetry::now() - unplugged < 2){
+                usleep(100);
+            }
+            if(b_serial.link_status().connected){
+                missed_hangups++;
+                break;
+            }
+            usleep(20000);
+        }
+    }
+
+    restore_stderr(saved_stderr);
+    unlink(path);
+
+    if(missed_hangups){
+        fprintf(stderr, "hotplug: hangup not seen in 2 s\n");
+    }
+    if(reconnect.size() < (size_t)cycles){
+        fprintf(stderr, "hotplug: %zu of %d reconnects\n", reconnect.size(), cycles);
+    }
+    report("hotplug_p50_ms", 1e3*percentile(reconnect, 0.50));
+    report("hotplug_max_ms", 1e3*percentile(reconnect, 1.0));
+    return missed_hangups == 0 && reconnect.size() == (size_t)cycles;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Serial_Port policies: every read strategy, buffer and flow control
+// ------------------------------------------------------------------------------
+struct Port_Bench
+{
+    Pty_Bench pty;           // master/slave and the send times
+    std::atomic<bool> quit;
+    std::vector<double> latency;
+    double cpu;              // s, reader thread
+};
+
+// BrushlessSerial's read loop, on the port alone
+template <class Port>
+struct Port_Reader
+{
+    Port       *port;
+    Port_Bench *bench;
+
+    static void* run(void *args){
+        Port_Reader *reader = (Port_Reader*)args;
+        Port_Bench  *bench  = reader->bench;
+        std::string line;
+        uint32_t n = 0;
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+        while(!bench->quit.load()){
+            if(reader->port->read_message(line) == 1){
+                if(n < BENCH_PORT_LINES){
+                    bench->latency.push_back(Telemetry::now() - ns_to_s(bench->pty.sent_ns[n].load()));
+                }
+                n++;
+            }
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+        bench->cpu = (t1.tv_sec - t0.tv_sec) + 1e-9*(t1.tv_nsec - t0.tv_nsec);
+        return NULL;
+    }
+};
+
+template <class Read, class Buffer, class Flow>
+static bool bench_port(const char *name){
+    typedef Basic_Serial_Port<SERIAL_PORT_FRAMING, Flow, Read, Buffer> Port;
+    Port_Bench *bench = new Port_Bench(); // sent_ns is large
+    if(!open_pty(bench->pty)){
+        delete bench;
+        return false;
+    }
+    bench->quit.store(false);
+    bench->latency.reserve(BENCH_PORT_LINES);
+
+    int saved_stderr;
+    quiet_stderr(saved_stderr);
+    Port port(bench->pty.slave.c_str(), 230400);
+    bool ok = port.try_open();
+    restore_stderr(saved_stderr);
+    if(!ok){
+        fprintf(stderr, "port %s: could not open %s\n", name, bench->pty.slave.c_str());
+        close(bench->pty.master);
+        delete bench;
+        return false;
+    }
+
+    Port_Reader<Port> reader = {&port, bench};
+    pthread_t tid;
+    pthread_create(&tid, NULL, Port_Reader<Port>::run, &reader);
+
+    // paced like the latency run of bench_pty, the wall time is the window
+    char buf[64];
+    double start = Telemetry::now();
+    double t = start;
+    for(uint32_t i = 0; i < BENCH_PORT_LINES; i++){
+        t += 1e-3;
+        sleep_until(t);
+        int len = format_line(buf, sizeof(buf), i);
+        bench->pty.sent_ns[i].store(s_to_ns(Telemetry::now()));
+        if(!write_all(bench->pty.master, buf, len)){
+            break;
+        }
+    }
+    sleep_until(t + 0.01);
+    double wall = Telemetry::now() - start;
+    bench->quit.store(true);
+    port.interrupt();
+    pthread_join(tid, NULL);
+
+    quiet_stderr(saved_stderr);
+    port.close_serial();
+    restore_stderr(saved_stderr);
+    close(bench->pty.master);
+
+    char key[96];
+    snprintf(key, sizeof(key), "port_%s_p50_us", name);
+    report(key, 1e6*percentile(bench->latency, 0.50));
+    snprintf(key, sizeof(key), "port_%s_p99_us", name);
+    report(key, 1e6*percentile(bench->latency, 0.99));
+    snprintf(key, sizeof(key), "port_%s_cpu_pct", name);
+    report(key, 100*bench->cpu/wall);
+
+    ok = bench->latency.size() == BENCH_PORT_LINES;
+    if(!ok){
+        fprintf(stderr, "port %s: %zu of %d lines\n", name, bench->latency.size(), BENCH_PORT_LINES);
+    }
+    delete bench;
+    return ok;
+}
+
+template <class Read, class Buffer>
+static bool bench_port_flow(const char *name){
+    std::string base = name;
+    bool ok = bench_port<Read, Buffer, No_Flow_Control>((base + "_none").c_str());
+    return bench_port<Read, Buffer, Rts_Cts_Flow>((base + "_rtscts").c_str()) && ok;
+}
+
+static bool bench_ports(){
+    bool ok = bench_port_flow<Blocking_Read, Byte_Buffer>("blocking_byte");
+    ok = bench_port_flow<Blocking_Read, Chunk_Buffer>("blocking_chunk") && ok;
+    ok = bench_port_flow<Poll_Read, Byte_Buffer>("poll_byte") && ok;
+    ok = bench_port_flow<Poll_Read, Chunk_Buffer>("poll_chunk") && ok;
+    ok = bench_port_flow<Busy_Poll_Read, Byte_Buffer>("busy_byte") && ok;
+    ok = bench_port_flow<Busy_Poll_Read, Chunk_Buffer>("busy_chunk") && ok;
+    return ok;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Scaling: N motors at 100 Hz, on the I/O pool or a read thread each
+// ------------------------------------------------------------------------------
+struct Sim_Line
+{
+    int rpm;
+    int setpoint;
+    int pulse;
+};
+
+// a step response of the simulator ("-v"), replayed by every motor
+static std::vector<Sim_Line> sim_lines;
+
+static void load_sim_lines(const char *path){
+    std::string cmd = std::string(path) + " -v -n 20";
+    FILE *out = popen(cmd.c_str(), "r");
+    if(!out){
+        perror(path);
+        return;
+    }
+    char line[256];
+    while(fgets(line, sizeof(line), out)){
+        unsigned seq, tick;
+        Sim_Line l;
+        if(sscanf(line, "%u\t%u\t%d\t%d\t%d", &seq, &tick, &l.rpm, &l.setpoint, &l.pulse) == 5){
+            sim_lines.push_back(l);
+        }
+    }
+    pclose(out);
+}
+
+struct Scale_Writer
+{
+    std::vector<int> masters;
+    std::atomic<bool> quit;
+};
+
+// a line per motor every tick; each motor at its own point of the response
+static void* scale_writer_thread(void *args){
+    Scale_Writer *writer = (Scale_Writer*)args;
+    char buf[64];
+    uint32_t n = 0;
+    double t = Telemetry::now();
+    while(!writer->quit.load()){
+        for(size_t m = 0; m < writer->masters.size(); m++){
+            int len;
+            if(sim_lines.empty()){
+                len = format_line(buf, sizeof(buf), n + 37*m);
+            }else{
+                const Sim_Line &l = sim_lines[(n + 97*m) % sim_lines.size()];
+                len = snprintf(buf, sizeof(buf), "%u\t%u\t%d\t%d\t%d\n", n & 0xffff, n, l.rpm, l.setpoint, l.pulse);
+            }
+            ssize_t written = write(writer->masters[m], buf, len);
+            (void)written;
+            while(read(writer->masters[m], buf, sizeof(buf)) > 0){
+            }
+        }
+        n++;
+        t += TELEMETRY_TICK_PERIOD;
+        sleep_until(t);
+    }
+    return NULL;
+}
+
+static double cpu_time(clockid_t clock){
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+struct Scale_Motor
+{
+    Pty_Bench       pty;
+    Serial_Port    *port;
+    BrushlessSerial *serial;
+    Live_Stats      stats;
+    Live_Snapshot   live;
+    std::vector<float> column_min, column_max;
+};
+
+// process CPU, less the writer thread, over BENCH_SCALE_TIME; with pooled
+// also the cost of one dashboard frame over all the motors
+static bool bench_scale_run(int motors, bool pooled){
+    std::vector<Scale_Motor*> rig;
+    Scale_Writer writer;
+    writer.quit.store(false);
+    for(int m = 0; m < motors; m++){
+        Scale_Motor *motor = new Scale_Motor();
+        if(!open_pty(motor->pty)){
+            delete motor;
+            break;
+        }
+        fcntl(motor->pty.master, F_SETFL, fcntl(motor->pty.master, F_GETFL) | O_NONBLOCK);
+        writer.masters.push_back(motor->pty.master);
+        motor->column_min.assign(BENCH_DASHBOARD_COLUMNS, 0);
+        motor->column_max.assign(BENCH_DASHBOARD_COLUMNS, 0);
+        rig.push_back(motor);
+    }
+    if((int)rig.size() < motors){
+        for(size_t m = 0; m < rig.size(); m++){
+            close(rig[m]->pty.master);
+            delete rig[m];
+        }
+        return false;
+    }
+
+    pthread_t writer_tid;
+    pthread_create(&writer_tid, NULL, scale_writer_thread, &writer);
+    clockid_t writer_clock;
+    pthread_getcpuclockid(writer_tid, &writer_clock);
+
+    int saved_stderr;
+    quiet_stderr(saved_stderr);
+
+    bool ok = true;
+    uint32_t received = 0;
+    double cpu_pct = 0, frame_us = 0;
+    {
+        Io_Pool pool;
+        for(int m = 0; m < motors; m++){
+            Scale_Motor *motor = rig[m];
+            motor->port   = new Serial_Port(motor->pty.slave.c_str(), 230400);
+            motor->serial = new BrushlessSerial(motor->port, BENCH_DASHBOARD_HISTORY);
+            motor->serial->set_live_stats(&motor->stats);
+            try {
+                motor->port->start();
+                motor->serial->start(pooled ? &pool : NULL);
+            }
+            catch (int error){
+                ok = false;
+            }
+        }
+
+        usleep(300000); // every port flowing
+
+        uint32_t received0 = 0;
+        for(int m = 0; m < motors; m++){
+            received0 += rig[m]->serial->telemetry_stats().received;
+        }
+        double wall0   = Telemetry::now();
+        double cpu0    = cpu_time(CLOCK_PROCESS_CPUTIME_ID);
+        double writer0 = cpu_time(writer_clock);
+        usleep((useconds_t)(1e6*BENCH_SCALE_TIME));
+        double wall    = Telemetry::now() - wall0;
+        double cpu     = cpu_time(CLOCK_PROCESS_CPUTIME_ID) - cpu0;
+        double writer_cpu = cpu_time(writer_clock) - writer0;
+        for(int m = 0; m < motors; m++){
+            received += rig[m]->serial->telemetry_stats().received;
+        }
+        received -= received0;
+        cpu_pct = 100*(cpu - writer_cpu)/wall;
+
+        // what Motor_Dashboard does per frame, with every row visible and a
+        // new slot on each (the plot columns decimated in place every frame)
+        if(pooled){
+            const int frames = 200;
+            std::vector<std::string> messages;
+            double t0 = Telemetry::now();
+            for(int f = 0; f < frames; f++){
+                for(int m = 0; m < motors; m++){
+                    Scale_Motor *motor = rig[m];
+                    Telemetry_Sample sample;
+                    motor->serial->take_messages(messages);
+                    motor->stats.snapshot(motor->live);
+                    motor->serial->last_sample(sample);
+                    Sample_View view;
+                    motor->serial->values(view);
+                    double first = (double)view.count - BENCH_DASHBOARD_PLOT;
+                    int c0 = (first < 0) ? (int)ceil(-first/BENCH_DASHBOARD_PLOT*BENCH_DASHBOARD_COLUMNS) : 0;
+                    if(c0 < BENCH_DASHBOARD_COLUMNS){
+                        decimate_min_max(view.value[SAMPLE_RPM], (int)view.capacity, (int)view.offset, (int)view.count,
+                                         first + (double)BENCH_DASHBOARD_PLOT*c0/BENCH_DASHBOARD_COLUMNS,
+                                         (double)BENCH_DASHBOARD_PLOT*(BENCH_DASHBOARD_COLUMNS - c0)/BENCH_DASHBOARD_COLUMNS,
+                                         BENCH_DASHBOARD_COLUMNS - c0, &motor->column_min[c0], &motor->column_max[c0]);
+                    }
+                    motor->serial->telemetry_stats();
+                    motor->serial->link_status();
+                }
+            }
+            frame_us = 1e6*(Telemetry::now() - t0)/frames;
+        }
+
+        // the motors leave the pool before it stops
+        for(int m = 0; m < motors; m++){
+            delete rig[m]->serial;
+            delete rig[m]->port;
+        }
+    }
+
+    restore_stderr(saved_stderr);
+
+    writer.quit.store(true);
+    pthread_join(writer_tid, NULL);
+    for(size_t m = 0; m < rig.size(); m++){
+        close(rig[m]->pty.master);
+        delete rig[m];
+    }
+
+    double expected = motors*BENCH_SCALE_TIME/TELEMETRY_TICK_PERIOD;
+    if(received < 0.9*expected){
+        fprintf(stderr, "scale: %d motors (%s) received %u of %.0f lines\n", motors,
+                pooled ? "pool" : "threads", received, expected);
+        ok = false;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "scale_%s_cpu_pct_%d", pooled ? "pool" : "threads", motors);
+    report(name, cpu_pct);
+    if(pooled){
+        snprintf(name, sizeof(name), "scale_frame_us_%d", motors);
+        report(name, frame_us);
+    }
+    return ok;
+}
+
+static bool bench_scaling(int max_motors){
+    bool ok = true;
+    for(int motors = 1; motors <= max_motors; motors *= 2){
+        ok = bench_scale_run(motors, true) && ok;
+        ok = bench_scale_run(motors, false) && ok;
+    }
+    return ok;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Archive
+// ------------------------------------------------------------------------------
+// a 100 Hz capture of BENCH_ARCHIVE_SAMPLES: the simulator step response
+// (or the synthetic lines) over and over, host times with jitter
+static bool bench_archive(){
+    std::vector<Telemetry_Sample> samples(BENCH_ARCHIVE_SAMPLES);
+    size_t text_bytes = 0;
+    char buf[128];
+    uint32_t noise = 1;
+    for(size_t i = 0; i < samples.size(); i++){
+        Telemetry_Sample &s = samples[i];
+        s.seq = i;
+        s.tick = i & 0xffff;
+        s.time = i*TELEMETRY_TICK_PERIOD;
+        noise = noise*1103515245 + 12345;
+        s.host_time = 1000 + s.time + 1e-6*((noise >> 16) % 1000);
+        if(!sim_lines.empty()){
+            const Sim_Line &l = sim_lines[i % sim_lines.size()];
+            s.rpm = l.rpm; s.setpoint = l.setpoint; s.pulse = l.pulse;
+        }else{
+            s.rpm = 3000 + (int)(i*37 % 200) - 100; s.setpoint = 3000; s.pulse = 1300 + (int)(i % 50);
+        }
+        text_bytes += snprintf(buf, sizeof(buf), "%u\t%u\t%d\t%d\t%d\t%.2f\t%.6f\n",
+                               s.seq, s.tick, s.rpm, s.setpoint, s.pulse, s.time, s.host_time);
+    }
+
+    char path[] = "/tmp/bench_archive_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        perror("mkstemp");
+        return false;
+    }
+    close(fd);
+
+    double encode = 1e9, decode = 1e9, seek = 1e9;
+    uint64_t bytes = 0;
+    bool ok = true;
+    for(int run = 0; run < BENCH_REPEAT && ok; run++){
+        double t0 = Telemetry::now();
+        Archive_Writer writer;
+        ok = writer.open(path) && writer.write_all(samples, std::vector<Archive_Message>(), 0);
+        ok = writer.close() && ok;
+        encode = std::min(encode, Telemetry::now() - t0);
+        bytes = writer.bytes;
+
+        std::vector<Telemetry_Sample> back;
+        Archive_Reader reader;
+        t0 = Telemetry::now();
+        ok = ok && reader.open(path) && reader.read_all(back, 0);
+        decode = std::min(decode, Telemetry::now() - t0);
+        if(ok && (back.size() != samples.size() || back.back().rpm != samples.back().rpm ||
+                  llround(1e6*back.back().host_time) != llround(1e6*samples.back().host_time))){
+            fprintf(stderr, "archive: decoded samples differ\n");
+            ok = false;
+        }
+
+        // open, find a time and decode its block
+        t0 = Telemetry::now();
+        Archive_Reader seeker;
+        ok = ok && seeker.open(path) && seeker.read_block(seeker.find(0.7*samples.back().time), back);
+        seek = std::min(seek, Telemetry::now() - t0);
+    }
+    unlink(path);
+
+    report("archive_encode_per_s", samples.size()/encode);
+    report("archive_decode_per_s", samples.size()/decode);
+    report("archive_seek_us", 1e6*seek);
+    report("archive_ratio_x", bytes ? (double)text_bytes/bytes : 0);
+    return ok;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Simulator
+// ------------------------------------------------------------------------------
+// reports the lines of "path args" whose name starts with prefix
+static bool run_simulator(const char *path, const char *args, const char *prefix){
+    std::string cmd = std::string(path) + " " + args;
+    FILE *out = popen(cmd.c_str(), "r");
+    if(!out){
+        perror(path);
+        return false;
+    }
+    char line[256];
+    bool found = false;
+    while(fgets(line, sizeof(line), out)){
+        char name[64];
+        double value;
+        if(sscanf(line, "%63s %lf", name, &value) == 2 && strncmp(name, prefix, strlen(prefix)) == 0){
+            report(name, value);
+            found = true;
+        }
+    }
+    return pclose(out) == 0 && found;
+}
+
+// System_Id on the simulator's PI-D + Smith step response, telemetry
+// unfiltered ("f0"): the nominal plant must come back, stable and within
+// the drift that would ask for retuning
+static bool bench_ident(const char *path){
+    std::string cmd = std::string(path) + " -m 1 -c f0 -v";
+    FILE *out = popen(cmd.c_str(), "r");
+    if(!out){
+        perror(path);
+        return false;
+    }
+    System_Id identifier;
+    char line[256];
+    while(fgets(line, sizeof(line), out)){
+        unsigned seq, tick;
+        Telemetry_Sample sample = Telemetry_Sample();
+        if(sscanf(line, "%u\t%u\t%d\t%d\t%d", &seq, &tick, &sample.rpm, &sample.setpoint, &sample.pulse) == 5){
+            sample.seq  = seq;
+            sample.tick = tick;
+            sample.time = tick*TELEMETRY_TICK_PERIOD;
+            identifier.update(sample);
+        }
+    }
+    pclose(out);
+
+    Identification id = identifier.estimate();
+    const double nominal = IDENT_NOMINAL_POLE1 + IDENT_NOMINAL_POLE2;
+    double pole_error = fabs((id.s_re[0] + id.s_re[1] - nominal)/nominal);
+    report("ident_gain_error_pct", 100*fabs(id.drift));
+    report("ident_pole_error_pct", 100*pole_error);
+
+    bool stable = id.s_re[0] < 0 && id.s_re[1] < 0;
+    if(!id.valid || !stable || fabs(id.drift) > IDENT_DRIFT || pole_error > 0.5){
+        fprintf(stderr, "ident: valid %d, gain %.2f rpm/us, poles %.2f%+.2fi %.2f%+.2fi 1/s\n", id.valid, id.gain,
+                id.s_re[0], id.s_im[0], id.s_re[1], id.s_im[1]);
+        return false;
+    }
+    return true;
+}
+
+// the step rate, the firmware RX path fed back-to-back commands at
+// 460800 bps (fails on any lost byte) and the firmware number formatting
+// at the 16 and 32 bit limits
+static bool bench_simulator(const char *path){
+    bool ok = run_simulator(path, "-m 1", "sim_");
+    ok = run_simulator(path, "-u 460800", "uart_lost_bytes") && ok;
+    ok = bench_ident(path) && ok;
+    return run_simulator(path, "-i", "itoa_bad") && ok;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Baseline
+// ------------------------------------------------------------------------------
+static bool higher_is_better(const std::string &name){
+    size_t len = name.size();
+    return (len > 6 && name.compare(len - 6, 6, "_per_s") == 0) ||
+           (len > 2 && name.compare(len - 2, 2, "_x") == 0);
+}
+
+// returns the number of results worse than the baseline by more than tolerance %
+static int compare(const char *path, double tolerance){
+    FILE *file = fopen(path, "r");
+    if(!file){
+        perror(path);
+        return -1;
+    }
+    std::map<std::string, double> baseline;
+    char line[256];
+    while(fgets(line, sizeof(line), file)){
+        char name[64];
+        double value;
+        if(sscanf(line, "%63s %lf", name, &value) == 2){
+            baseline[name] = value;
+        }
+    }
+    fclose(file);
+
+    int regressions = 0;
+    for(size_t i = 0; i < results.size(); i++){
+        std::map<std::string, double>::iterator it = baseline.find(results[i].first);
+        if(it == baseline.end() || it->second <= 0){
+            continue;
+        }
+        double change = 100*(results[i].second - it->second)/it->second;
+        double worse  = higher_is_better(it->first) ? -change : change;
+        if(worse > tolerance){
+            printf("regression\t%s\t%.3f\t%.3f\t%+.1f\n", it->first.c_str(), it->second, results[i].second, change);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+
+int main(int argc, char *argv[]){
+    uint32_t burst_lines = 50000;
+    int cycles = 1000;
+    int hotplug_cycles = 20;
+    int max_motors = 16;
+    const char *simulator = NULL;
+    const char *baseline = NULL;
+    double tolerance = 20;
+    bool lifecycle_only = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "n:c:H:m:S:b:r:R:"))){
+        switch(opt){
+            case 'n': burst_lines = atoi(optarg); break;
+            case 'c': cycles = atoi(optarg); break;
+            case 'H': hotplug_cycles = atoi(optarg); break;
+            case 'm': max_motors = atoi(optarg); break;
+            case 'S': simulator = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 'r': tolerance = atof(optarg); break;
+            case 'R':
+                lifecycle_only = true;
+                result_prefix = std::string(optarg) + "_";
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n lines] [-c cycles] [-H cycles] [-m motors] [-S simulator] [-b baseline.tsv] [-r pct] [-R name]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(lifecycle_only){
+        bool ok = bench_reconnect(cycles);
+        return (bench_hotplug(hotplug_cycles) && ok) ? 0 : EXIT_FAILURE;
+    }
+
+    bench_parse();
+    bench_consumers();
+    bench_control("control_pid_ns", CONTROL_PID);
+    bench_control("control_smith_ns", CONTROL_SMITH);
+    bench_store();
+    bench_plot_decimate();
+
+    bool ok = bench_server();
+    ok = bench_pty(burst_lines) && ok;
+    ok = bench_commands() && ok;
+    ok = bench_reconnect(cycles) && ok;
+    ok = bench_hotplug(hotplug_cycles) && ok;
+    ok = bench_ports() && ok;
+    if(simulator){
+        load_sim_lines(simulator);
+    }
+    ok = bench_scaling(max_motors) && ok;
+    ok = bench_archive() && ok;
+    if(simulator){
+        ok = bench_simulator(simulator) && ok;
+    }
+
+    if(baseline){
+        int regressions = compare(baseline, tolerance);
+        if(regressions != 0){
+            return 2;
+        }
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
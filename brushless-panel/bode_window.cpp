@@ -0,0 +1,259 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "bode_window.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+static void* start_bode_window_thread(void *args);
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Bode_Window::
+Bode_Window()
+{
+    strcpy(path, "capture.tsv");
+    input   = 0;
+    started = false;
+    busy    = false;
+    pthread_mutex_init(&lock, NULL);
+}
+
+Bode_Window::
+~Bode_Window()
+{
+    if (started)
+    {
+        pthread_join(tid, NULL);
+    }
+    pthread_mutex_destroy(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Analysis Thread
+// ------------------------------------------------------------------------------
+void
+Bode_Window::
+start()
+{
+    pthread_mutex_lock(&lock);
+    bool running = busy;
+    pthread_mutex_unlock(&lock);
+    if (running)
+    {
+        return;
+    }
+    if (started)
+    {
+        pthread_join(tid, NULL); // finished, reap it
+        started = false;
+    }
+
+    job_path  = path;
+    job_input = input;
+    busy      = true;
+    status    = "analyzing...";
+
+    if (pthread_create(&tid, NULL, &start_bode_window_thread, this))
+    {
+        busy   = false;
+        status = "could not start the analysis";
+        return;
+    }
+    started = true;
+}
+
+void
+Bode_Window::
+analyze()
+{
+    std::vector<Bode_Point> result;
+    char text[256];
+
+    Capture capture;
+    if (!load_capture(job_path.c_str(), capture))
+    {
+        snprintf(text, sizeof(text), "%s: could not read the capture", job_path.c_str());
+    }
+    else
+    {
+        const std::vector<float> &u = (job_input == 0) ? capture.pulse : capture.setpoint;
+        result = frequency_response(u, capture.rpm, capture.rate, 0);
+        if (result.empty())
+        {
+            snprintf(text, sizeof(text), "%u samples: too short or not excited (%d at least)",
+                     (unsigned)capture.rpm.size(), BODE_MIN_SEGMENT);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "%u samples (%.1f s), %u bins with coherence >= %.1f",
+                     (unsigned)capture.rpm.size(), capture.rpm.size()/capture.rate,
+                     (unsigned)result.size(), BODE_COHERENCE);
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    points.swap(result);
+    status = text;
+    busy   = false;
+    pthread_mutex_unlock(&lock);
+
+    if (on_done)
+    {
+        on_done();
+    }
+}
+
+static void* start_bode_window_thread(void *args)
+{
+    Bode_Window *window = (Bode_Window *)args;
+    window->analyze();
+    return NULL;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Draw
+// ------------------------------------------------------------------------------
+void
+Bode_Window::
+draw(const char* title)
+{
+    ImGui::SetNextWindowSize(ImVec2(560, 520), ImGuiSetCond_FirstUseEver);
+    ImGui::Begin(title);
+
+    ImGui::Text("capture:");
+    ImGui::InputText("##capture", path, sizeof(path));
+    ImGui::SameLine();
+    if (ImGui::Button("analyze"))
+    {
+        start();
+    }
+    ImGui::RadioButton("pulse (o1)", &input, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("set-point", &input, 1);
+
+    pthread_mutex_lock(&lock);
+    std::vector<Bode_Point> measured = points;
+    std::string text = status;
+    pthread_mutex_unlock(&lock);
+
+    ImGui::Text("%s", text.c_str());
+
+    float width  = ImGui::GetWindowWidth() - 30;
+    float height = std::max(80.0f, 0.5f*(ImGui::GetWindowHeight() - 130));
+    plot("magnitude", measured, false, ImVec2(width, height));
+    plot("phase", measured, true, ImVec2(width, height));
+
+    ImGui::End();
+}
+
+// log frequency axis, model as a line and the measured bins as dots
+void
+Bode_Window::
+plot(const char* id, const std::vector<Bode_Point> &measured, bool phase, const ImVec2 &size)
+{
+    const int    MODEL_POINTS = 200;
+    const double lmin = log10(BODE_PLOT_FMIN);
+    const double lmax = log10(BODE_PLOT_FMAX);
+
+    std::vector<float> model(MODEL_POINTS);
+    double vmin = 1e9, vmax = -1e9;
+    for (int i = 0; i < MODEL_POINTS; i++)
+    {
+        double magnitude_db, phase_deg;
+        plant_response(pow(10, lmin + (lmax - lmin)*i/(MODEL_POINTS - 1)), magnitude_db, phase_deg);
+        model[i] = (float)(phase ? phase_deg : magnitude_db);
+        vmin = std::min(vmin, (double)model[i]);
+        vmax = std::max(vmax, (double)model[i]);
+    }
+    for (size_t i = 0; i < measured.size(); i++)
+    {
+        double v = phase ? measured[i].phase_deg : measured[i].magnitude_db;
+        vmin = std::min(vmin, v);
+        vmax = std::max(vmax, v);
+    }
+
+    // grid: 10 dB or 180 degrees (the dead time reaches -1200 at 50 Hz)
+    const double grid = phase ? 180 : 10;
+    vmin = grid*floor(vmin/grid);
+    vmax = grid*ceil(vmax/grid);
+    if (vmax <= vmin)
+    {
+        vmax = vmin + grid;
+    }
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImVec2 p0 = ImGui::GetCursorScreenPos();
+    const float left = 40; // room for the labels
+    ImVec2 a(p0.x + left, p0.y);
+    ImVec2 b(p0.x + size.x, p0.y + size.y - 14);
+    ImGui::InvisibleButton(id, size);
+
+    auto plot_x = [&](double f){ return a.x + (float)((log10(f) - lmin)/(lmax - lmin))*(b.x - a.x); };
+    auto plot_y = [&](double v){ return b.y - (float)((v - vmin)/(vmax - vmin))*(b.y - a.y); };
+
+    const ImU32 frame = ImColor(120, 120, 120);
+    const ImU32 major = ImColor(100, 100, 100);
+    const ImU32 minor = ImColor(70, 70, 70);
+    const ImU32 label = ImColor(200, 200, 200);
+
+    draw_list->AddRectFilled(a, b, ImColor(30, 30, 30));
+
+    for (int decade = (int)floor(lmin); decade <= (int)ceil(lmax); decade++)
+    {
+        for (int m = 1; m < 10; m++)
+        {
+            double f = m*pow(10, decade);
+            if (log10(f) < lmin - 1e-9 || log10(f) > lmax + 1e-9)
+            {
+                continue;
+            }
+            float x = plot_x(f);
+            draw_list->AddLine(ImVec2(x, a.y), ImVec2(x, b.y), (m == 1) ? major : minor);
+            if (m == 1 || m == 5)
+            {
+                char text[16];
+                snprintf(text, sizeof(text), "%g", f);
+                draw_list->AddText(ImVec2(x - 6, b.y + 1), label, text);
+            }
+        }
+    }
+    for (double v = vmin; v <= vmax + 1e-9; v += grid)
+    {
+        float y = plot_y(v);
+        draw_list->AddLine(ImVec2(a.x, y), ImVec2(b.x, y), minor);
+        char text[16];
+        snprintf(text, sizeof(text), "%.0f", v);
+        draw_list->AddText(ImVec2(p0.x, y - 7), label, text);
+    }
+    draw_list->AddRect(a, b, frame);
+
+    std::vector<ImVec2> line(MODEL_POINTS);
+    for (int i = 0; i < MODEL_POINTS; i++)
+    {
+        line[i] = ImVec2(a.x + (b.x - a.x)*i/(MODEL_POINTS - 1), plot_y(model[i]));
+    }
+    draw_list->AddPolyline(&line[0], MODEL_POINTS, ImColor(230, 180, 0), false, 1.5f, true);
+
+    for (size_t i = 0; i < measured.size(); i++)
+    {
+        const Bode_Point &p = measured[i];
+        if (p.freq < BODE_PLOT_FMIN || p.freq > BODE_PLOT_FMAX)
+        {
+            continue;
+        }
+        float v = (float)(phase ? p.phase_deg : p.magnitude_db);
+        draw_list->AddCircleFilled(ImVec2(plot_x(p.freq), plot_y(v)), 2.5f,
+                                   ImColor(80, 180, 255, (int)(255*p.coherence)));
+    }
+
+    draw_list->AddText(ImVec2(a.x + 4, a.y + 2), label, phase ? "phase (deg)" : "magnitude (dB)");
+}
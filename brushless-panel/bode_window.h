@@ -0,0 +1,69 @@
+#ifndef BODE_WINDOW_H_
+#define BODE_WINDOW_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <imgui.h>
+#include "frequency_response.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define BODE_PLOT_FMIN 0.05 // Hz, left edge of the plots
+#define BODE_PLOT_FMAX 50   // Hz, Nyquist of the telemetry
+
+
+// ----------------------------------------------------------------------------------
+//   Bode Window Class
+// ----------------------------------------------------------------------------------
+/*
+ * Bode Window Class
+ *
+ * Frequency response of a recording (headless -r) excited by a sine or
+ * multisine profile: rpm against the pulse (open loop, "o1") or the
+ * set-point. The analysis runs on its own thread; magnitude and phase are
+ * drawn on log frequency axes over the documented plant model.
+ */
+class Bode_Window
+{
+
+public:
+
+    Bode_Window();
+    ~Bode_Window();
+
+    void draw(const char* title);
+
+    std::function<void()> on_done; // called from the analysis thread
+
+    void analyze();
+
+private:
+
+    char path[128];
+    int  input; // 0: pulse, 1: set-point
+
+    pthread_t       tid;
+    pthread_mutex_t lock;
+    bool            started;
+    bool            busy;
+    std::vector<Bode_Point> points;
+    std::string     status;
+
+    std::string job_path;
+    int         job_input;
+
+    void start();
+    void plot(const char* id, const std::vector<Bode_Point> &measured, bool phase, const ImVec2 &size);
+
+};
+
+
+#endif // BODE_WINDOW_H_
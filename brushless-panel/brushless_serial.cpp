@@ -0,0 +1,396 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <algorithm>
+#include "brushless_serial.h"
+#include "io_pool.h"
+#include "trace.h"
+
+BrushlessSerial::BrushlessSerial(Serial_Port *serial_port_, uint32_t history) : store(history){
+    pthread_mutex_init(&lock, NULL);
+    dataReset();
+    serial_port = serial_port_;
+    pool = NULL;
+    recorder = NULL;
+    identifier = NULL;
+    live_stats = NULL;
+    server = NULL;
+    last_line_trace.store(0);
+    auto_reconnect.store(true);
+    time_to_exit   = false;
+    reading_status = false;
+    writing_status = false;
+    started        = false;
+}
+
+BrushlessSerial::~BrushlessSerial(){
+    stop();
+    pthread_mutex_destroy(&lock);
+}
+
+void BrushlessSerial::read_messages(){
+    std::string line;
+    int result = serial_port->read_message(line);
+    if(result < 0){
+        if(auto_reconnect){
+            link_lost();
+        }else{
+            usleep(10000); // port error, don't spin
+        }
+        return;
+    }
+    if(result == 0){
+        return;
+    }
+
+    handle_line(line);
+}
+
+// everything after the read, on the thread that read the line
+void BrushlessSerial::handle_line(const std::string &line){
+    Telemetry_Sample sample;
+    double host_time = Telemetry::now();
+
+    pthread_mutex_lock(&lock);
+    bool is_sample;
+    {
+        TRACE_SCOPE("parse");
+        is_sample = telemetry.parse_line(line, host_time, sample);
+    }
+    {
+        TRACE_SCOPE("ring.publish");
+        if(is_sample){
+            store.push(sample); // before latest: its seq implies the row
+            latest = sample;
+            has_sample = true;
+            link.connected = true;
+        }else{
+            messages.push_back(line); // firmware messages go to the log
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    if(is_sample && appeared_time > 0){
+        double now = Telemetry::now();
+        pthread_mutex_lock(&lock);
+        link.reconnects++;
+        link.last_reconnect_ms = 1e3*(now - appeared_time);
+        link.last_outage_s = now - lost_time;
+        double reconnect_ms = link.last_reconnect_ms;
+        double outage = link.last_outage_s;
+        pthread_mutex_unlock(&lock);
+        appeared_time = 0;
+
+        char text[96];
+        snprintf(text, sizeof(text), "*** link back: %.1f ms to the first sample, %.1f s down ***", reconnect_ms, outage);
+        host_message(text);
+    }
+
+    // "*** line ***": the firmware took a command
+    if(!is_sample && line.size() > 8 && line.compare(0, 4, "*** ") == 0 && line.compare(line.size() - 4, 4, " ***") == 0){
+        std::string text = line.substr(4, line.size() - 8);
+        if(text == "invalid"){
+            commands.invalid();
+        }else{
+            commands.echo(text, host_time);
+        }
+    }
+
+    // only this thread touches the recorder, the identifier and the stats
+    TRACE_SCOPE("consumers");
+    if(recorder){
+        if(is_sample){
+            recorder->write(sample);
+        }else{
+            recorder->write_message(line);
+        }
+    }
+    if(identifier && is_sample){
+        identifier->update(sample);
+    }
+    if(live_stats && is_sample){
+        live_stats->update(sample);
+    }
+    if(server && is_sample){
+        server->publish(sample);
+    }
+
+    last_line_trace.store(trace_on.load(std::memory_order_relaxed) ? trace_now() : 0);
+
+    if(on_data){
+        on_data();
+    }
+}
+
+int BrushlessSerial::write_message(int msg){
+    return write_message(std::to_string(msg));
+}
+
+// the firmware takes one value or command per line
+int BrushlessSerial::write_message(const std::string &msg){
+    // do the write
+    int len = serial_port->write_message(msg + "\n");
+    // Done!
+    return len;
+}
+
+// queued, coalesced and acked by the write thread (command_queue.h)
+uint32_t BrushlessSerial::command(const std::string &line, int source){
+    return commands.push(line, source);
+}
+
+void BrushlessSerial::start(Io_Pool *pool_){
+    if(serial_port->status != SERIAL_PORT_OPEN && not auto_reconnect){
+        fprintf(stderr,"ERROR: serial port not open\n");
+        throw 1;
+    }
+    if(started){
+        stop();
+    }
+    dataReset();
+    if(pool_){
+        pool = pool_;
+        pool->add(this);
+        started = true;
+        return;
+    }
+    time_to_exit = false;
+    int result;
+    result = pthread_create( &read_tid, NULL, &start_brushless_interface_read_thread, this);
+    if (result) throw result;
+    result = pthread_create( &write_tid, NULL, &start_brushless_interface_write_thread, this);
+    if (result){
+        time_to_exit = true;
+        serial_port->interrupt();
+        pthread_join(read_tid, NULL);
+        throw result;
+    }
+    started = true;
+    return;
+}
+
+void BrushlessSerial::stop(){
+    if(not started){
+        return;
+    }
+    started = false;
+    if(pool){
+        pool->remove(this); // no more callbacks after this
+        pool = NULL;
+        return;
+    }
+    fprintf(stderr, "CLOSE THREADS\n");
+    // signal exit, and wake a read waiting on a quiet port
+    time_to_exit = true;
+    serial_port->interrupt();
+    commands.wake();
+    // wait for exit
+    pthread_join(read_tid , NULL);
+    pthread_join(write_tid, NULL);
+    // now the read and write threads are closed
+    fprintf(stderr, "\n");
+    // still need to close the serial_port separately
+}
+
+void BrushlessSerial::start_read_thread(){
+    if ( reading_status ){
+        fprintf(stderr,"read thread already running\n");
+        return;
+    }else{
+        read_thread();
+        return;
+    }
+}
+
+void BrushlessSerial::start_write_thread(){
+    if ( writing_status ){
+        fprintf(stderr,"write thread already running\n");
+        return;
+    }else{
+        write_thread();
+        return;
+    }
+}
+
+void BrushlessSerial::handle_quit(){
+    try {
+        stop();
+    }
+    catch (int error) {
+        fprintf(stderr,"Warning, could not stop autopilot interface\n");
+    }
+}
+
+// with the threads stopped: the store is written by the read thread
+void BrushlessSerial::dataReset(){
+    store.reset();
+    pthread_mutex_lock(&lock);
+    has_sample = false;
+    telemetry.reset();
+    latest = Telemetry_Sample();
+    messages.clear();
+    link.connected = false;
+    link.reconnects = 0;
+    link.last_reconnect_ms = -1;
+    link.last_outage_s = 0;
+    link.retry_ms = 0;
+    pthread_mutex_unlock(&lock);
+    lost_time = Telemetry::now();
+    appeared_time = 0;
+}
+
+void BrushlessSerial::values(Sample_View &view) const{
+    store.view(view);
+}
+
+Telemetry BrushlessSerial::telemetry_stats(){
+    pthread_mutex_lock(&lock);
+    Telemetry stats = telemetry;
+    pthread_mutex_unlock(&lock);
+    return stats;
+}
+
+bool BrushlessSerial::last_sample(Telemetry_Sample &sample){
+    pthread_mutex_lock(&lock);
+    bool valid = has_sample;
+    sample = latest;
+    pthread_mutex_unlock(&lock);
+    return valid;
+}
+
+void BrushlessSerial::take_messages(std::vector<std::string> &out){
+    pthread_mutex_lock(&lock);
+    out.swap(messages);
+    messages.clear();
+    pthread_mutex_unlock(&lock);
+}
+
+Link_Status BrushlessSerial::link_status(){
+    pthread_mutex_lock(&lock);
+    Link_Status status = link;
+    pthread_mutex_unlock(&lock);
+    return status;
+}
+
+void BrushlessSerial::set_recorder(Recorder *recorder_){
+    recorder = recorder_;
+}
+
+void BrushlessSerial::set_identifier(System_Id *identifier_){
+    identifier = identifier_;
+}
+
+void BrushlessSerial::set_live_stats(Live_Stats *live_stats_){
+    live_stats = live_stats_;
+}
+
+void BrushlessSerial::set_server(Telemetry_Server *server_){
+    server = server_;
+}
+
+// panel side messages, in the log and the recording like the firmware ones
+void BrushlessSerial::host_message(const std::string &text){
+    pthread_mutex_lock(&lock);
+    messages.push_back(text);
+    pthread_mutex_unlock(&lock);
+    if(recorder){
+        recorder->write_message(text);
+    }
+}
+
+void BrushlessSerial::link_lost(){
+    serial_port->close_serial();
+    lost_time = Telemetry::now();
+    appeared_time = 0;
+    pthread_mutex_lock(&lock);
+    link.connected = false;
+    pthread_mutex_unlock(&lock);
+    host_message("*** link lost: " + serial_port->uart_name + " ***");
+}
+
+// the port opened again: the next sample closes the outage
+void BrushlessSerial::reopened(double appeared){
+    // without an inotify event, the open is the best guess
+    appeared_time = appeared ? appeared : Telemetry::now();
+    pthread_mutex_lock(&lock);
+    link.retry_ms = 0;
+    telemetry.resync();
+    pthread_mutex_unlock(&lock);
+}
+
+void BrushlessSerial::set_retry(int ms){
+    pthread_mutex_lock(&lock);
+    link.retry_ms = ms;
+    pthread_mutex_unlock(&lock);
+}
+
+// until the port opens again (or stop()); runs on the read thread
+void BrushlessSerial::reconnect(){
+    int backoff = RECONNECT_MIN_MS;
+    double appeared = 0;
+    while( not time_to_exit ){
+        if(serial_port->try_open()){
+            reopened(appeared);
+            break;
+        }
+        set_retry(backoff);
+
+        if(serial_port->wait_for_device(backoff) > 0){
+            appeared = Telemetry::now();
+            backoff = RECONNECT_MIN_MS; // udev may still be setting it up
+        }else{
+            backoff = std::min(2*backoff, RECONNECT_MAX_MS);
+        }
+    }
+}
+
+// Io_Pool: the port is readable, handle what it has (-1: read error)
+int BrushlessSerial::read_ready(){
+    ready_lines.clear();
+    int count = serial_port->read_lines(ready_lines);
+    for(size_t i = 0; i < ready_lines.size(); i++){
+        handle_line(ready_lines[i]);
+    }
+    return count;
+}
+
+void BrushlessSerial::read_thread(){
+    trace_thread_name("serial read");
+    reading_status = true;
+    while( not time_to_exit ){
+        if(serial_port->status != SERIAL_PORT_OPEN){
+            reconnect();
+        }else{
+            read_messages();
+        }
+        // usleep(100000); // Read batches at 10Hz
+    }
+    reading_status = false;
+    return;
+}
+
+void BrushlessSerial::write_thread(){
+    trace_thread_name("serial write");
+    writing_status = true;
+    std::string line;
+    while( not time_to_exit ){
+        // wakes for stop() at the latest after 50ms
+        if(commands.next(line, 0.05)){
+            write_message(line);
+            commands.sent(Telemetry::now());
+        }
+    }
+    writing_status = false;
+    return;
+}
+
+void* start_brushless_interface_read_thread(void *args){
+    BrushlessSerial *brushless_interface = (BrushlessSerial *)args;
+    brushless_interface->start_read_thread();
+    return NULL;
+}
+
+void* start_brushless_interface_write_thread(void *args){
+    BrushlessSerial *brushless_interface = (BrushlessSerial *)args;
+    brushless_interface->start_write_thread();
+    return NULL;
+}
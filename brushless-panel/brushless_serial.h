@@ -0,0 +1,153 @@
+#ifndef BRUSHLESS_SERIAL_H_
+#define BRUSHLESS_SERIAL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <atomic>
+#include "serial_port.h"
+#include "telemetry.h"
+#include "recorder.h"
+#include "system_id.h"
+#include "live_stats.h"
+#include "telemetry_server.h"
+#include "command_queue.h"
+#include "sample_store.h"
+
+#define RECONNECT_MIN_MS 10   // first retry after the port is lost
+#define RECONNECT_MAX_MS 500  // backoff limit (inotify usually wakes it first)
+
+// state of the link as the read thread sees it
+struct Link_Status
+{
+    bool     connected;
+    uint32_t reconnects;
+    double   last_reconnect_ms; // device back -> first sample (-1: none yet)
+    double   last_outage_s;     // port lost -> first sample
+    int      retry_ms;          // current backoff while disconnected
+};
+
+class Io_Pool;
+
+void* start_brushless_interface_read_thread(void *args);
+void* start_brushless_interface_write_thread(void *args);
+
+/*
+ * Reads the firmware telemetry from a Serial_Port on its own thread and
+ * keeps what the panel (or the headless runner) needs: link statistics,
+ * the last sample, the history (a Sample_Store, read through views
+ * without a lock or a copy) and the firmware messages. No SDL/GL here,
+ * so it links into the headless build too.
+ *
+ * start() and stop() are called from one controlling thread, with the
+ * port open; stop() interrupts the read and joins, so it returns in about
+ * one line time. The destructor stops the threads, so the object can go
+ * out of scope with the port open (destroy it before the Serial_Port).
+ *
+ * With auto_reconnect a read error (the adapter was unplugged) closes the
+ * port and the read thread waits for it to come back, retrying with an
+ * exponential backoff that a hot-plug event (Serial_Port::wait_for_device)
+ * cuts short. Recording, identification and stats simply resume; the
+ * outage and the reconnect time go to the messages ("*** link ... ***")
+ * and to link_status(). start() then also works with the port closed.
+ *
+ * start(pool) reads on a shared Io_Pool thread instead of starting its
+ * own (many motors, see io_pool.h); everything else is the same.
+ *
+ * command() queues a set-point or parameter for the write thread, which
+ * sends them one at a time and takes the firmware echo as the ack (see
+ * command_queue.h; not with start(pool), which has no write thread).
+ * write_message() writes at once, for the profile runner's timed lines.
+ */
+class BrushlessSerial{
+public:
+
+    BrushlessSerial(Serial_Port *serial_port_, uint32_t history = SAMPLE_STORE_LEN);
+    ~BrushlessSerial();
+
+    void read_messages();
+    int write_message(int msg);
+    int write_message(const std::string &msg);
+    uint32_t command(const std::string &line, int source = COMMAND_UI);
+
+    void start(Io_Pool *pool_ = NULL);
+    void stop();
+
+    void start_read_thread();
+    void start_write_thread();
+
+    void handle_quit();
+
+    void dataReset();
+
+    // the history, in place (see sample_store.h), any thread
+    void values(Sample_View &view) const;
+    Telemetry telemetry_stats();
+    bool last_sample(Telemetry_Sample &sample);
+    void take_messages(std::vector<std::string> &out);
+    Link_Status link_status();
+
+    // samples are also written here (set before start, owned by the caller)
+    void set_recorder(Recorder *recorder_);
+    // and fed to the plant identification (same rules)
+    void set_identifier(System_Id *identifier_);
+    void set_live_stats(Live_Stats *live_stats_);
+    // and streamed to the local subscribers (telemetry_server.h)
+    void set_server(Telemetry_Server *server_);
+
+    // called from the read thread after each line (wakes the render loop)
+    std::function<void()> on_data;
+
+    // trace_now() when the last line was handled (0 when not tracing),
+    // for the line -> screen latency
+    std::atomic<uint64_t> last_line_trace;
+
+    std::atomic<bool> auto_reconnect; // true
+
+    Command_Queue commands;
+
+private:
+    friend class Io_Pool;
+
+    void handle_line(const std::string &line);
+    int  read_ready();
+    void reopened(double appeared);
+    void set_retry(int ms);
+    void host_message(const std::string &text);
+    void link_lost();
+    void reconnect();
+
+    void read_thread();
+    void write_thread();
+
+    Serial_Port *serial_port;
+    Io_Pool *pool;
+    std::vector<std::string> ready_lines;
+    Recorder *recorder;
+    System_Id *identifier;
+    Live_Stats *live_stats;
+    Telemetry_Server *server;
+
+    std::atomic<bool> reading_status;
+    std::atomic<bool> writing_status;
+    std::atomic<bool> time_to_exit;
+    bool started;
+
+    Telemetry telemetry;
+    Telemetry_Sample latest;
+    std::vector<std::string> messages;
+    Sample_Store store; // written by the read thread, read without the lock
+    bool has_sample;
+
+    Link_Status link;
+    double lost_time;      // read thread only
+    double appeared_time;  // device back (0: not waiting for the first sample)
+
+    pthread_t read_tid;
+    pthread_t write_tid;
+    pthread_mutex_t lock;
+};
+
+#endif // BRUSHLESS_SERIAL_H_
@@ -0,0 +1,277 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "command_queue.h"
+#include "telemetry.h"
+
+#include <time.h>
+#include <algorithm>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Command_Queue::
+Command_Queue()
+{
+    // timed waits on the same clock as Telemetry::now()
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&lock, NULL);
+
+    flying          = false;
+    flagged_invalid = false;
+    woken           = false;
+    sent_time       = 0;
+    next_id         = 1;
+    counts          = Command_Stats();
+    latency_count   = 0;
+}
+
+Command_Queue::
+~Command_Queue()
+{
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Queue
+// ------------------------------------------------------------------------------
+// what the firmware takes (serial_command): a number, or a letter and a
+// number, up to COMMAND_MAX_LEN characters (longer lines are dropped by
+// serial_read_line and answered "*** invalid ***")
+bool
+Command_Queue::
+valid(const std::string &line)
+{
+    if (line.empty() || line.size() > COMMAND_MAX_LEN)
+    {
+        return false;
+    }
+    size_t i = (line[0] >= 'a' && line[0] <= 'z') ? 1 : 0;
+    if (i < line.size() && line[i] == '-')
+    {
+        i++;
+    }
+    for (; i < line.size(); i++)
+    {
+        if (line[i] < '0' || line[i] > '9')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+char
+Command_Queue::
+kind_of(const std::string &line)
+{
+    return (line[0] >= 'a' && line[0] <= 'z') ? line[0] : '#';
+}
+
+uint32_t
+Command_Queue::
+push(const std::string &line, int source)
+{
+    if (!valid(line))
+    {
+        return 0;
+    }
+
+    std::vector<Command_Result> done;
+    pthread_mutex_lock(&lock);
+    Command command;
+    command.id     = next_id++;
+    command.source = source;
+    command.kind   = kind_of(line);
+    command.queued = Telemetry::now();
+    command.line   = line;
+    counts.queued++;
+
+    bool replaced = false;
+    for (size_t i = 0; i < pending.size() && !replaced; i++)
+    {
+        if (pending[i].kind == command.kind)
+        {
+            settle(pending[i], COMMAND_COALESCED, 0, done);
+            pending[i] = command; // keeps its place
+            replaced   = true;
+        }
+    }
+    if (!replaced)
+    {
+        pending.push_back(command);
+    }
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+
+    report(done);
+    return command.id;
+}
+
+bool
+Command_Queue::
+next(std::string &line, double timeout)
+{
+    std::vector<Command_Result> done;
+    bool found = false;
+    double deadline = Telemetry::now() + timeout;
+
+    pthread_mutex_lock(&lock);
+    while (true)
+    {
+        double now = Telemetry::now();
+        if (flying && now - sent_time >= COMMAND_ACK_TIMEOUT)
+        {
+            settle(in_flight, COMMAND_TIMEOUT, 0, done);
+            flying = false;
+        }
+        if (!flying && !pending.empty())
+        {
+            in_flight = pending.front();
+            pending.erase(pending.begin());
+            flying          = true;
+            flagged_invalid = false;
+            sent_time       = now; // until sent() says when
+            line  = in_flight.line;
+            found = true;
+            break;
+        }
+        if (now >= deadline || woken)
+        {
+            woken = false;
+            break;
+        }
+
+        double until = flying ? std::min(deadline, sent_time + COMMAND_ACK_TIMEOUT) : deadline;
+        struct timespec ts;
+        ts.tv_sec  = (time_t)until;
+        ts.tv_nsec = (long)((until - ts.tv_sec)*1e9);
+        pthread_cond_timedwait(&cond, &lock, &ts);
+    }
+    pthread_mutex_unlock(&lock);
+
+    report(done);
+    return found;
+}
+
+void
+Command_Queue::
+sent(double time)
+{
+    pthread_mutex_lock(&lock);
+    sent_time = time;
+    counts.sent++;
+    pthread_mutex_unlock(&lock);
+}
+
+void
+Command_Queue::
+wake()
+{
+    pthread_mutex_lock(&lock);
+    woken = true; // also when next() is not waiting yet
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Acks
+// ------------------------------------------------------------------------------
+// other echoes ("*** idle 97.5% ***", or of a line written around the
+// queue) do not match and are ignored
+void
+Command_Queue::
+echo(const std::string &text, double time)
+{
+    std::vector<Command_Result> done;
+    pthread_mutex_lock(&lock);
+    if (flying && text == in_flight.line)
+    {
+        settle(in_flight, flagged_invalid ? COMMAND_INVALID : COMMAND_ACKED, time - in_flight.queued, done);
+        flying = false;
+        pthread_cond_signal(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+    report(done);
+}
+
+void
+Command_Queue::
+invalid()
+{
+    pthread_mutex_lock(&lock);
+    if (flying)
+    {
+        flagged_invalid = true;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+Command_Stats
+Command_Queue::
+stats()
+{
+    pthread_mutex_lock(&lock);
+    Command_Stats out = counts;
+    std::vector<double> sorted(latency, latency + std::min(latency_count, (uint32_t)COMMAND_HISTORY));
+    pthread_mutex_unlock(&lock);
+
+    if (!sorted.empty())
+    {
+        std::sort(sorted.begin(), sorted.end());
+        out.p50 = sorted[(size_t)(0.50*(sorted.size() - 1))];
+        out.p99 = sorted[(size_t)(0.99*(sorted.size() - 1))];
+        out.max = sorted.back();
+    }
+    return out;
+}
+
+// lock held
+void
+Command_Queue::
+settle(const Command &command, int state, double latency_s, std::vector<Command_Result> &done)
+{
+    switch (state)
+    {
+        case COMMAND_ACKED:     counts.acked++;     break;
+        case COMMAND_INVALID:   counts.invalid++;   break;
+        case COMMAND_COALESCED: counts.coalesced++; break;
+        case COMMAND_TIMEOUT:   counts.timeouts++;  break;
+    }
+    if (state == COMMAND_ACKED || state == COMMAND_INVALID)
+    {
+        latency[latency_count % COMMAND_HISTORY] = latency_s;
+        latency_count++;
+    }
+
+    Command_Result result;
+    result.id      = command.id;
+    result.source  = command.source;
+    result.state   = state;
+    result.latency = latency_s;
+    result.line    = command.line;
+    done.push_back(result);
+}
+
+void
+Command_Queue::
+report(const std::vector<Command_Result> &done)
+{
+    if (!on_result)
+    {
+        return;
+    }
+    for (size_t i = 0; i < done.size(); i++)
+    {
+        on_result(done[i]);
+    }
+}
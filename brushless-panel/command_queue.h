@@ -0,0 +1,146 @@
+#ifndef COMMAND_QUEUE_H_
+#define COMMAND_QUEUE_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define COMMAND_MAX_LEN     15    // firmware line buffer is 16 bytes with the '\0'
+#define COMMAND_ACK_TIMEOUT 0.2   // s without the echo: given up, the next one goes
+#define COMMAND_HISTORY     256   // latencies kept for the percentiles
+
+// who queued it
+#define COMMAND_UI     0
+#define COMMAND_REMOTE 1
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+enum Command_State
+{
+    COMMAND_QUEUED,
+    COMMAND_SENT,
+    COMMAND_ACKED,     // the firmware echoed it ("*** line ***")
+    COMMAND_INVALID,   // echoed after "*** invalid ***"
+    COMMAND_COALESCED, // replaced by a newer one of the same kind before it was sent
+    COMMAND_TIMEOUT,
+};
+
+struct Command_Result
+{
+    uint32_t    id;
+    int         source;
+    int         state;
+    double      latency; // s, queued -> echo (ACKED, INVALID)
+    std::string line;
+};
+
+struct Command_Stats
+{
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t acked;
+    uint32_t invalid;
+    uint32_t coalesced;
+    uint32_t timeouts;
+    double   p50;     // s, command -> ack, last COMMAND_HISTORY
+    double   p99;
+    double   max;
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Command Queue Class
+// ----------------------------------------------------------------------------------
+/*
+ * Command Queue Class
+ *
+ * Set-points and parameter commands from every source (UI, remote API)
+ * on their way to the firmware. The RX interrupt only queues the bytes
+ * (SERIALRXSIZE, 64); the main loop takes the complete lines one by one
+ * between samples (serial_poll) and echoes each after applying it, so an
+ * echo comes within a sample period or two. Bytes that find the queue
+ * full are dropped and their line is never echoed, so commands go one at
+ * a time: the next is written when the last one was echoed, or after
+ * COMMAND_ACK_TIMEOUT (the line was lost, or the firmware is gone).
+ *
+ * While waiting, a command replaces a queued one of the same kind (a
+ * set-point the previous set-point, "g5" a queued "g3"; the kind is the
+ * first letter, or "set-point" for numbers) in its place in the queue, so
+ * the queue never holds more than one command per kind and a burst of
+ * slider moves costs one write. The replaced one ends as COALESCED.
+ *
+ * push() may be called from any thread; next()/sent() from the write
+ * thread, echo()/invalid() from the read thread. on_result is called on
+ * whichever of those threads settles a command, without the lock held.
+ */
+class Command_Queue
+{
+
+public:
+
+    Command_Queue();
+    ~Command_Queue();
+
+    // returns the id (0: not a firmware command, see valid())
+    uint32_t push(const std::string &line, int source);
+    static bool valid(const std::string &line);
+
+    // write thread: waits up to timeout s for a command to write
+    bool next(std::string &line, double timeout);
+    void sent(double time);
+    void wake(); // next() returns now (stop)
+
+    // read thread: a "*** text ***" line, and "*** invalid ***"
+    void echo(const std::string &text, double time);
+    void invalid();
+
+    Command_Stats stats();
+
+    std::function<void(const Command_Result&)> on_result;
+
+private:
+
+    struct Command
+    {
+        uint32_t    id;
+        int         source;
+        char        kind;
+        double      queued;
+        std::string line;
+    };
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    std::vector<Command> pending;
+    Command  in_flight;
+    bool     flying;
+    bool     flagged_invalid; // "*** invalid ***" seen for in_flight
+    bool     woken;           // wake(): next() returns
+    double   sent_time;
+    uint32_t next_id;
+
+    Command_Stats counts;
+    double   latency[COMMAND_HISTORY];
+    uint32_t latency_count;
+
+    static char kind_of(const std::string &line);
+    void settle(const Command &command, int state, double latency, std::vector<Command_Result> &done);
+    void report(const std::vector<Command_Result> &done);
+
+};
+
+
+#endif // COMMAND_QUEUE_H_
@@ -0,0 +1,408 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "command_server.h"
+#include "telemetry_server.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Command_Server::
+Command_Server(Command_Queue *queue_)
+{
+    queue = queue_;
+    pthread_mutex_init(&lock, NULL);
+    for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+    {
+        slots[i].fd = -1;
+    }
+    listen_fd = -1;
+    wake_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    started   = false;
+    quit.store(false);
+
+    queue->on_result = [this](const Command_Result &r){ result(r); };
+}
+
+Command_Server::
+~Command_Server()
+{
+    stop();
+    queue->on_result = nullptr;
+    close(wake_fd);
+    pthread_mutex_destroy(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Start / Stop
+// ------------------------------------------------------------------------------
+bool
+Command_Server::
+start(const std::string &address)
+{
+    stop();
+
+    listen_fd = listen_local(address, unix_path);
+    if (listen_fd < 0)
+    {
+        return false;
+    }
+
+    quit.store(false);
+    if (pthread_create(&tid, NULL, &Command_Server::start_server_thread, this))
+    {
+        fprintf(stderr, "command server: could not start the thread\n");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    started = true;
+    fprintf(stderr, "TAKING COMMANDS ON %s\n", address.c_str());
+    return true;
+}
+
+void
+Command_Server::
+stop()
+{
+    if (!started)
+    {
+        return;
+    }
+    quit.store(true);
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+    pthread_join(tid, NULL);
+    started = false;
+
+    for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+    {
+        if (slots[i].fd >= 0)
+        {
+            remove(i);
+        }
+    }
+    close(listen_fd);
+    listen_fd = -1;
+    if (!unix_path.empty())
+    {
+        unlink(unix_path.c_str());
+        unix_path.clear();
+    }
+}
+
+bool
+Command_Server::
+running() const
+{
+    return started;
+}
+
+int
+Command_Server::
+clients()
+{
+    int count = 0;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+    {
+        count += (slots[i].fd >= 0);
+    }
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Server Thread
+// ------------------------------------------------------------------------------
+void*
+Command_Server::
+start_server_thread(void *args)
+{
+    Command_Server *server = (Command_Server*)args;
+    server->run();
+    return NULL;
+}
+
+void
+Command_Server::
+run()
+{
+    trace_thread_name("command server");
+
+    struct pollfd fds[2 + COMMAND_SERVER_CLIENTS];
+    int           slot_of[2 + COMMAND_SERVER_CLIENTS];
+    char          buf[256];
+
+    while (!quit.load())
+    {
+        int n = 0;
+        fds[n].fd = wake_fd;   fds[n].events = POLLIN; n++;
+        fds[n].fd = listen_fd; fds[n].events = POLLIN; n++;
+        pthread_mutex_lock(&lock);
+        for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+        {
+            if (slots[i].fd < 0)
+            {
+                continue;
+            }
+            fds[n].fd     = slots[i].fd;
+            fds[n].events = POLLIN | (slots[i].out.empty() ? 0 : POLLOUT);
+            slot_of[n]    = i;
+            n++;
+        }
+        pthread_mutex_unlock(&lock);
+
+        if (poll(fds, n, -1) < 0)
+        {
+            continue; // EINTR
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t count;
+            ssize_t drained = read(wake_fd, &count, sizeof(count));
+            (void)drained;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            accept_client();
+        }
+
+        for (int k = 2; k < n; k++)
+        {
+            int slot = slot_of[k];
+            if (fds[k].revents & (POLLERR | POLLNVAL))
+            {
+                remove(slot);
+                continue;
+            }
+            if (!(fds[k].revents & (POLLIN | POLLHUP)))
+            {
+                continue;
+            }
+            ssize_t got = recv(slots[slot].fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                remove(slot);
+                continue;
+            }
+
+            // one request per line
+            Client &c = slots[slot];
+            c.in.append(buf, got > 0 ? got : 0);
+            size_t end;
+            while ((end = c.in.find('\n')) != std::string::npos)
+            {
+                std::string line = c.in.substr(0, end);
+                c.in.erase(0, end + 1);
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                {
+                    line.erase(line.size() - 1);
+                }
+                if (!line.empty())
+                {
+                    request(slot, line);
+                }
+            }
+            if (c.in.size() > COMMAND_SERVER_LINE)
+            {
+                c.in.clear();
+                request(slot, "?"); // answers "error"
+            }
+        }
+
+        for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+        {
+            if (slots[i].fd >= 0 && !flush(i))
+            {
+                remove(i);
+            }
+        }
+    }
+}
+
+void
+Command_Server::
+accept_client()
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < COMMAND_SERVER_CLIENTS; i++)
+    {
+        if (slots[i].fd < 0)
+        {
+            slots[i].fd = fd;
+            slots[i].in.clear();
+            slots[i].out.clear();
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    fprintf(stderr, "command server: %d clients already, refused\n", COMMAND_SERVER_CLIENTS);
+    close(fd);
+}
+
+// server thread (or stop(), after it)
+void
+Command_Server::
+remove(int slot)
+{
+    pthread_mutex_lock(&lock);
+    close(slots[slot].fd);
+    slots[slot].fd = -1;
+    slots[slot].in.clear();
+    slots[slot].out.clear();
+    for (std::map<uint32_t, int>::iterator it = owner.begin(); it != owner.end(); )
+    {
+        if (it->second == slot)
+        {
+            owner.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void
+Command_Server::
+request(int slot, const std::string &line)
+{
+    char text[96];
+    if (line == "stats")
+    {
+        Command_Stats s = queue->stats();
+        snprintf(text, sizeof(text), "stats %u %u %u %u %u %u %.2f %.2f %.2f\n", s.queued, s.sent, s.acked,
+                 s.invalid, s.coalesced, s.timeouts, 1e3*s.p50, 1e3*s.p99, 1e3*s.max);
+        pthread_mutex_lock(&lock);
+        slots[slot].out += text;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    // not under the lock: push() may settle (and report) an older command
+    uint32_t id = queue->push(line, COMMAND_REMOTE);
+
+    pthread_mutex_lock(&lock);
+    if (id == 0)
+    {
+        snprintf(text, sizeof(text), "error %.*s\n", COMMAND_SERVER_LINE, line.c_str());
+        slots[slot].out += text;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    snprintf(text, sizeof(text), "queued %u\n", id);
+    slots[slot].out += text;
+    owner[id] = slot;
+
+    // settled between push() and here
+    for (size_t i = 0; i < early.size(); i++)
+    {
+        if (early[i].id == id)
+        {
+            reply(slot, early[i]);
+            owner.erase(id);
+            early.erase(early.begin() + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Results (write, read or server thread)
+// ------------------------------------------------------------------------------
+void
+Command_Server::
+result(const Command_Result &r)
+{
+    if (r.source != COMMAND_REMOTE)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    std::map<uint32_t, int>::iterator it = owner.find(r.id);
+    if (it == owner.end())
+    {
+        early.push_back(r);
+        if (early.size() > COMMAND_SERVER_CLIENTS)
+        {
+            early.erase(early.begin()); // its client left
+        }
+    }
+    else
+    {
+        reply(it->second, r);
+        owner.erase(it);
+    }
+    pthread_mutex_unlock(&lock);
+
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+// lock held
+void
+Command_Server::
+reply(int slot, const Command_Result &r)
+{
+    char text[64];
+    switch (r.state)
+    {
+        case COMMAND_ACKED:     snprintf(text, sizeof(text), "ack %u %.2f\n", r.id, 1e3*r.latency);     break;
+        case COMMAND_INVALID:   snprintf(text, sizeof(text), "invalid %u %.2f\n", r.id, 1e3*r.latency); break;
+        case COMMAND_COALESCED: snprintf(text, sizeof(text), "coalesced %u\n", r.id);                   break;
+        default:                snprintf(text, sizeof(text), "timeout %u\n", r.id);                     break;
+    }
+    slots[slot].out += text;
+}
+
+// false when the client is gone, or stopped reading
+bool
+Command_Server::
+flush(int slot)
+{
+    pthread_mutex_lock(&lock);
+    Client &c = slots[slot];
+    bool ok = true;
+    if (!c.out.empty())
+    {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0)
+        {
+            c.out.erase(0, n);
+        }
+        else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            ok = false;
+        }
+        ok = ok && c.out.size() <= COMMAND_SERVER_BACKLOG;
+    }
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
@@ -0,0 +1,99 @@
+#ifndef COMMAND_SERVER_H_
+#define COMMAND_SERVER_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include "command_queue.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define COMMAND_SERVER_CLIENTS 8
+#define COMMAND_SERVER_LINE    64     // longest request line
+#define COMMAND_SERVER_BACKLOG 65536  // bytes of replies a client may leave unread
+
+
+// ----------------------------------------------------------------------------------
+//   Command Server Class
+// ----------------------------------------------------------------------------------
+/*
+ * Command Server Class
+ *
+ * Set-points and parameters from automation, on a local socket (same
+ * addresses as Telemetry_Server). Text lines in both directions; a
+ * request is a firmware line ("3000", "g5", "o1") or "stats":
+ *
+ *      -> 3000
+ *      <- queued 17
+ *      <- ack 17 4.21          (ms from the request to the firmware echo)
+ *
+ * or "invalid <id> <ms>" (the firmware refused it), "coalesced <id>" (a
+ * newer command of the same kind replaced it before it was sent),
+ * "timeout <id>" and "error <line>" (not a firmware command). "stats"
+ * answers "stats queued sent acked invalid coalesced timeouts p50_ms
+ * p99_ms max_ms" of the whole queue, UI included.
+ *
+ * The commands go into the BrushlessSerial Command_Queue with the UI's,
+ * so they are coalesced and sent one at a time like those. The server
+ * takes the queue's on_result: create it before the BrushlessSerial
+ * starts and destroy it after it stops.
+ */
+class Command_Server
+{
+
+public:
+
+    Command_Server(Command_Queue *queue_);
+    ~Command_Server();
+
+    bool start(const std::string &address); // false if it can't listen
+    void stop();
+    bool running() const;
+
+    int  clients();
+
+private:
+
+    struct Client
+    {
+        int         fd;     // -1: free
+        std::string in;     // server thread
+        std::string out;    // lock
+    };
+
+    Command_Queue *queue;
+
+    pthread_mutex_t lock;
+    Client          slots[COMMAND_SERVER_CLIENTS];
+    std::map<uint32_t, int>  owner;     // command id -> slot
+    std::vector<Command_Result> early;  // settled before owner knew them
+
+    int         listen_fd;
+    int         wake_fd;   // eventfd: replies to send, or stop()
+    std::string unix_path;
+    pthread_t   tid;
+    bool        started;
+    std::atomic<bool> quit;
+
+    static void* start_server_thread(void *args);
+    void run();
+    void accept_client();
+    void remove(int slot);
+    void request(int slot, const std::string &line);
+    void result(const Command_Result &result);
+    void reply(int slot, const Command_Result &result);
+    bool flush(int slot);
+
+};
+
+
+#endif // COMMAND_SERVER_H_
@@ -0,0 +1,202 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "frame_scheduler.h"
+
+#include <math.h>
+#include <time.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Frame_Scheduler::
+Frame_Scheduler(int target_fps_)
+{
+    target_fps = target_fps_;
+
+    // user event used by other threads to wake the loop
+    wake_event = SDL_RegisterEvents(1);
+    if (wake_event == (Uint32)-1)
+    {
+        wake_event = SDL_USEREVENT;
+    }
+    SDL_AtomicSet(&wake_pending, 0);
+
+    pending     = 1; // first frame
+    last_frame  = 0;
+    frame_start = 0;
+
+    frame_ms    = 0;
+    fps         = 0;
+    cpu_percent = 0;
+
+    stats_start  = now();
+    stats_cpu    = cpu_time();
+    stats_busy   = 0;
+    stats_frames = 0;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Wait
+// ------------------------------------------------------------------------------
+/**
+ * Blocks until an event arrives or the next frame is due. Returns true if
+ * event was filled. With nothing requested it sleeps up to
+ * FRAME_IDLE_TIMEOUT and then asks for one frame to refresh the overlay.
+ */
+bool
+Frame_Scheduler::
+wait(SDL_Event &event)
+{
+    int timeout = FRAME_IDLE_TIMEOUT;
+
+    if (pending > 0)
+    {
+        double remaining = last_frame + interval() - now();
+        timeout = (remaining > 0) ? (int)ceil(1e3*remaining) : 0;
+    }
+
+    if (timeout == 0)
+    {
+        return SDL_PollEvent(&event);
+    }
+
+    if (SDL_WaitEventTimeout(&event, timeout))
+    {
+        return true;
+    }
+
+    if (pending == 0)
+    {
+        request(1);
+    }
+    return false;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Requests
+// ------------------------------------------------------------------------------
+void
+Frame_Scheduler::
+handle(const SDL_Event &event)
+{
+    if (is_wake(event))
+    {
+        SDL_AtomicSet(&wake_pending, 0);
+        request(1);
+    }
+    else
+    {
+        request(FRAME_INPUT_FRAMES);
+    }
+}
+
+bool
+Frame_Scheduler::
+is_wake(const SDL_Event &event) const
+{
+    return event.type == wake_event;
+}
+
+void
+Frame_Scheduler::
+request(int frames)
+{
+    if (frames > pending)
+    {
+        pending = frames;
+    }
+}
+
+bool
+Frame_Scheduler::
+frame_due()
+{
+    return pending > 0 && now() >= last_frame + interval();
+}
+
+// thread safe: at most one wake event is queued at a time
+void
+Frame_Scheduler::
+wake()
+{
+    if (SDL_AtomicCAS(&wake_pending, 0, 1))
+    {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = wake_event;
+        SDL_PushEvent(&event);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Frame Timing
+// ------------------------------------------------------------------------------
+void
+Frame_Scheduler::
+begin_frame()
+{
+    frame_start = now();
+    last_frame  = frame_start;
+    pending--;
+}
+
+// called before the buffer swap, so vsync waits are not counted as work
+void
+Frame_Scheduler::
+end_frame()
+{
+    double t = now();
+
+    stats_busy += t - frame_start;
+    stats_frames++;
+
+    double elapsed = t - stats_start;
+    if (elapsed >= FRAME_STATS_PERIOD)
+    {
+        double cpu = cpu_time();
+
+        frame_ms    = 1e3*stats_busy/stats_frames;
+        fps         = stats_frames/elapsed;
+        cpu_percent = 100*(cpu - stats_cpu)/elapsed;
+
+        stats_start  = t;
+        stats_cpu    = cpu;
+        stats_busy   = 0;
+        stats_frames = 0;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Helper Functions
+// ------------------------------------------------------------------------------
+double
+Frame_Scheduler::
+interval() const
+{
+    return 1.0/((target_fps > 0) ? target_fps : 1);
+}
+
+double
+Frame_Scheduler::
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+double
+Frame_Scheduler::
+cpu_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
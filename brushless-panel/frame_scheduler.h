@@ -0,0 +1,77 @@
+#ifndef FRAME_SCHEDULER_H_
+#define FRAME_SCHEDULER_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <SDL.h>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define FRAME_DEFAULT_FPS   30
+#define FRAME_INPUT_FRAMES  3    // frames redrawn after input (ImGui settles)
+#define FRAME_IDLE_TIMEOUT  1000 // ms, idle redraw to refresh the overlay
+#define FRAME_STATS_PERIOD  0.5  // s, frame time / CPU averaging window
+
+
+// ----------------------------------------------------------------------------------
+//   Frame Scheduler Class
+// ----------------------------------------------------------------------------------
+/*
+ * Frame Scheduler Class
+ *
+ * Paces the render loop: a frame is drawn only when something asked for it
+ * (input, new samples, the idle timeout) and never faster than target_fps.
+ * Between frames the loop blocks in SDL_WaitEventTimeout. Other threads
+ * wake it with wake(), which pushes a single coalesced SDL user event.
+ */
+class Frame_Scheduler
+{
+
+public:
+
+    Frame_Scheduler(int target_fps_);
+
+    int target_fps;
+
+    bool wait(SDL_Event &event);
+    void handle(const SDL_Event &event);
+    bool is_wake(const SDL_Event &event) const;
+    void request(int frames);
+    bool frame_due();
+
+    void begin_frame();
+    void end_frame();
+
+    void wake();
+
+    // statistics, averaged over FRAME_STATS_PERIOD
+    double frame_ms;    // time spent building and rendering a frame
+    double fps;         // frames actually drawn per second
+    double cpu_percent; // process CPU time (all threads) over wall time
+
+private:
+
+    Uint32 wake_event;
+    SDL_atomic_t wake_pending;
+
+    int    pending;      // frames still requested
+    double last_frame;   // start of the last frame drawn
+    double frame_start;
+
+    double stats_start;  // wall clock of the current window
+    double stats_cpu;    // process CPU time at stats_start
+    double stats_busy;   // frame time accumulated in the window
+    int    stats_frames;
+
+    double interval() const;
+    static double now();
+    static double cpu_time();
+
+};
+
+
+#endif // FRAME_SCHEDULER_H_
@@ -0,0 +1,395 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "frequency_response.h"
+#include "telemetry.h"
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
+
+
+// ------------------------------------------------------------------------------
+//   FFT
+// ------------------------------------------------------------------------------
+/*
+ * Radix-2 decimation in time on split real/imaginary arrays. The twiddles
+ * of the butterfly of half size h are stored contiguously at [h, 2h), so
+ * the inner loops read every array with unit stride and vectorize.
+ */
+struct Fft_Plan
+{
+    int                n;
+    std::vector<float> cos_table;
+    std::vector<float> sin_table;
+    std::vector<int>   reverse;
+    std::vector<float> window; // Hann
+
+    Fft_Plan(int n_);
+};
+
+Fft_Plan::
+Fft_Plan(int n_)
+    : n(n_), cos_table(n_), sin_table(n_), reverse(n_), window(n_)
+{
+    int bits = 0;
+    while ((1 << bits) < n)
+    {
+        bits++;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        reverse[i] = r;
+        window[i]  = (float)(0.5 - 0.5*cos(2*M_PI*i/n));
+    }
+
+    for (int half = 1; half < n; half *= 2)
+    {
+        for (int k = 0; k < half; k++)
+        {
+            cos_table[half + k] = (float)cos(M_PI*k/half);
+            sin_table[half + k] = (float)-sin(M_PI*k/half);
+        }
+    }
+}
+
+static void
+fft(const Fft_Plan &plan, float *re, float *im)
+{
+    const int n = plan.n;
+
+    for (int i = 0; i < n; i++)
+    {
+        int j = plan.reverse[i];
+        if (i < j)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    for (int half = 1; half < n; half *= 2)
+    {
+        const float *wr = &plan.cos_table[half];
+        const float *wi = &plan.sin_table[half];
+        for (int start = 0; start < n; start += 2*half)
+        {
+            float *ar = re + start;
+            float *ai = im + start;
+            float *br = ar + half;
+            float *bi = ai + half;
+            for (int k = 0; k < half; k++)
+            {
+                float tr = wr[k]*br[k] - wi[k]*bi[k];
+                float ti = wr[k]*bi[k] + wi[k]*br[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] = ar[k] + tr;
+                ai[k] = ai[k] + ti;
+            }
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Welch Workers
+// ------------------------------------------------------------------------------
+struct Welch_Job
+{
+    const Fft_Plan *plan;
+    const float    *u;
+    const float    *y;
+    int             first; // segments [first, last)
+    int             last;
+    int             step;
+
+    // private spectra, bins 0..n/2
+    std::vector<double> suu;
+    std::vector<double> syy;
+    std::vector<double> syu_re;
+    std::vector<double> syu_im;
+};
+
+// removes the mean and applies the window
+static void
+prepare(const float *x, const float *window, int n, float *re, float *im)
+{
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += x[i];
+    }
+    float mean = (float)(sum/n);
+    for (int i = 0; i < n; i++)
+    {
+        re[i] = (x[i] - mean)*window[i];
+        im[i] = 0;
+    }
+}
+
+static void*
+welch_worker(void *args)
+{
+    Welch_Job *job = (Welch_Job *)args;
+    const Fft_Plan &plan = *job->plan;
+    const int n    = plan.n;
+    const int bins = n/2 + 1;
+
+    std::vector<float> ur(n), ui(n), yr(n), yi(n);
+
+    for (int s = job->first; s < job->last; s++)
+    {
+        prepare(job->u + s*job->step, &plan.window[0], n, &ur[0], &ui[0]);
+        prepare(job->y + s*job->step, &plan.window[0], n, &yr[0], &yi[0]);
+        fft(plan, &ur[0], &ui[0]);
+        fft(plan, &yr[0], &yi[0]);
+
+        for (int k = 0; k < bins; k++)
+        {
+            job->suu[k]    += ur[k]*ur[k] + ui[k]*ui[k];
+            job->syy[k]    += yr[k]*yr[k] + yi[k]*yi[k];
+            job->syu_re[k] += yr[k]*ur[k] + yi[k]*ui[k]; // Y*conj(U)
+            job->syu_im[k] += yi[k]*ur[k] - yr[k]*ui[k];
+        }
+    }
+    return NULL;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Frequency Response
+// ------------------------------------------------------------------------------
+std::vector<Bode_Point>
+frequency_response(const std::vector<float> &u, const std::vector<float> &y, double rate, int threads)
+{
+    std::vector<Bode_Point> result;
+    int len = (int)std::min(u.size(), y.size());
+
+    // largest power of two up to a quarter of the capture (some averaging)
+    int n = BODE_MIN_SEGMENT;
+    while (2*n <= len/4 && 2*n <= BODE_MAX_SEGMENT)
+    {
+        n *= 2;
+    }
+    if (len < n)
+    {
+        return result;
+    }
+
+    const int step     = n/2;
+    const int segments = (len - n)/step + 1;
+    const int bins     = n/2 + 1;
+
+    if (threads <= 0)
+    {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    threads = std::max(1, std::min(threads, segments));
+
+    Fft_Plan plan(n);
+
+    std::vector<Welch_Job> jobs(threads);
+    std::vector<pthread_t> tids(threads);
+    std::vector<bool>      spawned(threads, false);
+    for (int t = 0; t < threads; t++)
+    {
+        Welch_Job &job = jobs[t];
+        job.plan  = &plan;
+        job.u     = &u[0];
+        job.y     = &y[0];
+        job.first = segments*t/threads;
+        job.last  = segments*(t + 1)/threads;
+        job.step  = step;
+        job.suu.assign(bins, 0);
+        job.syy.assign(bins, 0);
+        job.syu_re.assign(bins, 0);
+        job.syu_im.assign(bins, 0);
+
+        // the first chunk runs on the calling thread
+        if (t > 0)
+        {
+            spawned[t] = (0 == pthread_create(&tids[t], NULL, &welch_worker, &job));
+        }
+    }
+    welch_worker(&jobs[0]);
+    for (int t = 1; t < threads; t++)
+    {
+        if (spawned[t])
+        {
+            pthread_join(tids[t], NULL);
+        }
+        else
+        {
+            welch_worker(&jobs[t]);
+        }
+    }
+
+    // reduce
+    Welch_Job &total = jobs[0];
+    for (int t = 1; t < threads; t++)
+    {
+        for (int k = 0; k < bins; k++)
+        {
+            total.suu[k]    += jobs[t].suu[k];
+            total.syy[k]    += jobs[t].syy[k];
+            total.syu_re[k] += jobs[t].syu_re[k];
+            total.syu_im[k] += jobs[t].syu_im[k];
+        }
+    }
+
+    double peak = 0;
+    for (int k = 1; k < bins; k++)
+    {
+        peak = std::max(peak, total.suu[k]);
+    }
+
+    // bin 0 is gone with the mean; phase unwrapped over the kept bins
+    double last_phase = 0;
+    bool   has_last   = false;
+    for (int k = 1; k < bins; k++)
+    {
+        double suu = total.suu[k];
+        double syy = total.syy[k];
+        double re  = total.syu_re[k];
+        double im  = total.syu_im[k];
+        if (suu <= BODE_MIN_POWER*peak || syy <= 0)
+        {
+            continue;
+        }
+
+        double coherence = (re*re + im*im)/(suu*syy);
+        if (coherence < BODE_COHERENCE)
+        {
+            continue;
+        }
+
+        double phase = atan2(im, re);
+        if (has_last)
+        {
+            phase -= 2*M_PI*floor((phase - last_phase)/(2*M_PI) + 0.5);
+        }
+        last_phase = phase;
+        has_last   = true;
+
+        Bode_Point p;
+        p.freq         = k*rate/n;
+        p.magnitude_db = 10*log10((re*re + im*im)/(suu*suu));
+        p.phase_deg    = phase*180/M_PI;
+        p.coherence    = coherence;
+        result.push_back(p);
+    }
+    return result;
+}
+
+void
+plant_response(double freq, double &magnitude_db, double &phase_deg)
+{
+    double w  = 2*M_PI*freq;
+    double re = 1 - PLANT_A2*w*w;
+    double im = PLANT_A1*w;
+    magnitude_db = 20*log10(PLANT_GAIN/sqrt(re*re + im*im));
+    phase_deg    = (-atan2(im, re) - PLANT_DELAY*w)*180/M_PI;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Load Capture
+// ------------------------------------------------------------------------------
+bool
+load_capture(const char *path, Capture &capture)
+{
+    capture.rate = 1/TELEMETRY_TICK_PERIOD;
+    capture.rpm.clear();
+    capture.setpoint.clear();
+    capture.pulse.clear();
+
+    long   last  = -1;
+    float  rpm_last = 0, setpoint_last = 0, pulse_last = 0;
+    auto add = [&](float rpm, float setpoint, float pulse, double time){
+        long slot = lround(time/TELEMETRY_TICK_PERIOD);
+        if (last < 0)
+        {
+            last = slot;
+            capture.rpm.push_back(rpm);
+            capture.setpoint.push_back(setpoint);
+            capture.pulse.push_back(pulse);
+            rpm_last = rpm; setpoint_last = setpoint; pulse_last = pulse;
+            return;
+        }
+        if (slot <= last)
+        {
+            return;
+        }
+
+        // lost lines: straight line between the samples around the gap
+        for (long s = last + 1; s <= slot; s++)
+        {
+            float a = (float)(s - last)/(slot - last);
+            capture.rpm.push_back(rpm_last + a*(rpm - rpm_last));
+            capture.setpoint.push_back(setpoint_last + a*(setpoint - setpoint_last));
+            capture.pulse.push_back(pulse_last + a*(pulse - pulse_last));
+        }
+        last = slot;
+        rpm_last = rpm; setpoint_last = setpoint; pulse_last = pulse;
+    };
+
+    if (Archive_Reader::is_archive(path))
+    {
+        Archive_Reader reader;
+        std::vector<Telemetry_Sample> samples;
+        if (!reader.open(path) || !reader.read_all(samples, 0))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            add(samples[i].rpm, samples[i].setpoint, samples[i].pulse, samples[i].time);
+        }
+    }
+    else
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            perror(path);
+            return false;
+        }
+
+        char line[256];
+        while (fgets(line, sizeof(line), file))
+        {
+            if (line[0] == '#')
+            {
+                continue; // header and firmware messages
+            }
+
+            float  rpm, setpoint, pulse;
+            double time;
+            if (4 == sscanf(line, "%*s %*s %f %f %f %lf", &rpm, &setpoint, &pulse, &time))
+            {
+                add(rpm, setpoint, pulse, time);
+            }
+        }
+        fclose(file);
+    }
+
+    if (capture.rpm.empty())
+    {
+        fprintf(stderr, "%s: no samples\n", path);
+        return false;
+    }
+    return true;
+}
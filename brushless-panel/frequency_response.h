@@ -0,0 +1,65 @@
+#ifndef FREQUENCY_RESPONSE_H_
+#define FREQUENCY_RESPONSE_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <vector>
+#include "plant_model.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define BODE_MIN_SEGMENT 256   // samples per FFT segment (2.56s at 100Hz)
+#define BODE_MAX_SEGMENT 4096
+#define BODE_COHERENCE   0.6   // bins below this coherence are dropped
+#define BODE_MIN_POWER   1e-4  // and bins with less input power, relative to the peak
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+struct Bode_Point
+{
+    double freq;         // Hz
+    double magnitude_db; // 20 log10 |Y/U|
+    double phase_deg;    // unwrapped
+    double coherence;    // 0..1
+};
+
+// a recording resampled on the firmware time base
+struct Capture
+{
+    double             rate; // Hz
+    std::vector<float> rpm;
+    std::vector<float> setpoint;
+    std::vector<float> pulse;
+};
+
+// ------------------------------------------------------------------------------
+//   Functions
+// ------------------------------------------------------------------------------
+/*
+ * load_capture reads a Recorder file (see recorder.h), text or archive,
+ * onto the firmware time base: one value per tick, gaps from lost lines
+ * interpolated.
+ *
+ * frequency_response estimates y/u with Welch's method: Hann windowed
+ * segments with 50% overlap, H = Syu/Suu and the coherence
+ * |Syu|^2/(Suu*Syy) per bin. The segments are split among threads
+ * (0: one per CPU). Empty when u is too short for one segment.
+ *
+ * plant_response evaluates the nominal plant (plant_model.h), rpm/us.
+ */
+
+bool load_capture(const char *path, Capture &capture);
+
+std::vector<Bode_Point> frequency_response(const std::vector<float> &u, const std::vector<float> &y,
+                                           double rate, int threads);
+
+void plant_response(double freq, double &magnitude_db, double &phase_deg);
+
+
+#endif // FREQUENCY_RESPONSE_H_
@@ -0,0 +1,277 @@
+// Brushless panel without SDL/GL: captures the telemetry, records it, sends
+// a set-point profile and prints statistics on stdout.
+//
+// usage: brushless_headless.run [-p port] [-b baud] [-r record.tsv]
+//                               [-s profile] [-l sent.tsv] [-t seconds]
+//                               [-i interval] [-a] [-T trace.json]
+//                               [-P address] [-C address]
+//       brushless_headless.run -A record.tsv
+//      -p: serial port (/dev/ttyUSB0)
+//      -b: baudrate (230400)
+//      -r: records every sample (see recorder.h), compressed when the name
+//          ends in .bla (see archive.h)
+//      -s: set-point profile (see profile_runner.h), started with the port
+//      -l: writes the scheduled and actual send times of the profile
+//      -t: stops after this many seconds (0: until SIGINT/SIGTERM)
+//      -i: statistics interval, in seconds (1)
+//      -a: sends the retuning "gN" when the identified plant gain drifts
+//      -T: traces the read path and writes a Chrome trace on exit (trace.h)
+//      -P: streams the samples to local subscribers, "unix:/path" or
+//          "tcp:port" (see telemetry_server.h)
+//      -C: takes set-points and parameters from local clients, same
+//          addresses (see command_server.h)
+//      -A: compresses an earlier text recording to record.bla and exits
+//
+// stdout, tab separated:
+//      stats  t samples dropped drop_pct overruns jitter_rms_ms jitter_max_ms rpm setpoint pulse
+//      sent   t scheduled error_us line
+//      msg    t firmware message (and "*** link lost/back ... ***" when the
+//             port goes away and comes back, see brushless_serial.h)
+//      ident  t valid gain drift_pct s1_re s1_im s2_re s2_im error_rms retune_gain
+//      drift  t gain drift_pct retune_gain (see system_id.h)
+//      trace  stage count p50_us p90_us p99_us max_us (on exit, with -T)
+//      server t slot sent dropped queued (each subscriber, with -P)
+//      commands t queued sent acked invalid coalesced timeouts ack_p50_ms ack_p99_ms ack_max_ms
+//      live   t mean stddev snr_db tracking_rms overshoot_pct rise_s settling_s noise_density
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include "serial_port.h"
+#include "brushless_serial.h"
+#include "recorder.h"
+#include "archive.h"
+#include "profile_runner.h"
+#include "system_id.h"
+#include "live_stats.h"
+#include "telemetry_server.h"
+#include "command_server.h"
+#include "trace.h"
+
+static volatile sig_atomic_t quit = 0;
+
+static void handle_signal(int sig){
+    (void)sig;
+    quit = 1;
+}
+
+static void sleep_for(double seconds);
+
+int main(int argc, char *argv[]){
+    const char *port = "/dev/ttyUSB0";
+    int baud = 230400;
+    const char *record_path = NULL;
+    const char *profile_path = NULL;
+    const char *sent_path = NULL;
+    double duration = 0;
+    double interval = 1;
+    bool auto_retune = false;
+    const char *trace_path = NULL;
+    const char *server_address = NULL;
+    const char *command_address = NULL;
+    const char *convert_path = NULL;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "p:b:r:s:l:t:i:aT:P:C:A:"))){
+        switch(opt){
+            case 'p': port = optarg; break;
+            case 'b': baud = atoi(optarg); break;
+            case 'r': record_path = optarg; break;
+            case 's': profile_path = optarg; break;
+            case 'l': sent_path = optarg; break;
+            case 't': duration = atof(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 'a': auto_retune = true; break;
+            case 'T': trace_path = optarg; break;
+            case 'P': server_address = optarg; break;
+            case 'C': command_address = optarg; break;
+            case 'A': convert_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-b baud] [-r record.tsv] [-s profile] [-l sent.tsv] [-t seconds] [-i interval] [-a] [-T trace.json] [-P address] [-C address]\n"
+                                "       %s -A record.tsv\n", argv[0], argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(interval <= 0){
+        interval = 1;
+    }
+
+    if(convert_path){
+        std::string out = convert_path;
+        size_t dot = out.rfind('.');
+        if(dot != std::string::npos && out.find('/', dot) == std::string::npos){
+            out.erase(dot);
+        }
+        out += ARCHIVE_EXTENSION;
+        if(out == convert_path){
+            fprintf(stderr, "%s is already an archive\n", convert_path);
+            return EXIT_FAILURE;
+        }
+        return archive_convert(convert_path, out.c_str(), 0) ? 0 : EXIT_FAILURE;
+    }
+
+    if(trace_path){
+        trace_enable(true);
+    }
+
+    Profile_Runner profile;
+    if(profile_path && !profile.load(profile_path)){
+        return EXIT_FAILURE;
+    }
+
+    Recorder recorder;
+    if(record_path && !recorder.open(record_path)){
+        return EXIT_FAILURE;
+    }
+
+    Serial_Port serial_port(port, baud);
+    try {
+        serial_port.start();
+    }
+    catch (int error){
+        fprintf(stderr, "waiting for %s\n", port); // the read thread reconnects
+    }
+
+    BrushlessSerial b_serial(&serial_port);
+    if(recorder.is_open()){
+        b_serial.set_recorder(&recorder);
+    }
+
+    const double start = Telemetry::now();
+
+    // the drift line is printed from the read thread, like the retuning
+    System_Id identifier;
+    identifier.on_drift = [&b_serial, auto_retune, start](const Identification &id){
+        printf("drift\t%.3f\t%.2f\t%.1f\t%d\n", Telemetry::now() - start, id.gain, 100*id.drift, id.retune_gain);
+        if(auto_retune){
+            b_serial.command("g" + std::to_string(id.retune_gain));
+        }
+    };
+    b_serial.set_identifier(&identifier);
+
+    Live_Stats live_stats;
+    b_serial.set_live_stats(&live_stats);
+
+    Telemetry_Server server;
+    if(server_address){
+        if(!server.start(server_address)){
+            return EXIT_FAILURE;
+        }
+        b_serial.set_server(&server);
+    }
+
+    Command_Server command_server(&b_serial.commands);
+    if(command_address && !command_server.start(command_address)){
+        return EXIT_FAILURE;
+    }
+    b_serial.start();
+
+    if(profile_path){
+        profile.start([&b_serial](const std::string &line){ return b_serial.write_message(line); });
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    double next_stats = interval;
+    std::vector<std::string> messages;
+    std::vector<Profile_Sent> sent;
+    std::vector<Subscriber_Stats> subscribers;
+
+    while(not quit){
+        double t = Telemetry::now() - start;
+        if(duration > 0 && t >= duration){
+            break;
+        }
+
+        profile.take_sent(sent);
+        for(size_t i = 0; i < sent.size(); i++){
+            printf("sent\t%.3f\t%.3f\t%.1f\t%s\n", t, sent[i].scheduled,
+                   1e6*(sent[i].actual - sent[i].scheduled), sent[i].line.c_str());
+        }
+
+        b_serial.take_messages(messages);
+        for(size_t i = 0; i < messages.size(); i++){
+            printf("msg\t%.3f\t%s\n", t, messages[i].c_str());
+        }
+
+        if(t >= next_stats){
+            Telemetry stats = b_serial.telemetry_stats();
+            Telemetry_Sample sample;
+            b_serial.last_sample(sample);
+            printf("stats\t%.3f\t%u\t%u\t%.3f\t%u\t%.2f\t%.2f\t%d\t%d\t%d\n",
+                   t, stats.received, stats.dropped, 100*stats.drop_rate(), stats.overruns,
+                   1e3*stats.jitter_rms(), 1e3*stats.jitter_max(),
+                   sample.rpm, sample.setpoint, sample.pulse);
+            Identification id = identifier.estimate();
+            printf("ident\t%.3f\t%d\t%.2f\t%.1f\t%.2f\t%.2f\t%.2f\t%.2f\t%.1f\t%d\n",
+                   t, id.valid, id.gain, 100*id.drift, id.s_re[0], id.s_im[0], id.s_re[1], id.s_im[1],
+                   id.error_rms, id.retune_gain);
+            Live_Snapshot live;
+            live_stats.snapshot(live);
+            printf("live\t%.3f\t%.1f\t%.2f\t%.1f\t%.2f\t%.1f\t%.3f\t%.3f\t%.3f\n",
+                   t, live.mean, live.stddev, live.snr_db, live.tracking_rms, live.step.overshoot,
+                   live.step.rise_time, live.step.settling_time, live.noise_density);
+            Command_Stats commands = b_serial.commands.stats();
+            if(commands.queued > 0){
+                printf("commands\t%.3f\t%u\t%u\t%u\t%u\t%u\t%u\t%.2f\t%.2f\t%.2f\n", t, commands.queued,
+                       commands.sent, commands.acked, commands.invalid, commands.coalesced, commands.timeouts,
+                       1e3*commands.p50, 1e3*commands.p99, 1e3*commands.max);
+            }
+            server.subscribers(subscribers);
+            for(size_t i = 0; i < subscribers.size(); i++){
+                printf("server\t%.3f\t%d\t%u\t%u\t%u\n", t, subscribers[i].slot,
+                       subscribers[i].sent, subscribers[i].dropped, subscribers[i].queued);
+            }
+            next_stats += interval;
+        }
+        fflush(stdout);
+
+        // sleep until the next stats line (50ms at most, to drain firmware
+        // messages and notice signals); the profile has its own thread
+        double wake = next_stats;
+        if(duration > 0 && duration < wake){
+            wake = duration;
+        }
+        double dt = wake - (Telemetry::now() - start);
+        sleep_for((dt < 0.05) ? dt : 0.05);
+    }
+
+    profile.stop();
+    if(sent_path){
+        profile.write_log(sent_path);
+    }
+    b_serial.handle_quit();
+    server.stop();
+    command_server.stop();
+    recorder.close();
+    serial_port.handle_quit();
+
+    if(trace_path){
+        trace_export(trace_path);
+        std::vector<Trace_Stage> stages;
+        trace_stages(stages);
+        for(size_t i = 0; i < stages.size(); i++){
+            printf("trace\t%s\t%u\t%.1f\t%.1f\t%.1f\t%.1f\n", stages[i].name, stages[i].count,
+                   stages[i].p50, stages[i].p90, stages[i].p99, stages[i].max);
+        }
+    }
+
+    return 0;
+}
+
+static void sleep_for(double seconds){
+    if(seconds <= 0){
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)(1e9*(seconds - ts.tv_sec));
+    nanosleep(&ts, NULL);
+}
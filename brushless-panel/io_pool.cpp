@@ -0,0 +1,289 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "io_pool.h"
+#include "brushless_serial.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Io_Pool::
+Io_Pool(int threads)
+{
+    for (int i = 0; i < std::max(1, threads); i++)
+    {
+        Worker *worker = new Worker();
+        worker->pool     = this;
+        worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        worker->wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        worker->quit.store(false);
+        pthread_mutex_init(&worker->lock, NULL);
+
+        struct epoll_event event;
+        event.events   = EPOLLIN;
+        event.data.ptr = NULL; // the wake eventfd
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wake_fd, &event);
+
+        if (pthread_create(&worker->tid, NULL, &Io_Pool::start_worker, worker))
+        {
+            fprintf(stderr, "io pool: could not start a worker\n");
+            close(worker->epoll_fd);
+            close(worker->wake_fd);
+            pthread_mutex_destroy(&worker->lock);
+            delete worker;
+            continue;
+        }
+        workers.push_back(worker);
+    }
+}
+
+// the ports must have been removed (BrushlessSerial::stop)
+Io_Pool::
+~Io_Pool()
+{
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        Worker *worker = workers[i];
+        worker->quit.store(true);
+        uint64_t one = 1;
+        ssize_t written = write(worker->wake_fd, &one, sizeof(one));
+        (void)written;
+        pthread_join(worker->tid, NULL);
+
+        close(worker->epoll_fd);
+        close(worker->wake_fd);
+        pthread_mutex_destroy(&worker->lock);
+        delete worker;
+    }
+}
+
+int
+Io_Pool::
+threads() const
+{
+    return (int)workers.size();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Ports
+// ------------------------------------------------------------------------------
+void
+Io_Pool::
+add(BrushlessSerial *port)
+{
+    if (workers.empty())
+    {
+        return;
+    }
+
+    // the least loaded worker
+    Worker *worker = NULL;
+    size_t  fewest = 0;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        pthread_mutex_lock(&workers[i]->lock);
+        size_t count = workers[i]->ports.size();
+        pthread_mutex_unlock(&workers[i]->lock);
+        if (!worker || count < fewest)
+        {
+            worker = workers[i];
+            fewest = count;
+        }
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->ports.push_back(port);
+    if (port->serial_port->status != SERIAL_PORT_OPEN || !watch(worker, port))
+    {
+        Retry retry;
+        retry.port    = port;
+        retry.when    = 0;
+        retry.backoff = RECONNECT_MIN_MS;
+        worker->retries.push_back(retry);
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    // recompute the epoll timeout
+    uint64_t one = 1;
+    ssize_t written = write(worker->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+void
+Io_Pool::
+remove(BrushlessSerial *port)
+{
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        Worker *worker = workers[i];
+        pthread_mutex_lock(&worker->lock);
+        if (owns(worker, port))
+        {
+            int fd = port->serial_port->file_descriptor();
+            if (fd >= 0)
+            {
+                epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            }
+            worker->ports.erase(std::find(worker->ports.begin(), worker->ports.end(), port));
+            for (size_t r = 0; r < worker->retries.size(); r++)
+            {
+                if (worker->retries[r].port == port)
+                {
+                    worker->retries.erase(worker->retries.begin() + r);
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&worker->lock);
+            return;
+        }
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+// worker lock held
+bool
+Io_Pool::
+owns(Worker *worker, BrushlessSerial *port)
+{
+    return std::find(worker->ports.begin(), worker->ports.end(), port) != worker->ports.end();
+}
+
+bool
+Io_Pool::
+watch(Worker *worker, BrushlessSerial *port)
+{
+    struct epoll_event event;
+    event.events   = EPOLLIN;
+    event.data.ptr = port;
+    return epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, port->serial_port->file_descriptor(), &event) == 0;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Worker
+// ------------------------------------------------------------------------------
+void*
+Io_Pool::
+start_worker(void *args)
+{
+    Worker *worker = (Worker*)args;
+    worker->pool->run(worker);
+    return NULL;
+}
+
+void
+Io_Pool::
+run(Worker *worker)
+{
+    trace_thread_name("io pool");
+
+    struct epoll_event events[IO_POOL_EVENTS];
+    while (!worker->quit.load())
+    {
+        pthread_mutex_lock(&worker->lock);
+        int timeout = next_timeout(worker);
+        pthread_mutex_unlock(&worker->lock);
+
+        int n = epoll_wait(worker->epoll_fd, events, IO_POOL_EVENTS, timeout);
+
+        pthread_mutex_lock(&worker->lock);
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                uint64_t count;
+                ssize_t drained = read(worker->wake_fd, &count, sizeof(count));
+                (void)drained;
+                continue;
+            }
+
+            BrushlessSerial *port = (BrushlessSerial*)events[i].data.ptr;
+            if (!owns(worker, port))
+            {
+                continue; // removed after epoll_wait returned
+            }
+            int result = (events[i].events & EPOLLIN) ? port->read_ready() : 0;
+            if (result < 0 || (events[i].events & (EPOLLERR | EPOLLHUP)))
+            {
+                failed(worker, port);
+            }
+        }
+        retry(worker);
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+// worker lock held
+void
+Io_Pool::
+failed(Worker *worker, BrushlessSerial *port)
+{
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, port->serial_port->file_descriptor(), NULL);
+    port->link_lost();
+    if (!port->auto_reconnect)
+    {
+        return; // stays closed until stop()/start()
+    }
+
+    Retry retry;
+    retry.port    = port;
+    retry.when    = Telemetry::now() + 1e-3*RECONNECT_MIN_MS;
+    retry.backoff = RECONNECT_MIN_MS;
+    worker->retries.push_back(retry);
+    port->set_retry(retry.backoff);
+}
+
+// worker lock held
+void
+Io_Pool::
+retry(Worker *worker)
+{
+    double now = Telemetry::now();
+    for (size_t i = 0; i < worker->retries.size(); )
+    {
+        Retry &retry = worker->retries[i];
+        if (retry.when > now)
+        {
+            i++;
+            continue;
+        }
+        if (retry.port->serial_port->try_open() && watch(worker, retry.port))
+        {
+            retry.port->reopened(0);
+            worker->retries.erase(worker->retries.begin() + i);
+            continue;
+        }
+        retry.backoff = std::min(2*retry.backoff, RECONNECT_MAX_MS);
+        retry.when    = now + 1e-3*retry.backoff;
+        retry.port->set_retry(retry.backoff);
+        i++;
+    }
+}
+
+// worker lock held; ms until the next retry is due (-1: none)
+int
+Io_Pool::
+next_timeout(Worker *worker)
+{
+    if (worker->retries.empty())
+    {
+        return -1;
+    }
+    double now  = Telemetry::now();
+    double next = worker->retries[0].when;
+    for (size_t i = 1; i < worker->retries.size(); i++)
+    {
+        next = std::min(next, worker->retries[i].when);
+    }
+    return std::max(0, (int)(1e3*(next - now) + 1));
+}
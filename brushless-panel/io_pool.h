@@ -0,0 +1,87 @@
+#ifndef IO_POOL_H_
+#define IO_POOL_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+class BrushlessSerial;
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define IO_POOL_THREADS 2    // enough for 16 motors at 100 Hz, see bench.cpp
+#define IO_POOL_EVENTS  32   // epoll events taken per wait
+
+
+// ----------------------------------------------------------------------------------
+//   Io Pool Class
+// ----------------------------------------------------------------------------------
+/*
+ * Io Pool Class
+ *
+ * Reads many ports on a few threads. Each worker waits in epoll on its
+ * ports and, when one is readable, takes everything it has in one read
+ * and hands the lines to its BrushlessSerial (parse, plot ring, recorder,
+ * stats), so a port is always handled by the same thread and the per
+ * motor consumers stay single threaded. Ports are spread over the
+ * workers by count.
+ *
+ * A port that fails is closed and retried by its worker with the same
+ * backoff as the read thread (RECONNECT_MIN_MS..RECONNECT_MAX_MS), without
+ * the inotify wait. BrushlessSerial::start(pool)/stop() call add() and
+ * remove(); once remove() returns the worker no longer touches the port.
+ */
+class Io_Pool
+{
+
+public:
+
+    Io_Pool(int threads = IO_POOL_THREADS);
+    ~Io_Pool();
+
+    void add(BrushlessSerial *port);
+    void remove(BrushlessSerial *port);
+
+    int  threads() const;
+
+private:
+
+    struct Retry
+    {
+        BrushlessSerial *port;
+        double           when;
+        int              backoff; // ms
+    };
+
+    struct Worker
+    {
+        Io_Pool         *pool;
+        pthread_t        tid;
+        int              epoll_fd;
+        int              wake_fd;  // eventfd: quit, or the retries changed
+        pthread_mutex_t  lock;     // held while handling ports
+        std::vector<BrushlessSerial*> ports;
+        std::vector<Retry> retries;
+        std::atomic<bool> quit;
+    };
+
+    std::vector<Worker*> workers;
+
+    static void* start_worker(void *args);
+    void run(Worker *worker);
+    bool watch(Worker *worker, BrushlessSerial *port);
+    void failed(Worker *worker, BrushlessSerial *port);
+    void retry(Worker *worker);
+    int  next_timeout(Worker *worker);
+    bool owns(Worker *worker, BrushlessSerial *port);
+
+};
+
+
+#endif // IO_POOL_H_
@@ -0,0 +1,252 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "live_stats.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#define SHARED_NEW 4 // "new" bit of the shared index
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Live_Stats::
+Live_Stats()
+{
+    for (int k = 0; k <= LIVE_DFT/2; k++)
+    {
+        twiddle_re[k] = cos(2*M_PI*k/LIVE_DFT);
+        twiddle_im[k] = sin(2*M_PI*k/LIVE_DFT);
+    }
+    damping_n = pow(LIVE_DFT_DAMPING, LIVE_DFT);
+
+    memset(buffers, 0, sizeof(buffers));
+    write_index = 0;
+    shared.store(1);
+    read_index  = 2;
+    reset_pending.store(false);
+    clear();
+}
+
+// the next update() starts over (safe while the read thread runs)
+void
+Live_Stats::
+reset()
+{
+    reset_pending.store(true);
+}
+
+void
+Live_Stats::
+clear()
+{
+    memset(rpm_ring, 0, sizeof(rpm_ring));
+    memset(err2_ring, 0, sizeof(err2_ring));
+    head     = 0;
+    count    = 0;
+    mean     = 0;
+    m2       = 0;
+    err2_sum = 0;
+
+    memset(dft_ring, 0, sizeof(dft_ring));
+    memset(dft_re, 0, sizeof(dft_re));
+    memset(dft_im, 0, sizeof(dft_im));
+    dft_head = 0;
+
+    last_setpoint = 0;
+    memset(&step, 0, sizeof(step));
+    step.rise_time     = -1;
+    step.settling_time = -1;
+    step.done          = true;
+    band_since = -1;
+    peak       = 0;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Update
+// ------------------------------------------------------------------------------
+void
+Live_Stats::
+update(const Telemetry_Sample &sample)
+{
+    if (reset_pending.exchange(false))
+    {
+        clear();
+    }
+
+    const double x = sample.rpm;
+
+    // windowed Welford: add x, and drop the value leaving the window
+    if (count < LIVE_WINDOW)
+    {
+        count++;
+        double delta = x - mean;
+        mean += delta/count;
+        m2   += delta*(x - mean);
+    }
+    else
+    {
+        double old      = rpm_ring[head];
+        double old_mean = mean;
+        mean += (x - old)/LIVE_WINDOW;
+        m2   += (x - old)*(x - mean + old - old_mean);
+        if (m2 < 0)
+        {
+            m2 = 0; // rounding
+        }
+    }
+    rpm_ring[head] = x;
+
+    // tracking error, closed loop only (set-point is 0 in WRITE mode)
+    double err2 = 0;
+    if (sample.setpoint > 0)
+    {
+        double e = sample.setpoint - x;
+        err2 = e*e;
+    }
+    err2_sum += err2 - err2_ring[head];
+    if (err2_sum < 0)
+    {
+        err2_sum = 0;
+    }
+    err2_ring[head] = err2;
+    head = (head + 1) % LIVE_WINDOW;
+
+    // sliding DFT of d = x - mean: X_k = e^(j2pik/N)*(r*X_k + d - r^N*d[n-N]).
+    // Without the mean the damping would leak the DC into every bin
+    double d = x - mean;
+    double leaving = dft_ring[dft_head];
+    dft_ring[dft_head] = d;
+    dft_head = (dft_head + 1) % LIVE_DFT;
+    double input = d - damping_n*leaving;
+    for (int k = 0; k <= LIVE_DFT/2; k++)
+    {
+        double re = LIVE_DFT_DAMPING*dft_re[k] + input;
+        double im = LIVE_DFT_DAMPING*dft_im[k];
+        dft_re[k] = re*twiddle_re[k] - im*twiddle_im[k];
+        dft_im[k] = re*twiddle_im[k] + im*twiddle_re[k];
+    }
+
+    update_step(sample);
+    publish(sample);
+}
+
+// overshoot, rise and settling of the response to each set-point change
+void
+Live_Stats::
+update_step(const Telemetry_Sample &sample)
+{
+    const int rpm = sample.rpm;
+
+    if (sample.setpoint > 0 && abs(sample.setpoint - last_setpoint) >= LIVE_STEP_MIN)
+    {
+        step.start         = sample.time;
+        step.from          = rpm;
+        step.to            = sample.setpoint;
+        step.overshoot     = 0;
+        step.rise_time     = -1;
+        step.settling_time = -1;
+        step.done          = false;
+        band_since = -1;
+        peak       = rpm;
+    }
+    if (sample.setpoint > 0)
+    {
+        last_setpoint = sample.setpoint;
+    }
+    if (step.done || sample.setpoint != step.to)
+    {
+        return;
+    }
+
+    const double size = step.to - step.from;
+    const double progress = (rpm - step.from)/size; // 0 -> 1
+
+    if ((size > 0 && rpm > peak) || (size < 0 && rpm < peak))
+    {
+        peak = rpm;
+        step.overshoot = std::max(0.0, 100*(peak - step.to)/size);
+    }
+
+    // measured from the change, so the dead time is included
+    if (step.rise_time < 0 && progress >= 0.9)
+    {
+        step.rise_time = sample.time - step.start;
+    }
+
+    if (fabs(rpm - step.to) <= LIVE_SETTLE_BAND*fabs(size))
+    {
+        if (band_since < 0)
+        {
+            band_since = sample.time;
+        }
+        else if (sample.time - band_since >= LIVE_SETTLE_HOLD)
+        {
+            step.settling_time = band_since - step.start;
+            step.done = true;
+        }
+    }
+    else
+    {
+        band_since = -1;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Publish (triple buffer)
+// ------------------------------------------------------------------------------
+void
+Live_Stats::
+publish(const Telemetry_Sample &sample)
+{
+    Live_Snapshot &s = buffers[write_index];
+
+    s.seq     = sample.seq;
+    s.time    = sample.time;
+    s.mean    = mean;
+    s.stddev  = (count > 1) ? sqrt(m2/(count - 1)) : 0;
+    s.snr_db  = (s.stddev > 0) ? 20*log10(fabs(mean)/s.stddev) : 0;
+    s.tracking_rms = sqrt(err2_sum/count);
+    s.step    = step;
+
+    // one sided PSD of the rpm (bin 0 is the mean and is left out)
+    const double fs = 1/TELEMETRY_TICK_PERIOD;
+    double noise = 0;
+    int    bins  = 0;
+    s.psd[0] = 0;
+    for (int k = 1; k <= LIVE_DFT/2; k++)
+    {
+        double power = (dft_re[k]*dft_re[k] + dft_im[k]*dft_im[k])/(LIVE_DFT*fs);
+        s.psd[k] = (k < LIVE_DFT/2) ? 2*power : power;
+        if (k >= LIVE_DFT/4)
+        {
+            noise += s.psd[k];
+            bins++;
+        }
+    }
+    s.noise_density = sqrt(noise/bins);
+
+    // hand the filled buffer over, take the old shared one
+    write_index = shared.exchange(write_index | SHARED_NEW) & ~SHARED_NEW;
+}
+
+bool
+Live_Stats::
+snapshot(Live_Snapshot &out)
+{
+    if (!(shared.load() & SHARED_NEW))
+    {
+        out = buffers[read_index];
+        return false;
+    }
+    read_index = shared.exchange(read_index) & ~SHARED_NEW;
+    out = buffers[read_index];
+    return true;
+}
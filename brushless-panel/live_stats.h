@@ -0,0 +1,127 @@
+#ifndef LIVE_STATS_H_
+#define LIVE_STATS_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <atomic>
+#include "telemetry.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define LIVE_WINDOW       100   // samples (1s) for mean, variance and tracking error
+#define LIVE_DFT          64    // sliding DFT length (0.64s, 1.56Hz bins)
+#define LIVE_DFT_DAMPING  0.9999 // keeps the sliding DFT from accumulating rounding
+#define LIVE_STEP_MIN     50    // rpm, set-point change that starts a step
+#define LIVE_SETTLE_BAND  0.05  // fraction of the step
+#define LIVE_SETTLE_HOLD  0.5   // s inside the band to call it settled
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+struct Step_Response
+{
+    double start;        // firmware time of the set-point change
+    int    from;         // rpm when it changed
+    int    to;           // new set-point
+    double overshoot;    // % of the step, past the set-point
+    double rise_time;    // s until 90% of the step, dead time included (-1: not yet)
+    double settling_time;// s until it stayed in the band (-1: not yet)
+    bool   done;         // settled, or cut by the next step
+};
+
+struct Live_Snapshot
+{
+    uint32_t seq;         // last sample
+    double   time;
+
+    double   mean;        // rpm over the window
+    double   stddev;
+    double   snr_db;      // 20 log10(mean/stddev)
+    double   tracking_rms;// rpm, set-point - rpm over the window (closed loop)
+
+    Step_Response step;   // current or last step
+
+    double   psd[LIVE_DFT/2 + 1]; // rpm^2/Hz, one sided, of the rpm around the window mean
+    double   noise_density;       // rpm/sqrt(Hz), upper half of the band
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Live Stats Class
+// ----------------------------------------------------------------------------------
+/*
+ * Live Stats Class
+ *
+ * Statistics of the rpm stream updated per sample at a fixed cost: the
+ * windowed mean and variance use Welford's update with the value leaving
+ * the window, the tracking error keeps a running sum of squares, steps
+ * are followed with a few comparisons and the noise spectrum is a sliding
+ * DFT (LIVE_DFT/2 bins, independent of how long it runs).
+ *
+ * update() runs on the telemetry thread only. Each update publishes a
+ * Live_Snapshot through a triple buffer: the writer fills its own buffer
+ * and swaps it with the shared one, the reader swaps the shared one with
+ * its own when it is newer, so neither side waits or takes a lock.
+ * snapshot() must be called from a single thread (the UI).
+ */
+class Live_Stats
+{
+
+public:
+
+    Live_Stats();
+
+    void reset();
+    void update(const Telemetry_Sample &sample);
+
+    // copies the newest snapshot; false if nothing new since the last call
+    bool snapshot(Live_Snapshot &out);
+
+private:
+
+    // window (ring of the last LIVE_WINDOW samples)
+    double   rpm_ring[LIVE_WINDOW];
+    double   err2_ring[LIVE_WINDOW];
+    int      head;
+    uint32_t count;
+    double   mean;
+    double   m2;
+    double   err2_sum;
+
+    // sliding DFT
+    double   dft_ring[LIVE_DFT];
+    double   dft_re[LIVE_DFT/2 + 1];
+    double   dft_im[LIVE_DFT/2 + 1];
+    double   twiddle_re[LIVE_DFT/2 + 1];
+    double   twiddle_im[LIVE_DFT/2 + 1];
+    double   damping_n;   // LIVE_DFT_DAMPING^LIVE_DFT
+    int      dft_head;
+
+    // steps
+    int           last_setpoint;
+    Step_Response step;
+    double        band_since; // -1: outside the band
+    int           peak;
+
+    // triple buffer: [writer, shared, reader], the shared index carries a
+    // "new" bit
+    Live_Snapshot buffers[3];
+    int           write_index;
+    int           read_index;
+    std::atomic<int> shared;
+    std::atomic<bool> reset_pending;
+
+    void clear();
+    void update_step(const Telemetry_Sample &sample);
+    void publish(const Telemetry_Sample &sample);
+
+};
+
+
+#endif // LIVE_STATS_H_
@@ -0,0 +1,172 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "log_window.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Log_Window::
+Log_Window()
+{
+    clear();
+}
+
+void
+Log_Window::
+clear()
+{
+    first_id = 0;
+    next_id  = 0;
+    matches.clear();
+    scroll_to_bottom = true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Add Lines
+// ------------------------------------------------------------------------------
+void
+Log_Window::
+add_log(const char* fmt, ...)
+{
+    char buf[1024];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    // one slot per line
+    const char* start = buf;
+    const char* end;
+    while ((end = strchr(start, '\n')) != NULL)
+    {
+        push_line(start, (int)(end - start));
+        start = end + 1;
+    }
+    if (*start)
+    {
+        push_line(start, (int)strlen(start));
+    }
+}
+
+void
+Log_Window::
+push_line(const char* text, int len)
+{
+    // full ring: the new line takes the slot of the oldest one
+    if (next_id - first_id == LOG_LINES)
+    {
+        first_id++;
+        while (!matches.empty() && matches.front() < first_id)
+        {
+            matches.pop_front();
+        }
+    }
+
+    if (len > LOG_LINE_LEN - 1)
+    {
+        len = LOG_LINE_LEN - 1;
+    }
+
+    Line &slot = lines[next_id % LOG_LINES];
+    memcpy(slot.text, text, len);
+    slot.text[len] = '\0';
+
+    // incremental filter: only the new line is tested
+    if (filter.IsActive() && filter.PassFilter(slot.text))
+    {
+        matches.push_back(next_id);
+    }
+
+    next_id++;
+    scroll_to_bottom = true;
+}
+
+const char*
+Log_Window::
+line(uint32_t id) const
+{
+    return lines[id % LOG_LINES].text;
+}
+
+void
+Log_Window::
+refilter()
+{
+    matches.clear();
+    if (!filter.IsActive())
+    {
+        return;
+    }
+    for (uint32_t id = first_id; id != next_id; id++)
+    {
+        if (filter.PassFilter(line(id)))
+        {
+            matches.push_back(id);
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Draw
+// ------------------------------------------------------------------------------
+void
+Log_Window::
+draw(const char* title)
+{
+    ImGui::Begin(title);
+    if (ImGui::Button("clear"))
+    {
+        clear();
+    }
+    ImGui::SameLine();
+    bool copy = ImGui::Button("copy");
+    ImGui::SameLine();
+    if (filter.Draw("filter", -50.0f))
+    {
+        refilter();
+    }
+    ImGui::Separator();
+    ImGui::BeginChild("scrolling", ImVec2(0,0), false, ImGuiWindowFlags_HorizontalScrollbar);
+
+    // follow new lines only if the view is already at the bottom
+    bool at_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+
+    const bool filtered = filter.IsActive();
+    const int count = filtered ? (int)matches.size() : (int)(next_id - first_id);
+
+    // the clipboard gets every line, not only the visible ones
+    if (copy)
+    {
+        ImGui::LogToClipboard();
+        for (int i = 0; i < count; i++)
+        {
+            ImGui::LogText("%s\n", line(filtered ? matches[i] : first_id + i));
+        }
+        ImGui::LogFinish();
+    }
+
+    ImGuiListClipper clipper(count, ImGui::GetTextLineHeightWithSpacing());
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+    {
+        ImGui::TextUnformatted(line(filtered ? matches[i] : first_id + i));
+    }
+    clipper.End();
+
+    if (scroll_to_bottom && at_bottom)
+    {
+        ImGui::SetScrollHere(1.0f);
+    }
+    scroll_to_bottom = false;
+
+    ImGui::EndChild();
+    ImGui::End();
+}
@@ -0,0 +1,67 @@
+#ifndef LOG_WINDOW_H_
+#define LOG_WINDOW_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <deque>
+#include <imgui.h>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define LOG_LINES    4096 // ring slots (oldest lines are overwritten)
+#define LOG_LINE_LEN 128  // bytes per slot, longer lines are truncated
+
+
+// ----------------------------------------------------------------------------------
+//   Log Window Class
+// ----------------------------------------------------------------------------------
+/*
+ * Log Window Class
+ *
+ * Bounded log: lines live in a ring of LOG_LINES fixed-size slots, so
+ * memory is capped at LOG_LINES*LOG_LINE_LEN. Only the visible lines are
+ * submitted to ImGui (ImGuiListClipper). The filter keeps the ids of the
+ * matching lines; new lines are tested once when added and the full ring
+ * is only rescanned when the filter text changes.
+ */
+class Log_Window
+{
+
+public:
+
+    Log_Window();
+
+    void clear();
+    void add_log(const char* fmt, ...) IM_PRINTFARGS(2);
+    void draw(const char* title);
+
+private:
+
+    struct Line
+    {
+        char text[LOG_LINE_LEN];
+    };
+
+    Line     lines[LOG_LINES];
+    uint32_t first_id; // id of the oldest line in the ring
+    uint32_t next_id;  // id of the next line to be added
+
+    ImGuiTextFilter      filter;
+    std::deque<uint32_t> matches; // ids of the lines passing the filter
+
+    bool scroll_to_bottom;
+
+    void push_line(const char* text, int len);
+    const char* line(uint32_t id) const;
+    void refilter();
+
+};
+
+
+#endif // LOG_WINDOW_H_
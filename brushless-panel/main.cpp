@@ -1,212 +1,171 @@
 #include <stdint.h>
+#include <unistd.h>
 #include <vector>
+#include <functional>
 #include <pthread.h>
 #include <signal.h>
 #include "serial_port.h"
+#include "brushless_serial.h"
+#include "frame_scheduler.h"
+#include "log_window.h"
+#include "profile_runner.h"
+#include "bode_window.h"
+#include "motor_dashboard.h"
+#include "strip_plot.h"
+#include "system_id.h"
+#include "live_stats.h"
+#include "telemetry_server.h"
+#include "command_server.h"
+#include "trace.h"
 #include <imgui.h>
 #include "imgui_impl_sdl.h"
 #include <stdio.h>
+#include <math.h>
 #include <SDL.h>
 #include <SDL_opengl.h>
 #include <string>
+#include <algorithm>
 
 #define IM_ARRAYSIZE(_ARR)((int)(sizeof(_ARR)/sizeof(*_ARR)))
+#define PLOT_WINDOW 512 // slots in view after a reset (5.12 s), of the whole history
 
-#define VECTOR_LEN 512
+static void ShowLog(BrushlessSerial &b_serial, Profile_Runner &profile)
+{
+    static Log_Window log;
+
+    // profile lines, with the time they were actually written
+    std::vector<Profile_Sent> sent;
+    profile.take_sent(sent);
+    for(size_t i = 0; i < sent.size(); i++){
+        log.add_log("> %s  (t=%.3f s, %+.0f us)\n", sent[i].line.c_str(), sent[i].actual,
+                    1e6*(sent[i].actual - sent[i].scheduled));
+    }
 
-void* start_brushless_interface_read_thread(void *args);
-void* start_brushless_interface_write_thread(void *args);
+    // firmware messages ("*** idle 97.5% ***", "*** invalid ***", ...)
+    std::vector<std::string> messages;
+    b_serial.take_messages(messages);
+    for(size_t i = 0; i < messages.size(); i++){
+        log.add_log("%s\n", messages[i].c_str());
+    }
 
-class BrushlessSerial{
-public:
+    log.draw("Log");
+}
 
-    BrushlessSerial(Serial_Port *serial_port_){
-        serial_values.reserve(VECTOR_LEN);
-        dataReset();
-        serial_port = serial_port_;
-        time_to_exit   = false;
+// online plant estimate (system_id.h), fed by the read thread
+static void ShowIdentification(System_Id &identifier, BrushlessSerial &b_serial, bool serial_opened)
+{
+    static const int HISTORY = 240;   // gain history, 2 minutes
+    static float gain_history[HISTORY] = {0};
+    static int   history_index = 0;
+    static float history_time = 0;
+    static bool  auto_retune = false;
+    static bool  was_drifted = false;
+
+    Identification id = identifier.estimate();
+
+    if (ImGui::GetTime() - history_time >= 0.5f){
+        history_time = ImGui::GetTime();
+        gain_history[history_index] = id.valid ? (float)id.gain : 0;
+        history_index = (history_index + 1) % HISTORY;
     }
 
-    ~BrushlessSerial(){
-
+    ImGui::SetNextWindowSize(ImVec2(420, 300), ImGuiSetCond_FirstUseEver);
+    ImGui::Begin("Identification");
+
+    ImGui::Text("gain: %.2f rpm/us   nominal: %.3f   drift: %+.1f%%", id.gain, IDENT_NOMINAL_GAIN, 100*id.drift);
+    ImGui::Text("poles: %.2f%+.2fi  %.2f%+.2fi 1/s   nominal: %.3f  %.3f",
+                id.s_re[0], id.s_im[0], id.s_re[1], id.s_im[1], IDENT_NOMINAL_POLE1, IDENT_NOMINAL_POLE2);
+    ImGui::Text("z (%.0f ms): %.4f%+.4fi  %.4f%+.4fi", 1e3*IDENT_PERIOD,
+                id.pole_re[0], id.pole_im[0], id.pole_re[1], id.pole_im[1]);
+    ImGui::Text("prediction error: %.1f rpm rms   excitation: %.1f us", id.error_rms, id.excitation);
+
+    if (!id.valid){
+        ImGui::TextColored(ImVec4(0.6f,0.6f,0.6f,1.0f), "not enough data or excitation");
+    }else if (id.drifted){
+        ImGui::TextColored(ImVec4(1.0f,0.4f,0.2f,1.0f), "plant drifted: retune with g%d", id.retune_gain);
+    }else{
+        ImGui::TextColored(ImVec4(0.4f,1.0f,0.4f,1.0f), "within %.0f%% of the nominal gain", 100*IDENT_DRIFT);
     }
 
-    void read_messages(){
-        return;
+    bool retune = ImGui::Button("retune");
+    ImGui::SameLine();
+    ImGui::Checkbox("auto retune", &auto_retune);
+    if (auto_retune && id.drifted && !was_drifted){
+        retune = true;
     }
-    int write_message(int msg){
-        // do the write
-        int len = serial_port->write_message(std::to_string(msg));
-        // Done!
-        return len;
+    was_drifted = id.drifted;
+    if (retune && id.valid && serial_opened){
+        b_serial.command("g" + std::to_string(id.retune_gain));
     }
-
-    void start(){
-        if(not serial_port->status == 1){ // SERIAL_PORT_OPEN{
-            fprintf(stderr,"ERROR: serial port not open\n");
-            throw 1;
-        }
-        int result;
-        result = pthread_create( &read_tid, NULL, &start_brushless_interface_read_thread, this);
-        if (result) throw result;
-        result = pthread_create( &write_tid, NULL, &start_brushless_interface_write_thread, this);
-        if (result) throw result;
-        return;
+    ImGui::SameLine();
+    if (ImGui::Button("reset")){
+        identifier.reset();
     }
 
-    void stop(){
-        printf("CLOSE THREADS\n");
-        // signal exit
-        time_to_exit = true;
-        // wait for exit
-        pthread_join(read_tid , NULL);
-        pthread_join(write_tid, NULL);
-        // now the read and write threads are closed
-        printf("\n");
-        // still need to close the serial_port separately
-    }
+    ImGui::PlotLines("##gain", gain_history, HISTORY, history_index, "gain (rpm/us)", 0, 2*IDENT_NOMINAL_GAIN,
+                     ImVec2(0.95f*ImGui::GetWindowWidth(), 0.4f*ImGui::GetWindowHeight()));
 
-    void start_read_thread(){
-        if ( reading_status != 0 ){
-            fprintf(stderr,"read thread already running\n");
-            return;
-        }else{
-            read_thread();
-            return;
-        }
-    }
+    ImGui::End();
+}
 
-    void start_write_thread(){
-        if ( not writing_status == false ){
-            fprintf(stderr,"write thread already running\n");
-            return;
-        }else{
-            write_thread();
-            return;
-        }
-    }
+// per stage latency of the trace points (trace.h)
+static void ShowTrace()
+{
+    static bool enabled = false;
+    static std::vector<Trace_Stage> stages;
+    static float stages_time = -1;
 
-    void handle_quit(){
-        try {
-            stop();
-        }
-        catch (int error) {
-            fprintf(stderr,"Warning, could not stop autopilot interface\n");
-        }
-    }
+    ImGui::SetNextWindowSize(ImVec2(470, 220), ImGuiSetCond_FirstUseEver);
+    ImGui::Begin("Trace");
 
-    void dataReset(){
-        index = 0;
-        std::fill(serial_values.begin(), serial_values.end(), 0);
+    if (ImGui::Checkbox("tracing", &enabled)){
+        trace_enable(enabled);
     }
-    
-    uint16_t index;
-    std::vector<int16_t> serial_values;
-
-private:
-    void read_thread(){
-        reading_status = true;
-        while( not time_to_exit ){
-            read_messages();
-            // usleep(100000); // Read batches at 10Hz
-        }
-        reading_status = false;
-        return;
+    ImGui::SameLine();
+    if (ImGui::Button("export trace.json")){
+        trace_export("trace.json");
     }
 
-    void write_thread(){
-        return;
+    // sorting the rings is not free: once a second
+    if (enabled && ImGui::GetTime() - stages_time >= 1.0f){
+        stages_time = ImGui::GetTime();
+        trace_stages(stages);
     }
 
-    Serial_Port *serial_port;
-
-    char reading_status;
-    char writing_status;
-    bool time_to_exit;
-    
-    pthread_t read_tid;
-    pthread_t write_tid;
-    pthread_mutex_t lock;
-};
-
-void* start_brushless_interface_read_thread(void *args){
-    BrushlessSerial *brushless_interface = (BrushlessSerial *)args;
-    brushless_interface->start_read_thread();
-    return NULL;
-}
-
-void* start_brushless_interface_write_thread(void *args){
-    BrushlessSerial *brushless_interface = (BrushlessSerial *)args;
-    brushless_interface->start_write_thread();
-    return NULL;
-}
-
-struct ExampleAppLog{
-    ImGuiTextBuffer Buf;
-    ImGuiTextFilter Filter;
-    ImVector<int> LineOffsets; // Index to lines offset
-    bool ScrollToBottom;
-
-    void Clear() { Buf.clear(); LineOffsets.clear(); }
-
-    void AddLog(const char* fmt, ...) IM_PRINTFARGS(2){
-        int old_size = Buf.size();
-        va_list args;
-        va_start(args, fmt);
-        Buf.appendv(fmt, args);
-        va_end(args);
-        for (int new_size = Buf.size(); old_size < new_size; old_size++)
-            if (Buf[old_size] == '\n')
-                LineOffsets.push_back(old_size);
-        ScrollToBottom = true;
+    ImGui::Text("%-14s %7s %9s %9s %9s %9s", "stage (us)", "count", "p50", "p90", "p99", "max");
+    ImGui::Separator();
+    for (size_t i = 0; i < stages.size(); i++){
+        ImGui::Text("%-14s %7u %9.1f %9.1f %9.1f %9.1f", stages[i].name, stages[i].count,
+                    stages[i].p50, stages[i].p90, stages[i].p99, stages[i].max);
     }
 
-    void Draw(const char* title){
-        ImGui::Begin(title);
-        if(ImGui::Button("clear")){
-            Clear();
-        }
-        ImGui::SameLine();
-        bool copy = ImGui::Button("copy");
-        ImGui::Separator();
-        ImGui::BeginChild("scrolling", ImVec2(0,0), false, ImGuiWindowFlags_HorizontalScrollbar);
-        
-        if(copy){
-            ImGui::LogToClipboard();
-        }
+    ImGui::End();
+}
 
-        ImGui::TextUnformatted(Buf.begin());
+int main(int argc, char *argv[]){
+    int target_fps = FRAME_DEFAULT_FPS;
 
-        if(ScrollToBottom){
-            ImGui::SetScrollHere(1.0f);
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "f:"))){
+        switch(opt){
+            case 'f': target_fps = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-f max_fps]\n", argv[0]);
+                return EXIT_FAILURE;
         }
-
-        ScrollToBottom = false;
-
-        ImGui::EndChild();
-        ImGui::End();
     }
-};
 
-static void ShowExampleAppLog()
-{
-    static ExampleAppLog log;
-
-    // Demo fill
-    static float last_time = -1.0f;
-    float time = ImGui::GetTime();
-    if (time - last_time >= 0.3f){
-        const char* random_words[] = { "system", "info", "warning", "error", "fatal", "notice", "log" };
-        log.AddLog("[%s] Hello, time is %.1f, rand() %d\n", random_words[rand() % IM_ARRAYSIZE(random_words)], time, (int)rand());
-        last_time = time;
-    }
-
-    log.Draw("Log");
-}
-
-int main(int argc, char const *argv[]){
-    Serial_Port *serial_port;
-    BrushlessSerial b_serial(serial_port);
+    // b_serial is destroyed first: it stops its threads, then the port closes
+    Serial_Port serial_port;
+    BrushlessSerial b_serial(&serial_port);
+    Profile_Runner profile;
+    System_Id identifier;
+    b_serial.set_identifier(&identifier);
+    Live_Stats live_stats;
+    b_serial.set_live_stats(&live_stats);
+    Telemetry_Server server; // publishes nothing until someone subscribes
+    b_serial.set_server(&server);
+    Command_Server command_server(&b_serial.commands);
 
     // Setup SDL
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0){
@@ -230,34 +189,107 @@ int main(int argc, char const *argv[]){
 
     ImVec4 clear_color = ImColor(58, 58, 58);
 
+    // redraw only on input or new samples, at most target_fps
+    Frame_Scheduler scheduler(target_fps);
+    trace_thread_name("ui");
+    b_serial.on_data = [&scheduler](){ scheduler.wake(); };
+
+    // frequency response of a recorded sine/multisine run
+    Bode_Window bode;
+    bode.on_done = [&scheduler](){ scheduler.wake(); };
+
+    // more controllers, read by one I/O pool
+    Motor_Dashboard dashboard;
+    dashboard.on_data = [&scheduler](){ scheduler.wake(); };
+
     // Main loop
     bool done = false;
     while (!done){
         SDL_Event event;
-        while (SDL_PollEvent(&event)){
-            ImGui_ImplSdl_ProcessEvent(&event);
-            if (event.type == SDL_QUIT)
-                done = true;
+        if (scheduler.wait(event)){
+            do {
+                scheduler.handle(event);
+                if (scheduler.is_wake(event))
+                    continue;
+                ImGui_ImplSdl_ProcessEvent(&event);
+                if (event.type == SDL_QUIT)
+                    done = true;
+            } while (SDL_PollEvent(&event));
         }
 
+        if (!scheduler.frame_due())
+            continue;
+
+        scheduler.begin_frame();
+        uint64_t frame_start = trace_on.load(std::memory_order_relaxed) ? trace_now() : 0;
         ImGui_ImplSdl_NewFrame(window);
 
+        // frame pacing overlay
+        {
+            ImGui::SetNextWindowSize(ImVec2(330, 80), ImGuiSetCond_FirstUseEver);
+            ImGui::Begin("Performance");
+            ImGui::Text("frame: %.2f ms   %.1f fps   cpu: %.1f%%", scheduler.frame_ms, scheduler.fps, scheduler.cpu_percent);
+            ImGui::SliderInt("max fps", &scheduler.target_fps, 1, 120);
+            ImGui::End();
+        }
+
         // non 'static' window
         bool plot_window = true;
         bool serial_window = true;
         bool control_window = true;
 
         if (plot_window){
-
-            int values_offset = 0;
-            std::vector<float> serial_values(VECTOR_LEN, 0);
+            TRACE_SCOPE("plot");
+
+            static std::vector<float> plot_values(PLOT_WINDOW, 0); // PlotLines only
+            static Strip_Plot strip, error_strip;
+            static bool  plot_lines = false; // ImGui::PlotLines instead, to compare
+            static float plot_us[2] = {0, 0}; // [strip, PlotLines], smoothed
+            strip.window = error_strip.window = PLOT_WINDOW;
+            Sample_View view;
+            b_serial.values(view);
+            Telemetry stats = b_serial.telemetry_stats();
             
             ImGui::SetNextWindowSize(ImVec2(700, 450), ImGuiSetCond_FirstUseEver);
             ImGui::Begin("Plot Window", &plot_window);
+
+            ImGui::Text("samples: %u   dropped: %u (%.2f%%)   overruns: %u   jitter: %.1f ms rms, %.1f ms max",
+                        stats.received, stats.dropped, 100*stats.drop_rate(), stats.overruns,
+                        1e3*stats.jitter_rms(), 1e3*stats.jitter_max());
+            ImGui::Checkbox("hold", &strip.hold);
+            error_strip.hold = strip.hold;
+            ImGui::SameLine();
+            ImGui::Checkbox("PlotLines", &plot_lines);
+            ImGui::SameLine();
+            ImGui::Text("plot: %.1f us (PlotLines %.1f us)   %d points   %.0f s of history", plot_us[0], plot_us[1],
+                        strip.points() + error_strip.points(), view.count*TELEMETRY_TICK_PERIOD);
             
-            ImGui::PushStyleColor(ImGuiCol_PlotLines, ImVec4(0.90f, 0.70f, 0.00f, 1.00f));
-            ImGui::PlotLines("##rpm", &serial_values[0], VECTOR_LEN, values_offset, "rpm", 1200, 6600, ImVec2(0.97f*ImGui::GetWindowWidth(),0.9f*ImGui::GetWindowHeight()));
-            ImGui::PopStyleColor();
+            float plot_height = 0.85f*ImGui::GetWindowHeight() - ImGui::GetTextLineHeightWithSpacing();
+            ImVec2 plot_size(0.97f*ImGui::GetWindowWidth(), 0.7f*plot_height);
+            double plot_start = Telemetry::now();
+            if (plot_lines){
+                // the last PLOT_WINDOW slots, copied: PlotLines wraps at its count
+                int n = std::min((int)view.count, PLOT_WINDOW);
+                for (int i = 0; i < PLOT_WINDOW; i++){
+                    plot_values[i] = (i < PLOT_WINDOW - n) ? 0 : view.at(SAMPLE_RPM, view.count - PLOT_WINDOW + i);
+                }
+                ImGui::PushStyleColor(ImGuiCol_PlotLines, ImVec4(0.90f, 0.70f, 0.00f, 1.00f));
+                ImGui::PlotLines("##rpm", &plot_values[0], PLOT_WINDOW, 0, "rpm", 1200, 6600, plot_size);
+                ImGui::PopStyleColor();
+            }
+            else{
+                // straight from the store's columns
+                Strip_Channel rpm[2] = {
+                    {"rpm",      ImVec4(0.90f, 0.70f, 0.00f, 1.00f), view.value[SAMPLE_RPM],      (int)view.capacity, (int)view.offset, (int)view.count},
+                    {"setpoint", ImVec4(0.40f, 0.80f, 0.40f, 1.00f), view.value[SAMPLE_SETPOINT], (int)view.capacity, (int)view.offset, (int)view.count},
+                };
+                Strip_Channel error = {"error", ImVec4(0.90f, 0.40f, 0.40f, 1.00f), view.value[SAMPLE_ERROR], (int)view.capacity, (int)view.offset, (int)view.count};
+                strip.draw("##rpm", rpm, 2, (uint32_t)view.end, 1200, 6600, TELEMETRY_TICK_PERIOD, plot_size);
+                error_strip.draw("##error", &error, 1, (uint32_t)view.end, -500, 500, TELEMETRY_TICK_PERIOD,
+                                 ImVec2(plot_size.x, 0.3f*plot_height));
+            }
+            float &us = plot_us[plot_lines ? 1 : 0];
+            us += 0.05f*((float)(1e6*(Telemetry::now() - plot_start)) - us);
             
             ImGui::End();
         }
@@ -268,8 +300,8 @@ int main(int argc, char const *argv[]){
 
             static bool serial_opened_last = serial_opened;
             static int bps = 5;
-            const int serial_bps[] = {9600, 19200, 38400, 57600, 115200, 460800};
-            const char* serial_bps_str[] = {"9600", "19200", "38400", "57600", "115200", "460800"};
+            const int serial_bps[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800};
+            const char* serial_bps_str[] = {"9600", "19200", "38400", "57600", "115200", "230400", "460800"};
 
             ImGui::SetNextWindowSize(ImVec2(700, 450), ImGuiSetCond_FirstUseEver);
             ImGui::Begin("Serial", &serial_window);
@@ -279,6 +311,65 @@ int main(int argc, char const *argv[]){
             ImGui::Text("baudrate:");
             ImGui::Combo("##baudrate", &bps, serial_bps_str, IM_ARRAYSIZE(serial_bps_str));
             ImGui::Checkbox("open", &serial_opened);
+            ImGui::SameLine();
+            static bool reconnect = true;
+            if (ImGui::Checkbox("reconnect", &reconnect)){
+                b_serial.auto_reconnect = reconnect;
+            }
+
+            // hot-plug (brushless_serial.h)
+            if (serial_opened){
+                Link_Status link = b_serial.link_status();
+                if (link.retry_ms > 0){
+                    ImGui::Text("waiting for %s (retry in %d ms)", serial_port.uart_name.c_str(), link.retry_ms);
+                }else if (!link.connected){
+                    ImGui::Text("no samples yet");
+                }
+                if (link.reconnects > 0){
+                    ImGui::Text("reconnects: %u   last: %.1f ms to the first sample, %.1f s down",
+                                link.reconnects, link.last_reconnect_ms, link.last_outage_s);
+                }
+            }
+
+            // local subscribers of the samples (telemetry_server.h)
+            static char server_address[128] = "unix:/tmp/brushless.sock";
+            static bool serving = false;
+            ImGui::Text("export:");
+            ImGui::InputText("##export", server_address, IM_ARRAYSIZE(server_address));
+            ImGui::SameLine();
+            if (ImGui::Checkbox("serve", &serving)){
+                if (serving){
+                    serving = server.start(server_address);
+                }else{
+                    server.stop();
+                }
+            }
+            if (serving){
+                static std::vector<Subscriber_Stats> subscribers;
+                server.subscribers(subscribers);
+                uint32_t dropped = 0;
+                for (size_t i = 0; i < subscribers.size(); i++){
+                    dropped += subscribers[i].dropped;
+                }
+                ImGui::Text("subscribers: %zu   dropped: %u", subscribers.size(), dropped);
+            }
+
+            // set-points from automation (command_server.h)
+            static char command_address[128] = "unix:/tmp/brushless-cmd.sock";
+            static bool listening = false;
+            ImGui::Text("remote:");
+            ImGui::InputText("##remote", command_address, IM_ARRAYSIZE(command_address));
+            ImGui::SameLine();
+            if (ImGui::Checkbox("listen", &listening)){
+                if (listening){
+                    listening = command_server.start(command_address);
+                }else{
+                    command_server.stop();
+                }
+            }
+            if (listening){
+                ImGui::Text("clients: %d", command_server.clients());
+            }
 
             // verifica alteracao no toggle serial
             bool serial_changed = false;
@@ -289,9 +380,26 @@ int main(int argc, char const *argv[]){
 
             if (serial_changed){
                 if(serial_opened){
-                    b_serial.start();
+                    serial_port.uart_name = serial_name;
+                    serial_port.baudrate = serial_bps[bps];
+                    identifier.reset(); // maybe another rig
+                    live_stats.reset();
+                    try {
+                        serial_port.start();
+                    }
+                    catch (int error){
+                        // not plugged in (yet): with reconnect the read thread waits for it
+                    }
+                    try {
+                        b_serial.start();
+                    }
+                    catch (int error){
+                        serial_opened = serial_opened_last = false;
+                    }
                 }else{
-                    serial_port->handle_quit();
+                    profile.stop();
+                    b_serial.handle_quit();
+                    serial_port.handle_quit();
                 }
             }
 
@@ -306,47 +414,113 @@ int main(int argc, char const *argv[]){
             ImGui::SliderInt("##rpm", &setRPM, 2000, 6000);
             ImGui::SameLine();
             if(ImGui::Button("set") && serial_opened){
-                // printf("send pulse\n");
+                b_serial.command(std::to_string(setRPM));
+            }
+
+            // UI and remote commands, acked by the firmware echo
+            Command_Stats commands = b_serial.commands.stats();
+            ImGui::Text("commands: %u sent, %u acked, %u coalesced, %u timeouts   ack: %.1f ms p50, %.1f ms p99",
+                        commands.sent, commands.acked, commands.coalesced, commands.timeouts,
+                        1e3*commands.p50, 1e3*commands.p99);
+
+            // timed set-points, sent from the profile runner thread
+            static char profile_name[128] = "profile.txt";
+            ImGui::Text("profile:");
+            ImGui::InputText("##profile", profile_name, IM_ARRAYSIZE(profile_name));
+            ImGui::SameLine();
+            if(profile.running()){
+                if(ImGui::Button("stop")){
+                    profile.stop();
+                }
+            }else if(ImGui::Button("run") && serial_opened){
+                profile.stop(); // joins the previous run
+                if(profile.load(profile_name)){
+                    profile.start([&b_serial](const std::string &line){ return b_serial.write_message(line); });
+                }
             }
+            ImGui::SameLine();
+            if(ImGui::Button("save times")){
+                profile.write_log((std::string(profile_name) + ".sent.tsv").c_str());
+            }
+            ImGui::Text("sent: %u/%u   max error: %.3f ms", (unsigned)profile.sent_count(),
+                        (unsigned)profile.points.size(), 1e3*profile.max_error());
 
             // ImGui::Separator();
             ImGui::Spacing();
             ImGui::Spacing();
             ImGui::Spacing();
 
-            // ImGui::Text("SNR:"); ImGui::SameLine(); ImGui::TextColored(ImVec4(1.0f,1.0f,0.0f,1.0f), "%d", 123);
+            // statistics of the last second, published by the read thread
+            static Live_Snapshot live;
+            live_stats.snapshot(live);
+            ImGui::Text("SNR:"); ImGui::SameLine(); ImGui::TextColored(ImVec4(1.0f,1.0f,0.0f,1.0f), "%.1f dB", live.snr_db);
+            ImGui::SameLine();
+            ImGui::Text("  rpm: %.0f +- %.1f   tracking error: %.1f rms", live.mean, live.stddev, live.tracking_rms);
+            if(live.step.to > 0){
+                ImGui::Text("step %d -> %d: overshoot %.1f%%   90%%: %.2f s   settled: %.2f s%s", live.step.from, live.step.to,
+                            live.step.overshoot, live.step.rise_time, live.step.settling_time, live.step.done ? "" : " ...");
+            }
+            ImGui::Text("noise: %.2f rpm/sqrt(Hz) above %.0f Hz", live.noise_density, 0.25/TELEMETRY_TICK_PERIOD);
+            float psd[LIVE_DFT/2];
+            for(int k = 0; k < LIVE_DFT/2; k++){
+                psd[k] = (float)(10*log10(live.psd[k + 1] + 1e-12));
+            }
+            ImGui::PlotHistogram("##psd", psd, LIVE_DFT/2, 0, "rpm PSD (dB)", -40, 60, ImVec2(0, 60));
 
-            ShowExampleAppLog();
+            ShowLog(b_serial, profile);
 
             ImGui::End();
         }
 
+        bode.draw("Frequency Response");
+        {
+            TRACE_SCOPE("motors");
+            dashboard.draw("Motors");
+        }
+        ShowIdentification(identifier, b_serial, serial_opened);
+        ShowTrace();
+
+        if (frame_start)
+            trace_record("frame.build", frame_start, trace_now());
+
         // Rendering
         glViewport(0, 0, (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y);
         glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui::Render();
-        SDL_GL_SwapWindow(window);
-    }
-
-    // Cleanup
-    ImGui_ImplSdl_Shutdown();
-    SDL_GL_DeleteContext(glcontext);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+        {
+            TRACE_SCOPE("render");
+            ImGui::Render();
+        }
+        scheduler.end_frame();
+        {
+            TRACE_SCOPE("swap");
+            SDL_GL_SwapWindow(window);
+        }
 
-    try {
-        b_serial.handle_quit();
+        // newest line handled by the read thread -> on screen
+        static uint64_t line_shown = 0;
+        uint64_t line_trace = b_serial.last_line_trace.load();
+        if (line_trace && line_trace != line_shown && trace_on.load(std::memory_order_relaxed)){
+            trace_record("line->swap", line_trace, trace_now());
+            line_shown = line_trace;
+        }
     }
-    catch (int error){}
 
+    // stop the read thread before SDL goes away (it pushes wake events)
+    profile.stop();
     try {
-        serial_port->handle_quit();
+        b_serial.handle_quit();
     }
     catch (int error){}
-    delete serial_port;
-
+    dashboard.stop();
+    server.stop();
+    command_server.stop();
 
+    // Cleanup
+    ImGui_ImplSdl_Shutdown();
+    SDL_GL_DeleteContext(glcontext);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
 
     return 0;
 }
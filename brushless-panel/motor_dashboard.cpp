@@ -0,0 +1,316 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "motor_dashboard.h"
+#include "plot_decimation.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static const int   dashboard_bps[]     = {9600, 19200, 38400, 57600, 115200, 230400, 460800};
+static const char* dashboard_bps_str[] = {"9600", "19200", "38400", "57600", "115200", "230400", "460800"};
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Motor_Dashboard::
+Motor_Dashboard()
+{
+    baudrate = 5; // 230400, as the Serial window
+}
+
+// the motors leave the pool before it stops its workers
+Motor_Dashboard::
+~Motor_Dashboard()
+{
+    stop();
+    for (size_t i = 0; i < motors.size(); i++)
+    {
+        delete motors[i];
+    }
+    motors.clear();
+}
+
+void
+Motor_Dashboard::
+stop()
+{
+    for (size_t i = 0; i < motors.size(); i++)
+    {
+        motors[i]->serial.handle_quit();
+        motors[i]->port.handle_quit();
+        motors[i]->open = motors[i]->opened = false;
+    }
+}
+
+int
+Motor_Dashboard::
+motor_count() const
+{
+    return (int)motors.size();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Motors
+// ------------------------------------------------------------------------------
+void
+Motor_Dashboard::
+add_motor()
+{
+    if (motors.size() >= DASHBOARD_MAX_MOTORS)
+    {
+        return;
+    }
+
+    Motor *motor = new Motor();
+    snprintf(motor->name, sizeof(motor->name), "/dev/ttyUSB%d", (int)motors.size());
+    motor->open     = false;
+    motor->opened   = false;
+    motor->first_column = 0;
+    motor->last_end     = 0;
+    motor->has_plot     = false;
+    memset(&motor->live, 0, sizeof(motor->live));
+
+    motor->serial.set_live_stats(&motor->stats);
+    motor->serial.on_data = [this](){ if (on_data) on_data(); };
+    motors.push_back(motor);
+}
+
+void
+Motor_Dashboard::
+remove_motor(size_t i)
+{
+    Motor *motor = motors[i];
+    motor->serial.handle_quit();
+    motor->port.handle_quit();
+    motors.erase(motors.begin() + i);
+    delete motor;
+}
+
+// same sequence as the Serial window, with the pool instead of threads
+void
+Motor_Dashboard::
+toggle(Motor *motor)
+{
+    motor->opened = motor->open;
+    if (!motor->open)
+    {
+        motor->serial.handle_quit();
+        motor->port.handle_quit();
+        return;
+    }
+
+    motor->port.uart_name = motor->name;
+    motor->port.baudrate  = dashboard_bps[baudrate];
+    motor->stats.reset();
+    motor->has_plot = false;
+    try {
+        motor->port.start();
+    }
+    catch (int error)
+    {
+        // not plugged in (yet): the pool retries it
+    }
+    try {
+        motor->serial.start(&pool);
+    }
+    catch (int error)
+    {
+        motor->open = motor->opened = false;
+    }
+}
+
+// log and stats, for every motor each frame (the log would grow otherwise)
+void
+Motor_Dashboard::
+update(Motor *motor)
+{
+    std::vector<std::string> messages;
+    motor->serial.take_messages(messages);
+    if (!messages.empty())
+    {
+        motor->last_message = messages.back();
+    }
+
+    motor->stats.snapshot(motor->live);
+}
+
+// the plot columns, for the visible rows, only when a slot arrived or the
+// row changed width: min/max of the newest DASHBOARD_PLOT_LEN slots, read
+// in place from the store
+void
+Motor_Dashboard::
+decimate_plot(Motor *motor, int columns)
+{
+    Sample_View view;
+    motor->serial.values(view);
+    if (view.count == 0 ||
+        (motor->has_plot && view.end == motor->last_end && columns == (int)motor->column_min.size()))
+    {
+        return;
+    }
+    motor->last_end = view.end;
+    motor->has_plot = true;
+    motor->column_min.resize(columns);
+    motor->column_max.resize(columns);
+
+    // while the history is shorter than the plot its left columns stay empty
+    double first = (double)view.count - DASHBOARD_PLOT_LEN;
+    int    c0    = (first < 0) ? (int)ceil(-first/DASHBOARD_PLOT_LEN*columns) : 0;
+    motor->first_column = c0;
+    if (c0 < columns)
+    {
+        decimate_min_max(view.value[SAMPLE_RPM], (int)view.capacity, (int)view.offset, (int)view.count,
+                         first + (double)DASHBOARD_PLOT_LEN*c0/columns,
+                         (double)DASHBOARD_PLOT_LEN*(columns - c0)/columns, columns - c0,
+                         &motor->column_min[c0], &motor->column_max[c0]);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Drawing
+// ------------------------------------------------------------------------------
+
+// rpm of the last DASHBOARD_PLOT_LEN samples, at most two points per column
+void
+Motor_Dashboard::
+plot(Motor *motor, const ImVec2 &size)
+{
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImVec2 a = ImGui::GetCursorScreenPos();
+    ImVec2 b(a.x + size.x, a.y + size.y);
+    ImGui::InvisibleButton("##rpm", size);
+    if (size.x < 1 || size.y < 1)
+    {
+        return;
+    }
+    draw_list->AddRectFilled(a, b, ImColor(30, 30, 30));
+
+    decimate_plot(motor, (int)size.x);
+    if (!motor->has_plot)
+    {
+        return;
+    }
+    const float ymin = 1200, ymax = 6600;
+    auto y_of = [&](float v){
+        float t = (v - ymin)/(ymax - ymin);
+        t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+        return b.y - t*(b.y - a.y);
+    };
+
+    // each column from the side nearest the last point, as Strip_Plot
+    std::vector<ImVec2> &points = motor->line;
+    points.clear();
+    for (int c = motor->first_column; c < (int)motor->column_min.size(); c++)
+    {
+        float x  = a.x + c + 0.5f;
+        float lo = y_of(motor->column_min[c]);
+        float hi = y_of(motor->column_max[c]);
+        bool  low_first = !points.empty() && fabsf(points.back().y - lo) < fabsf(points.back().y - hi);
+        points.push_back(ImVec2(x, low_first ? lo : hi));
+        if (lo != hi)
+        {
+            points.push_back(ImVec2(x, low_first ? hi : lo));
+        }
+    }
+    if (points.size() > 1)
+    {
+        draw_list->AddPolyline(points.data(), (int)points.size(), ImColor(0.90f, 0.70f, 0.00f, 1.00f), false, 1.0f, true);
+    }
+}
+
+void
+Motor_Dashboard::
+row(Motor *motor, size_t i, bool &remove)
+{
+    ImGui::PushID((int)i);
+
+    ImGui::BeginChild("##motor", ImVec2(0, DASHBOARD_ROW_HEIGHT - 4), false, ImGuiWindowFlags_NoScrollbar);
+
+    ImGui::PushItemWidth(150);
+    ImGui::InputText("##port", motor->name, sizeof(motor->name));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox("open", &motor->open);
+    if (motor->open != motor->opened)
+    {
+        toggle(motor);
+    }
+    ImGui::SameLine();
+    remove = ImGui::Button("x");
+
+    if (motor->open)
+    {
+        Link_Status link = motor->serial.link_status();
+        Telemetry   stats = motor->serial.telemetry_stats();
+        if (link.retry_ms > 0)
+        {
+            ImGui::Text("waiting (retry in %d ms)", link.retry_ms);
+        }
+        else
+        {
+            ImGui::Text("%.0f +- %.1f rpm  drop %.2f%%", motor->live.mean, motor->live.stddev, 100*stats.drop_rate());
+        }
+        ImGui::Text("%s", motor->last_message.c_str());
+    }
+
+    // plots stay at the right, past the text
+    ImGui::SetCursorPos(ImVec2(360, 0));
+    plot(motor, ImVec2(ImGui::GetWindowWidth() - 370, DASHBOARD_ROW_HEIGHT - 8));
+
+    ImGui::EndChild();
+    ImGui::PopID();
+}
+
+void
+Motor_Dashboard::
+draw(const char* title)
+{
+    ImGui::SetNextWindowSize(ImVec2(900, 600), ImGuiSetCond_FirstUseEver);
+    ImGui::Begin(title);
+
+    if (ImGui::Button("add motor"))
+    {
+        add_motor();
+    }
+    ImGui::SameLine();
+    ImGui::PushItemWidth(100);
+    ImGui::Combo("baudrate", &baudrate, dashboard_bps_str, (int)(sizeof(dashboard_bps_str)/sizeof(*dashboard_bps_str)));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Text("%d motors, %d io threads", (int)motors.size(), pool.threads());
+    ImGui::Separator();
+
+    // every motor keeps its log and stats current, only the visible rows draw
+    for (size_t i = 0; i < motors.size(); i++)
+    {
+        update(motors[i]);
+    }
+
+    int remove = -1;
+    ImGui::BeginChild("##motors");
+    ImGuiListClipper clipper((int)motors.size(), DASHBOARD_ROW_HEIGHT);
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+    {
+        bool removed = false;
+        row(motors[i], i, removed);
+        if (removed)
+        {
+            remove = i;
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+
+    if (remove >= 0)
+    {
+        remove_motor(remove);
+    }
+
+    ImGui::End();
+}
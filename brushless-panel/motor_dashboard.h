@@ -0,0 +1,100 @@
+#ifndef MOTOR_DASHBOARD_H_
+#define MOTOR_DASHBOARD_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <imgui.h>
+#include "serial_port.h"
+#include "brushless_serial.h"
+#include "live_stats.h"
+#include "io_pool.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define DASHBOARD_MAX_MOTORS 32
+#define DASHBOARD_PLOT_LEN   256  // samples per row (2.56s)
+#define DASHBOARD_HISTORY    1024 // slots kept per motor (Sample_Store)
+#define DASHBOARD_ROW_HEIGHT 64   // px, fixed so the clipper can skip rows
+
+
+// ----------------------------------------------------------------------------------
+//   Motor Dashboard Class
+// ----------------------------------------------------------------------------------
+/*
+ * Motor Dashboard Class
+ *
+ * Many controllers in one window. Each motor has its own port, ingest
+ * (BrushlessSerial: parse, plot ring, link status) and Live_Stats, but
+ * none has threads of its own: they are all read by one Io_Pool.
+ *
+ * A motor is one row of fixed height: port, open, a few numbers and a
+ * plot of the last DASHBOARD_PLOT_LEN samples. The rows go through an
+ * ImGuiListClipper, so rows scrolled out of view cost nothing. The plot is
+ * drawn on the draw list from the min and max of each pixel column
+ * (plot_decimation.h), read in place from the store only when a new slot
+ * arrived since the last frame; nothing is copied out of the ring.
+ */
+class Motor_Dashboard
+{
+
+public:
+
+    Motor_Dashboard();
+    ~Motor_Dashboard();
+
+    void draw(const char* title);
+    void stop(); // closes every motor, before SDL goes away
+
+    std::function<void()> on_data; // called from the pool threads
+
+    int  motor_count() const;
+
+private:
+
+    struct Motor
+    {
+        Serial_Port     port;
+        BrushlessSerial serial;
+        Live_Stats      stats;
+
+        char  name[128];
+        bool  open;
+        bool  opened;    // open, as of the last frame
+
+        std::vector<float>  column_min;   // rpm per pixel column of the plot
+        std::vector<float>  column_max;
+        std::vector<ImVec2> line;
+        int      first_column; // columns left of the oldest slot (empty)
+        uint64_t last_end;     // Sample_View::end of the columns
+        bool     has_plot;
+
+        Live_Snapshot live;
+        std::string   last_message;
+
+        Motor() : serial(&port, DASHBOARD_HISTORY) {}
+    };
+
+    Io_Pool              pool;   // declared first: outlives the motors
+    std::vector<Motor*>  motors;
+    int                  baudrate;
+
+    void add_motor();
+    void remove_motor(size_t i);
+    void toggle(Motor *motor);
+    void update(Motor *motor);
+    void decimate_plot(Motor *motor, int columns);
+    void plot(Motor *motor, const ImVec2 &size);
+    void row(Motor *motor, size_t i, bool &remove);
+
+};
+
+
+#endif // MOTOR_DASHBOARD_H_
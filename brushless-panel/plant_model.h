@@ -0,0 +1,27 @@
+#ifndef PLANT_MODEL_H_
+#define PLANT_MODEL_H_
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+// nominal plant, in the units of the telemetry (pulse in us, rpm out):
+//
+//                PLANT_GAIN
+//      -------------------------- * exp(-PLANT_DELAY*s)
+//      0.03054 s^2 + 0.3522 s + 1
+//
+// the dynamics are the model documented in brushless-firmware/main.c. Its
+// gain (26.57) is not per us of pulse; the gain here is the incremental
+// one between the servo limits, (6500-1250)rpm/(1600-1200)us, which the
+// Smith predictor (SMITHGAIN in control.c) and the simulator (PLANTGAIN)
+// use as well
+#define PLANT_GAIN   13.125   // rpm/us
+#define PLANT_A2     0.03054  // s^2
+#define PLANT_A1     0.3522   // s
+#define PLANT_DELAY  0.0665   // s
+#define PLANT_POLE1  -5.055   // 1/s, roots of PLANT_A2 s^2 + PLANT_A1 s + 1
+#define PLANT_POLE2  -6.477
+
+
+#endif // PLANT_MODEL_H_
@@ -0,0 +1,78 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "plot_decimation.h"
+
+#include <math.h>
+
+
+// ------------------------------------------------------------------------------
+//   Decimation
+// ------------------------------------------------------------------------------
+void
+decimate_min_max(const float *ring, int capacity, int offset, int count, double first,
+                 double span, int columns, float *min, float *max)
+{
+    if (count <= 0 || columns <= 0)
+    {
+        return;
+    }
+
+    for (int c = 0; c < columns; c++)
+    {
+        int begin = (int)floor(first + span*c/columns);
+        int end   = (int)floor(first + span*(c + 1)/columns);
+        if (begin < 0)
+        {
+            begin = 0;
+        }
+        if (end > count)
+        {
+            end = count;
+        }
+        if (end <= begin)
+        {
+            end = begin + 1; // zoomed past one sample per column
+        }
+        if (begin >= count)
+        {
+            begin = count - 1;
+            end   = count;
+        }
+
+        int   p  = (offset + begin) % capacity;
+        float lo = ring[p];
+        float hi = ring[p];
+        for (int i = begin + 1; i < end; i++)
+        {
+            if (++p == capacity)
+            {
+                p = 0;
+            }
+            float v = ring[p];
+            lo = (v < lo) ? v : lo;
+            hi = (v > hi) ? v : hi;
+        }
+        min[c] = lo;
+        max[c] = hi;
+    }
+}
+
+float
+ring_value(const float *ring, int capacity, int offset, int count, int age)
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+    if (age < 0)
+    {
+        age = 0;
+    }
+    if (age >= count)
+    {
+        age = count - 1;
+    }
+    return ring[(offset + count - 1 - age) % capacity];
+}
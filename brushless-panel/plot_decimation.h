@@ -0,0 +1,36 @@
+#ifndef PLOT_DECIMATION_H_
+#define PLOT_DECIMATION_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stddef.h>
+
+// ------------------------------------------------------------------------------
+//   Functions
+// ------------------------------------------------------------------------------
+/*
+ * Min/max decimation of a ring for a plot of `columns` pixel columns.
+ *
+ * The ring has `capacity` slots and holds `count` values from `offset`,
+ * the oldest first, wrapping at the end (a Sample_View column, or a plain
+ * array with offset 0). The view starts `first` values after the oldest
+ * and spans `span` values (fractional while zooming); column c covers
+ * [first + span*c/columns, first + span*(c+1)/columns) and gets the min
+ * and max of those values, or the value under it when the view is
+ * narrower than the plot. A line through (min, max) of each column looks
+ * the same as one through every value, with at most 2*columns points
+ * whatever the span. The view must lie within [0, count).
+ *
+ * Each column reads its values in order, with the wrap of the ring
+ * handled by a compare instead of a modulo per value.
+ */
+
+void decimate_min_max(const float *ring, int capacity, int offset, int count, double first,
+                      double span, int columns, float *min, float *max);
+
+// the value `age` values before the newest (0: newest)
+float ring_value(const float *ring, int capacity, int offset, int count, int age);
+
+#endif // PLOT_DECIMATION_H_
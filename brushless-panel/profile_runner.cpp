@@ -0,0 +1,449 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "profile_runner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sstream>
+#include <algorithm>
+
+static void* start_profile_runner_thread(void *args);
+
+static bool by_time(const Profile_Point &a, const Profile_Point &b)
+{
+    return a.time < b.time;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Profile_Runner::
+Profile_Runner()
+{
+    pthread_mutex_init(&lock, NULL);
+    started    = false;
+    active     = false;
+    timer_fd   = -1;
+    stop_fd    = -1;
+    start_time = 0;
+    worst      = 0;
+}
+
+Profile_Runner::
+~Profile_Runner()
+{
+    stop();
+    pthread_mutex_destroy(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Load Profile
+// ------------------------------------------------------------------------------
+bool
+Profile_Runner::
+load(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    std::string text;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), file))
+    {
+        text += buf;
+    }
+    fclose(file);
+
+    std::string error;
+    if (!parse(text, error))
+    {
+        fprintf(stderr, "%s:%s\n", path, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Expands the profile text into timed points. On failure error holds
+ * "<line>: <reason>" and points is left empty.
+ */
+bool
+Profile_Runner::
+parse(const std::string &text, std::string &error)
+{
+    std::vector<Profile_Point> expanded;
+    std::istringstream lines(text);
+    std::string line;
+    int n = 0;
+
+    while (std::getline(lines, line))
+    {
+        n++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream in(line);
+        double t;
+        std::string kind;
+        if (!(in >> t))
+        {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+            {
+                continue; // blank line
+            }
+            error = std::to_string(n) + ": expected \"<seconds> <segment>\"";
+            return false;
+        }
+        if (!(in >> kind))
+        {
+            error = std::to_string(n) + ": missing segment";
+            return false;
+        }
+
+        // --------------------------------------------------------------------------
+        //   SEGMENTS
+        // --------------------------------------------------------------------------
+        char *end;
+        double value = strtod(kind.c_str(), &end);
+        bool numeric = (*end == '\0');
+
+        if (numeric || kind == "step")
+        {
+            if (!numeric && !(in >> value))
+            {
+                error = std::to_string(n) + ": step <rpm>";
+                return false;
+            }
+            Profile_Point p = {t, std::to_string((int)lround(value))};
+            expanded.push_back(p);
+        }
+        else if (kind == "ramp")
+        {
+            double v0, v1, duration;
+            if (!(in >> v0 >> v1 >> duration) || duration <= 0)
+            {
+                error = std::to_string(n) + ": ramp <rpm0> <rpm1> <seconds>";
+                return false;
+            }
+            int steps = (int)ceil(duration/PROFILE_PERIOD);
+            for (int k = 0; k <= steps; k++)
+            {
+                double tau = std::min(k*PROFILE_PERIOD, duration);
+                Profile_Point p = {t + tau, std::to_string((int)lround(v0 + (v1 - v0)*tau/duration))};
+                expanded.push_back(p);
+            }
+        }
+        else if (kind == "sine")
+        {
+            double center, amplitude, f0, f1, duration;
+            if (!(in >> center >> amplitude >> f0 >> f1 >> duration) || duration <= 0)
+            {
+                error = std::to_string(n) + ": sine <rpm> <amplitude> <f0> <f1> <seconds>";
+                return false;
+            }
+            // linear chirp: phase = 2pi*(f0*tau + (f1 - f0)*tau^2/(2T))
+            int steps = (int)ceil(duration/PROFILE_PERIOD);
+            for (int k = 0; k <= steps; k++)
+            {
+                double tau = std::min(k*PROFILE_PERIOD, duration);
+                double phase = 2*M_PI*(f0*tau + 0.5*(f1 - f0)*tau*tau/duration);
+                Profile_Point p = {t + tau, std::to_string((int)lround(center + amplitude*sin(phase)))};
+                expanded.push_back(p);
+            }
+        }
+        else if (kind == "multisine")
+        {
+            double center, amplitude, f0, f1, duration;
+            int tones;
+            if (!(in >> center >> amplitude >> f0 >> f1 >> tones >> duration)
+                || duration <= 0 || tones < 1 || f0 <= 0 || f1 < f0)
+            {
+                error = std::to_string(n) + ": multisine <rpm> <amplitude> <f0> <f1> <tones> <seconds>";
+                return false;
+            }
+            // log spaced tones, Schroeder phases -pi*k*(k-1)/N for a low
+            // crest factor, scaled so the peak is the amplitude
+            int steps = (int)ceil(duration/PROFILE_PERIOD);
+            std::vector<double> sum(steps + 1, 0);
+            double peak = 0;
+            for (int k = 0; k <= steps; k++)
+            {
+                double tau = std::min(k*PROFILE_PERIOD, duration);
+                for (int j = 0; j < tones; j++)
+                {
+                    double f = (tones > 1) ? f0*pow(f1/f0, (double)j/(tones - 1)) : f0;
+                    sum[k] += cos(2*M_PI*f*tau - M_PI*j*(j + 1)/tones);
+                }
+                peak = std::max(peak, fabs(sum[k]));
+            }
+            for (int k = 0; k <= steps; k++)
+            {
+                double tau = std::min(k*PROFILE_PERIOD, duration);
+                double value = (peak > 0) ? sum[k]*amplitude/peak : 0;
+                Profile_Point p = {t + tau, std::to_string((int)lround(center + value))};
+                expanded.push_back(p);
+            }
+        }
+        else if (kind == "send")
+        {
+            std::string raw;
+            if (!(in >> raw))
+            {
+                error = std::to_string(n) + ": send <line>";
+                return false;
+            }
+            Profile_Point p = {t, raw};
+            expanded.push_back(p);
+        }
+        else
+        {
+            Profile_Point p = {t, kind}; // short form of send
+            expanded.push_back(p);
+        }
+    }
+
+    // later segments win ties, as written
+    std::stable_sort(expanded.begin(), expanded.end(), by_time);
+    points.swap(expanded);
+    return true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Start / Stop
+// ------------------------------------------------------------------------------
+bool
+Profile_Runner::
+start(std::function<int(const std::string&)> send_)
+{
+    if (started || points.empty())
+    {
+        return false;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    stop_fd  = eventfd(0, EFD_CLOEXEC);
+    if (timer_fd < 0 || stop_fd < 0)
+    {
+        perror("profile runner");
+        if (timer_fd >= 0) close(timer_fd);
+        if (stop_fd >= 0) close(stop_fd);
+        timer_fd = stop_fd = -1;
+        return false;
+    }
+
+    send = send_;
+
+    pthread_mutex_lock(&lock);
+    sent.clear();
+    history.clear();
+    worst  = 0;
+    active = true;
+    pthread_mutex_unlock(&lock);
+
+    start_time = now() + PROFILE_LEAD;
+
+    int result = pthread_create(&tid, NULL, &start_profile_runner_thread, this);
+    if (result)
+    {
+        active = false;
+        close(timer_fd);
+        close(stop_fd);
+        timer_fd = stop_fd = -1;
+        return false;
+    }
+
+    started = true;
+    return true;
+}
+
+// also joins a profile that already finished
+void
+Profile_Runner::
+stop()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0)
+    {
+        perror("profile runner");
+    }
+    pthread_join(tid, NULL);
+
+    close(timer_fd);
+    close(stop_fd);
+    timer_fd = stop_fd = -1;
+    started  = false;
+}
+
+bool
+Profile_Runner::
+running()
+{
+    pthread_mutex_lock(&lock);
+    bool result = active;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Runner Thread
+// ------------------------------------------------------------------------------
+void
+Profile_Runner::
+run()
+{
+    // best effort: real-time priority keeps wake-up latency low (needs
+    // CAP_SYS_NICE or an rtprio limit, silently ignored otherwise)
+    struct sched_param param;
+    param.sched_priority = 10;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const Profile_Point &p = points[i];
+
+        double at = start_time + p.time;
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec  = (time_t)at;
+        its.it_value.tv_nsec = (long)(1e9*(at - its.it_value.tv_sec));
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+        struct pollfd fds[2];
+        fds[0].fd = timer_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = stop_fd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN))
+        {
+            break;
+        }
+
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+        {
+            continue;
+        }
+
+        Profile_Sent s;
+        s.scheduled = p.time;
+        s.actual    = now() - start_time;
+        send(p.line);
+        s.drained   = now() - start_time;
+        s.line      = p.line;
+
+        pthread_mutex_lock(&lock);
+        sent.push_back(s);
+        history.push_back(s);
+        worst = std::max(worst, fabs(s.actual - s.scheduled));
+        pthread_mutex_unlock(&lock);
+    }
+
+    pthread_mutex_lock(&lock);
+    active = false;
+    pthread_mutex_unlock(&lock);
+}
+
+static void* start_profile_runner_thread(void *args)
+{
+    Profile_Runner *runner = (Profile_Runner *)args;
+    runner->run();
+    return NULL;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Send Log
+// ------------------------------------------------------------------------------
+void
+Profile_Runner::
+take_sent(std::vector<Profile_Sent> &out)
+{
+    pthread_mutex_lock(&lock);
+    out.swap(sent);
+    sent.clear();
+    pthread_mutex_unlock(&lock);
+}
+
+size_t
+Profile_Runner::
+sent_count()
+{
+    pthread_mutex_lock(&lock);
+    size_t result = history.size();
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+double
+Profile_Runner::
+max_error()
+{
+    pthread_mutex_lock(&lock);
+    double result = worst;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+bool
+Profile_Runner::
+write_log(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    pthread_mutex_lock(&lock);
+    fprintf(file, "# scheduled\tactual\terror_us\tdrain_us\tline\n");
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        const Profile_Sent &s = history[i];
+        fprintf(file, "%.6f\t%.6f\t%.1f\t%.1f\t%s\n", s.scheduled, s.actual,
+                1e6*(s.actual - s.scheduled), 1e6*(s.drained - s.actual), s.line.c_str());
+    }
+    pthread_mutex_unlock(&lock);
+
+    fclose(file);
+    return true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Helper Functions
+// ------------------------------------------------------------------------------
+double
+Profile_Runner::
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
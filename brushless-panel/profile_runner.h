@@ -0,0 +1,107 @@
+#ifndef PROFILE_RUNNER_H_
+#define PROFILE_RUNNER_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <functional>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define PROFILE_PERIOD 0.02 // s, ramp/sine/multisine update (one PWM period)
+#define PROFILE_LEAD   0.05 // s, from start() to profile time 0
+
+
+// ------------------------------------------------------------------------------
+//   Points
+// ------------------------------------------------------------------------------
+struct Profile_Point
+{
+    double      time; // s after the profile start
+    std::string line; // sent to the firmware
+};
+
+struct Profile_Sent
+{
+    double      scheduled; // profile time
+    double      actual;    // profile time the write was issued
+    double      drained;   // profile time the bytes left the UART (tcdrain)
+    std::string line;
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Profile Runner Class
+// ----------------------------------------------------------------------------------
+/*
+ * Profile Runner Class
+ *
+ * Loads a set-point profile, one segment per line ('#' comments):
+ *
+ *     <t> step <rpm>                          set-point at t
+ *     <t> ramp <rpm0> <rpm1> <T>              linear, over T seconds
+ *     <t> sine <rpm> <amp> <f0> <f1> <T>      chirp f0 -> f1 Hz over T seconds
+ *     <t> multisine <rpm> <amp> <f0> <f1> <N> <T>
+ *                                             N log spaced tones, f0..f1 Hz
+ *     <t> send <line>                         any firmware line ("m1", "g80")
+ *     <t> <rpm> | <t> <line>                  short forms of step / send
+ *
+ * and sends it from its own thread. Each point is waited for with an
+ * absolute CLOCK_MONOTONIC timerfd, so timing does not depend on the UI
+ * frame rate, and the actual write times are kept for logging.
+ */
+class Profile_Runner
+{
+
+public:
+
+    Profile_Runner();
+    ~Profile_Runner();
+
+    bool load(const char *path);
+    bool parse(const std::string &text, std::string &error);
+
+    bool start(std::function<int(const std::string&)> send_);
+    void stop();
+    bool running();
+
+    void take_sent(std::vector<Profile_Sent> &out);
+    bool write_log(const char *path);
+
+    std::vector<Profile_Point> points;
+
+    // progress and timing error, for the UI
+    size_t sent_count();
+    double max_error(); // s, worst |actual - scheduled|
+
+    void run();
+
+private:
+
+    std::function<int(const std::string&)> send;
+
+    pthread_t       tid;
+    pthread_mutex_t lock;
+    bool            started;
+    int             timer_fd;
+    int             stop_fd;   // eventfd, wakes the thread on stop()
+
+    double          start_time;
+    bool            active;
+    std::vector<Profile_Sent> sent;     // not yet taken
+    std::vector<Profile_Sent> history;  // whole run, for write_log
+    double          worst;
+
+    static double now();
+
+};
+
+
+#endif // PROFILE_RUNNER_H_
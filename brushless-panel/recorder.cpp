@@ -0,0 +1,120 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Recorder::
+Recorder()
+{
+    file    = NULL;
+    buffer  = NULL;
+    samples = 0;
+}
+
+Recorder::
+~Recorder()
+{
+    close();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Open / Close
+// ------------------------------------------------------------------------------
+bool
+Recorder::
+open(const char *path)
+{
+    close();
+
+    size_t len = strlen(path), ext = strlen(ARCHIVE_EXTENSION);
+    if (len > ext && strcmp(path + len - ext, ARCHIVE_EXTENSION) == 0)
+    {
+        samples = 0;
+        return archive.open(path);
+    }
+
+    file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    buffer = (char*)malloc(RECORDER_BUFFER);
+    if (buffer)
+    {
+        setvbuf(file, buffer, _IOFBF, RECORDER_BUFFER);
+    }
+
+    samples = 0;
+    fprintf(file, "# seq\ttick\trpm\tsetpoint\tpulse\ttime\thost_time\n");
+    return true;
+}
+
+void
+Recorder::
+close()
+{
+    if (file)
+    {
+        fclose(file);
+        file = NULL;
+    }
+    free(buffer);
+    buffer = NULL;
+    archive.close();
+}
+
+bool
+Recorder::
+is_open() const
+{
+    return file != NULL || archive.is_open();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Write
+// ------------------------------------------------------------------------------
+void
+Recorder::
+write(const Telemetry_Sample &sample)
+{
+    if (archive.is_open())
+    {
+        archive.write(sample);
+        samples++;
+        return;
+    }
+    if (!file)
+    {
+        return;
+    }
+
+    fprintf(file, "%u\t%u\t%d\t%d\t%d\t%.2f\t%.6f\n",
+            sample.seq, sample.tick, sample.rpm, sample.setpoint, sample.pulse,
+            sample.time, sample.host_time);
+    samples++;
+}
+
+void
+Recorder::
+write_message(const std::string &message)
+{
+    archive.write_message(message);
+    if (!file)
+    {
+        return;
+    }
+
+    fprintf(file, "# %s\n", message.c_str());
+}
@@ -0,0 +1,62 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include "telemetry.h"
+#include "archive.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define RECORDER_BUFFER 65536 // stdio buffer, flushed on close
+
+
+// ----------------------------------------------------------------------------------
+//   Recorder Class
+// ----------------------------------------------------------------------------------
+/*
+ * Recorder Class
+ *
+ * Writes the telemetry to a tab separated file, one sample per line:
+ * "seq tick rpm setpoint pulse time host_time". The first columns are the
+ * firmware line, so simulator.run -r replays recordings directly; time is
+ * the firmware time base from Telemetry. Firmware messages are kept as
+ * "# " comment lines.
+ *
+ * A path ending in ARCHIVE_EXTENSION (".bla") is written as a compressed
+ * archive instead (see archive.h), for long captures.
+ */
+class Recorder
+{
+
+public:
+
+    Recorder();
+    ~Recorder();
+
+    bool open(const char *path);
+    void close();
+    bool is_open() const;
+
+    void write(const Telemetry_Sample &sample);
+    void write_message(const std::string &message);
+
+    uint32_t samples; // samples written since open
+
+private:
+
+    FILE *file;
+    char *buffer;
+    Archive_Writer archive;
+
+};
+
+
+#endif // RECORDER_H_
@@ -0,0 +1,196 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "sample_store.h"
+
+#include <stdlib.h>
+#include <new>
+
+
+// ------------------------------------------------------------------------------
+//   Arena
+// ------------------------------------------------------------------------------
+Sample_Arena::
+Sample_Arena()
+{
+    next  = NULL;
+    left  = 0;
+    total = 0;
+}
+
+Sample_Arena::
+~Sample_Arena()
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        free(chunks[i]);
+    }
+}
+
+void*
+Sample_Arena::
+allocate(size_t bytes)
+{
+    bytes = (bytes + SAMPLE_ALIGN - 1) & ~(size_t)(SAMPLE_ALIGN - 1);
+    if (bytes > left)
+    {
+        size_t size = (bytes > SAMPLE_ARENA_CHUNK) ? bytes : SAMPLE_ARENA_CHUNK;
+        void *chunk = NULL;
+        if (posix_memalign(&chunk, SAMPLE_ALIGN, size) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        chunks.push_back(chunk);
+        next   = (char*)chunk;
+        left   = size;
+        total += size;
+    }
+    void *p = next;
+    next += bytes;
+    left -= bytes;
+    return p;
+}
+
+size_t
+Sample_Arena::
+reserved() const
+{
+    return total;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Sample_Store::
+Sample_Store(uint32_t capacity)
+{
+    length = 2*SAMPLE_STORE_GUARD;
+    while (length < capacity)
+    {
+        length *= 2;
+    }
+    time = (double*)arena.allocate(length*sizeof(double));
+    for (int c = 0; c < SAMPLE_CHANNELS; c++)
+    {
+        value[c] = (float*)arena.allocate(length*sizeof(float));
+    }
+
+    end.store(0);
+    begin.store(0);
+    epoch.store(0);
+    has_sample = false;
+    last_slot  = 0;
+}
+
+uint32_t
+Sample_Store::
+capacity() const
+{
+    return length;
+}
+
+size_t
+Sample_Store::
+bytes() const
+{
+    return arena.reserved();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Writer
+// ------------------------------------------------------------------------------
+void
+Sample_Store::
+reset()
+{
+    begin.store(end.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    epoch.fetch_add(1, std::memory_order_release);
+    has_sample = false;
+}
+
+void
+Sample_Store::
+write_row(uint64_t position, double t, const float *values)
+{
+    uint32_t r = (uint32_t)position & (length - 1);
+    time[r] = t;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++)
+    {
+        value[c][r] = values[c];
+    }
+}
+
+// one row per firmware slot: lines lost on the link repeat the last row
+void
+Sample_Store::
+push(const Telemetry_Sample &sample)
+{
+    uint32_t slot = (uint32_t)(sample.time/TELEMETRY_TICK_PERIOD + 0.5);
+    uint64_t position = end.load(std::memory_order_relaxed);
+
+    if (has_sample && slot > last_slot + 1)
+    {
+        uint64_t last = position - 1;
+        uint32_t r    = (uint32_t)last & (length - 1);
+        float held[SAMPLE_CHANNELS];
+        for (int c = 0; c < SAMPLE_CHANNELS; c++)
+        {
+            held[c] = value[c][r];
+        }
+        // at most the guard at once, or a long silence would run over views
+        uint32_t gap = slot - last_slot - 1;
+        if (gap > length/SAMPLE_STORE_GUARD - 1)
+        {
+            gap = length/SAMPLE_STORE_GUARD - 1;
+        }
+        for (uint32_t s = 0; s < gap; s++)
+        {
+            write_row(position++, (last_slot + 1 + s)*TELEMETRY_TICK_PERIOD, held);
+        }
+    }
+
+    float values[SAMPLE_CHANNELS];
+    values[SAMPLE_RPM]      = sample.rpm;
+    values[SAMPLE_SETPOINT] = sample.setpoint;
+    values[SAMPLE_PULSE]    = sample.pulse;
+    values[SAMPLE_ERROR]    = sample.setpoint ? sample.setpoint - sample.rpm : 0;
+    write_row(position++, sample.time, values);
+
+    end.store(position, std::memory_order_release);
+    last_slot  = slot;
+    has_sample = true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Readers
+// ------------------------------------------------------------------------------
+void
+Sample_Store::
+view(Sample_View &out) const
+{
+    // epoch first: a reset between the loads gives the new epoch with a
+    // begin at most the old end, which is still a valid range
+    uint32_t e = epoch.load(std::memory_order_acquire);
+    uint64_t b = begin.load(std::memory_order_relaxed);
+    uint64_t n = end.load(std::memory_order_acquire);
+    uint64_t oldest = (n > length - length/SAMPLE_STORE_GUARD) ? n - (length - length/SAMPLE_STORE_GUARD) : 0;
+    if (b < oldest)
+    {
+        b = oldest;
+    }
+
+    out.time = time;
+    for (int c = 0; c < SAMPLE_CHANNELS; c++)
+    {
+        out.value[c] = value[c];
+    }
+    out.capacity = length;
+    out.offset   = (uint32_t)b & (length - 1);
+    out.count    = (uint32_t)(n - b);
+    out.end      = n;
+    out.epoch    = e;
+}
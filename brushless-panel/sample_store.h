@@ -0,0 +1,152 @@
+#ifndef SAMPLE_STORE_H_
+#define SAMPLE_STORE_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include "telemetry.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define SAMPLE_STORE_LEN   65536   // slots of history (10.9 min at 100 Hz)
+#define SAMPLE_STORE_GUARD 8       // 1/8 of the ring is never in a view
+#define SAMPLE_ALIGN       64      // cache line, and the widest vector load
+#define SAMPLE_ARENA_CHUNK 262144  // bytes asked to the system at a time
+
+// value channels, all float; the time base is a column of its own
+enum Sample_Channel_Id
+{
+    SAMPLE_RPM,
+    SAMPLE_SETPOINT,
+    SAMPLE_PULSE,
+    SAMPLE_ERROR,   // setpoint - rpm, 0 in WRITE mode (no set-point)
+    SAMPLE_CHANNELS
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Sample Arena Class
+// ----------------------------------------------------------------------------------
+/*
+ * Sample Arena Class
+ *
+ * Bump allocator for the columns of a Sample_Store: SAMPLE_ARENA_CHUNK
+ * (or larger) chunks from posix_memalign, handed out in SAMPLE_ALIGN
+ * multiples, all freed with the arena. No column shares a cache line with
+ * another, so the writer filling one row never invalidates the line a
+ * reader is scanning in another column.
+ */
+class Sample_Arena
+{
+
+public:
+
+    Sample_Arena();
+    ~Sample_Arena();
+
+    void*  allocate(size_t bytes); // SAMPLE_ALIGN aligned, throws std::bad_alloc
+    size_t reserved() const;       // bytes taken from the system
+
+private:
+
+    std::vector<void*> chunks;
+    char  *next;
+    size_t left;
+    size_t total;
+
+};
+
+
+// ------------------------------------------------------------------------------
+//   View
+// ------------------------------------------------------------------------------
+/*
+ * The samples of a Sample_Store as they were when the view was taken, in
+ * place: each column is a ring of `capacity` rows and the view is `count`
+ * rows from `offset` (oldest first), wrapping at the end of the ring.
+ * `end` counts the rows ever written, so it changes with every new slot
+ * and never repeats (a good version for caches); `epoch` changes with
+ * each reset.
+ */
+struct Sample_View
+{
+    const double *time;                     // firmware time base, s
+    const float  *value[SAMPLE_CHANNELS];
+    uint32_t capacity;
+    uint32_t offset;
+    uint32_t count;
+    uint64_t end;
+    uint32_t epoch;
+
+    uint32_t row(uint32_t i) const { return (offset + i) & (capacity - 1); } // 0: oldest
+    float    at(int channel, uint32_t i) const { return value[channel][row(i)]; }
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Sample Store Class
+// ----------------------------------------------------------------------------------
+/*
+ * Sample Store Class
+ *
+ * History of the telemetry as a structure of arrays: one column per
+ * channel (time, rpm, set-point, pulse, error), each a power of two ring
+ * from the arena, written by the ingest thread one row per 10 ms slot of
+ * the firmware time base. Lines lost on the link hold the previous row in
+ * their slots, as the plot ring did, so row i is i*period after the oldest
+ * (up to the guard below; a longer silence is shortened to it).
+ *
+ * push() is for one writer (the ingest thread). view() may be called from
+ * any thread at the same time, without a lock and without copying: the
+ * rows are written before `end` is published (release/acquire), and a view
+ * never includes the oldest capacity/SAMPLE_STORE_GUARD rows of a full
+ * ring, so the writer has that many slots to go (82 s of the default
+ * history at 100 Hz) before it overwrites anything a view taken now
+ * returned. A reader that needs the samples for longer copies them.
+ *
+ * reset() is O(1): it starts a new epoch at the current end, nothing is
+ * cleared or rewound, so it is safe while a view is in use. Call it with
+ * the writer stopped (BrushlessSerial::start).
+ */
+class Sample_Store
+{
+
+public:
+
+    Sample_Store(uint32_t capacity = SAMPLE_STORE_LEN);
+
+    void reset();
+    void push(const Telemetry_Sample &sample);
+
+    void     view(Sample_View &out) const;
+    uint32_t capacity() const;
+    size_t   bytes() const; // arena size, all columns
+
+private:
+
+    Sample_Arena arena;
+    uint32_t     length;   // power of two
+    double      *time;
+    float       *value[SAMPLE_CHANNELS];
+
+    std::atomic<uint64_t> end;    // rows written
+    std::atomic<uint64_t> begin;  // first row of the epoch
+    std::atomic<uint32_t> epoch;
+
+    // writer only
+    uint32_t last_slot;
+    bool     has_sample;
+
+    void write_row(uint64_t position, double t, const float *values);
+
+};
+
+
+#endif // SAMPLE_STORE_H_
@@ -6,6 +6,16 @@
 // ------------------------------------------------------------------------------
 
 #include "serial_port.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+// every member is a template of the four policies
+#define SERIAL_PORT_TEMPLATE template <class Framing, class Flow, class Read, class Buffer>
+#define SERIAL_PORT_CLASS    Basic_Serial_Port<Framing, Flow, Read, Buffer>
 
 
 // ----------------------------------------------------------------------------------
@@ -15,44 +25,68 @@
 // ------------------------------------------------------------------------------
 //   Con/De structors
 // ------------------------------------------------------------------------------
-Serial_Port::
-Serial_Port(const char *uart_name_ , int baudrate_)
+SERIAL_PORT_TEMPLATE
+SERIAL_PORT_CLASS::
+Basic_Serial_Port(const char *uart_name_ , int baudrate_)
 {
     initialize_defaults();
     uart_name = uart_name_;
     baudrate  = baudrate_;
 }
 
-Serial_Port::
-Serial_Port()
+SERIAL_PORT_TEMPLATE
+SERIAL_PORT_CLASS::
+Basic_Serial_Port()
 {
     initialize_defaults();
 }
 
-Serial_Port::
-~Serial_Port()
+SERIAL_PORT_TEMPLATE
+SERIAL_PORT_CLASS::
+~Basic_Serial_Port()
 {
+    if (status == SERIAL_PORT_OPEN)
+    {
+        close_serial();
+    }
+    close(wake_fd);
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+
     // destroy mutex
     pthread_mutex_destroy(&lock);
+    pthread_mutex_destroy(&write_lock);
 }
 
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 initialize_defaults()
 {
     // Initialize attributes
     debug  = false;
     fd     = -1;
     status = SERIAL_PORT_CLOSED;
+    rx_line_start = 0;
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    inotify_fd = -1;
+    dir_watch  = -1;
+    dev_watch  = -1;
 
-    uart_name = (char*)"/dev/ttyUSB0";
+    uart_name = "/dev/ttyUSB0";
     baudrate  = 57600;
 
     // Start mutex
     int result = pthread_mutex_init(&lock, NULL);
+    if ( result == 0 )
+    {
+        result = pthread_mutex_init(&write_lock, NULL);
+    }
     if ( result != 0 )
     {
-        printf("\n mutex init failed\n");
+        fprintf(stderr, "\n mutex init failed\n");
         throw 1;
     }
 }
@@ -61,95 +95,193 @@ initialize_defaults()
 // ------------------------------------------------------------------------------
 //   Read from Serial
 // ------------------------------------------------------------------------------
+/**
+ * Parses the bytes in the buffer and returns 1 when one of them completes
+ * a line, which is then moved into message (without the '\n'); the rest
+ * stay buffered for the next call. With an empty buffer it reads the port
+ * first (one byte or a chunk, see Buffer), and when that comes back empty
+ * waits as Read does. Returns 0 without a line and -1 on read errors.
+ */
+SERIAL_PORT_TEMPLATE
 int
-Serial_Port::
-read_message(/*mavlink_message_t &message*/)
+SERIAL_PORT_CLASS::
+read_message(std::string &message)
 {
-    uint8_t          cp;
-    // mavlink_status_t status;
-    uint8_t          msgReceived = false;
+    uint8_t          cp = 0;
 
     // --------------------------------------------------------------------------
     //   READ FROM PORT
     // --------------------------------------------------------------------------
-
-    // this function locks the port during read
-    int result = _read_port(cp);
-
+    if (!rx_buffer.next(cp))
+    {
+        // this locks the port during read
+        pthread_mutex_lock(&lock);
+        int result = rx_buffer.fill(fd);
+        pthread_mutex_unlock(&lock);
+
+        if (result < 0)
+        {
+            if (debug)
+            {
+                fprintf(stderr, "ERROR: Could not read from fd %d\n", fd);
+            }
+            return -1;
+        }
+
+        // nothing buffered: wait for a byte, interrupt() or the timeout (as
+        // Read does), and let the caller read again
+        if (result == 0)
+        {
+            return Read::wait(fd, wake_fd);
+        }
+        rx_buffer.next(cp);
+    }
 
     // --------------------------------------------------------------------------
     //   PARSE MESSAGE
     // --------------------------------------------------------------------------
-    // if (result > 0)
-    // {
-    //  // the parsing
-    //  msgReceived = mavlink_parse_char(MAVLINK_COMM_1, cp, &message, &status);
-
-    //  // check for dropped packets
-    //  if ( (lastStatus.packet_rx_drop_count != status.packet_rx_drop_count) && debug )
-    //  {
-    //      printf("ERROR: DROPPED %d PACKETS\n", status.packet_rx_drop_count);
-    //      unsigned char v=cp;
-    //      fprintf(stderr,"%02x ", v);
-    //  }
-    //  lastStatus = status;
-    // }
-
-    // Couldn't read from port
-    // else
-    // {
-    //  fprintf(stderr, "ERROR: Could not read from fd %d\n", fd);
-    // }
-
-    // // --------------------------------------------------------------------------
-    // //   DEBUGGING REPORTS
-    // // --------------------------------------------------------------------------
-    // if(msgReceived && debug)
-    // {
-    //  // Report info
-    //  printf("Received message from serial with ID #%d (sys:%d|comp:%d):\n", message.msgid, message.sysid, message.compid);
-
-    //  fprintf(stderr,"Received serial data: ");
-    //  unsigned int i;
-    //  uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-
-    //  // check message is write length
-    //  unsigned int messageLength = mavlink_msg_to_send_buffer(buffer, &message);
-
-    //  // message length error
-    //  if (messageLength > MAVLINK_MAX_PACKET_LEN)
-    //  {
-    //      fprintf(stderr, "\nFATAL ERROR: MESSAGE LENGTH IS LARGER THAN BUFFER SIZE\n");
-    //  }
-
-    //  // print out the buffer
-    //  else
-    //  {
-    //      for (i=0; i<messageLength; i++)
-    //      {
-    //          unsigned char v=buffer[i];
-    //          fprintf(stderr,"%02x ", v);
-    //      }
-    //      fprintf(stderr,"\n");
-    //  }
-    // }
-
-    // // Done!
-    return msgReceived;
+    do
+    {
+        if (_line_byte(cp, message))
+        {
+            if (debug)
+            {
+                fprintf(stderr, "Received line from serial: %s\n", message.c_str());
+            }
+            // Done!
+            return 1;
+        }
+    } while (rx_buffer.next(cp));
+
+    return 0;
+}
+
+// one byte of the line being received, 1 when it completes it
+SERIAL_PORT_TEMPLATE
+int
+SERIAL_PORT_CLASS::
+_line_byte(uint8_t cp, std::string &message)
+{
+    if (cp == '\r')
+    {
+        return 0;
+    }
+
+    if (cp != '\n')
+    {
+        if (rx_line.empty())
+        {
+            rx_line_start = trace_on.load(std::memory_order_relaxed) ? trace_now() : 0;
+        }
+        rx_line.push_back((char)cp);
+        return 0;
+    }
+
+    // blank lines around the firmware "*** ... ***" messages
+    if (rx_line.empty())
+    {
+        return 0;
+    }
+
+    // first byte -> newline: the line on the wire plus the read path
+    if (rx_line_start)
+    {
+        trace_record("serial.line", rx_line_start, trace_now());
+    }
+
+    message.swap(rx_line);
+    rx_line.clear();
+    return 1;
+}
+
+/**
+ * Reads whatever is buffered, without waiting, and appends the lines it
+ * completes (same rules as read_message). Returns how many, or -1 on read
+ * errors. For ports polled by Io_Pool, where a whole chunk per syscall
+ * matters more than the per line trace.
+ */
+SERIAL_PORT_TEMPLATE
+int
+SERIAL_PORT_CLASS::
+read_lines(std::vector<std::string> &lines)
+{
+    char buffer[SERIAL_PORT_CHUNK];
+    int count = 0;
+
+    // left by read_message, if it was used before
+    uint8_t cp;
+    std::string line;
+    while (rx_buffer.next(cp))
+    {
+        if (_line_byte(cp, line))
+        {
+            lines.push_back(std::string());
+            lines.back().swap(line);
+            count++;
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    ssize_t result = read(fd, buffer, sizeof(buffer));
+    pthread_mutex_unlock(&lock);
+
+    if (result < 0)
+    {
+        return (errno == EAGAIN || errno == EINTR) ? count : -1;
+    }
+
+    for (ssize_t i = 0; i < result; i++)
+    {
+        char c = buffer[i];
+        if (c == '\r')
+        {
+            continue;
+        }
+        if (c != '\n')
+        {
+            rx_line.push_back(c);
+            continue;
+        }
+        if (rx_line.empty())
+        {
+            continue;
+        }
+        lines.push_back(std::string());
+        lines.back().swap(rx_line);
+        count++;
+    }
+    return count;
+}
+
+SERIAL_PORT_TEMPLATE
+int
+SERIAL_PORT_CLASS::
+file_descriptor()
+{
+    return fd;
 }
 
 // ------------------------------------------------------------------------------
 //   Write to Serial
 // ------------------------------------------------------------------------------
+SERIAL_PORT_TEMPLATE
 int
-Serial_Port::
-write_message(const std::string message)
+SERIAL_PORT_CLASS::
+write_message(const std::string &message)
 {
     // Write buffer to serial port, locks port while writing
     int bytesWritten = _write_port(message.c_str(), message.size());
     return bytesWritten;
 }
 
+SERIAL_PORT_TEMPLATE
+int
+SERIAL_PORT_CLASS::
+write_message(const char *buf, unsigned len)
+{
+    return _write_port(buf, len);
+}
+
 
 // ------------------------------------------------------------------------------
 //   Open Serial Port
@@ -157,42 +289,76 @@ write_message(const std::string message)
 /**
  * throws EXIT_FAILURE if could not open the port
  */
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 open_serial()
 {
 
     // --------------------------------------------------------------------------
     //   OPEN PORT
     // --------------------------------------------------------------------------
-    printf("OPEN PORT\n");
+    fprintf(stderr, "OPEN PORT\n");
+
+    uint64_t stale; // an interrupt() after the last read
+    ssize_t drained = read(wake_fd, &stale, sizeof(stale));
+    (void)drained;
+
+    if (!try_open())
+    {
+        fprintf(stderr, "failure, could not open port %s.\n", uart_name.c_str());
+        throw EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "\n");
+
+    return;
+
+}
+
+/**
+ * open_serial() without the messages, for the reconnect loop: false if the
+ * port is not there (yet) or could not be configured
+ */
+SERIAL_PORT_TEMPLATE
+bool
+SERIAL_PORT_CLASS::
+try_open()
+{
+    if (status == SERIAL_PORT_OPEN)
+    {
+        close_serial();
+    }
 
-    fd = _open_port(uart_name);
+    // writers may be running (the reconnect happens under them)
+    pthread_mutex_lock(&write_lock);
+
+    rx_buffer.clear();
+    rx_line.clear();
+    rx_line_start = 0;
+    fd = _open_port(uart_name.c_str());
 
     // Check success
     if (fd == -1)
     {
-        printf("failure, could not open port.\n");
-        throw EXIT_FAILURE;
+        pthread_mutex_unlock(&write_lock);
+        return false;
     }
 
     // --------------------------------------------------------------------------
     //   SETUP PORT
     // --------------------------------------------------------------------------
-    bool success = _setup_port(baudrate, 8, 1, false, false);
+    bool success = _setup_port(baudrate);
 
     // --------------------------------------------------------------------------
     //   CHECK STATUS
     // --------------------------------------------------------------------------
     if (!success)
     {
-        printf("failure, could not configure port.\n");
-        throw EXIT_FAILURE;
-    }
-    if (fd <= 0)
-    {
-        printf("Connection attempt to port %s with %d baud, 8N1 failed, exiting.\n", uart_name, baudrate);
-        throw EXIT_FAILURE;
+        close(fd);
+        fd = -1;
+        pthread_mutex_unlock(&write_lock);
+        return false;
     }
 
     // --------------------------------------------------------------------------
@@ -201,50 +367,152 @@ open_serial()
     // printf("Connected to %s with %d baud, 8 data bits, no parity, 1 stop bit (8N1)\n", uart_name, baudrate);
     // lastStatus.packet_rx_drop_count = 0;
 
-    status = true;
+    status = SERIAL_PORT_OPEN;
+    pthread_mutex_unlock(&write_lock);
 
-    printf("\n");
-
-    return;
+    // watches of the last outage
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+        inotify_fd = -1;
+        dir_watch  = -1;
+        dev_watch  = -1;
+    }
 
+    return true;
 }
 
 
 // ------------------------------------------------------------------------------
 //   Close Serial Port
 // ------------------------------------------------------------------------------
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 close_serial()
 {
-    printf("CLOSE PORT\n");
+    pthread_mutex_lock(&write_lock);
+    if (fd < 0)
+    {
+        pthread_mutex_unlock(&write_lock);
+        return;
+    }
+
+    fprintf(stderr, "CLOSE PORT\n");
 
     int result = close(fd);
+    fd = -1;
 
     if ( result )
     {
         fprintf(stderr,"WARNING: Error on port close (%i)\n", result );
     }
 
-    status = false;
+    status = SERIAL_PORT_CLOSED;
+    pthread_mutex_unlock(&write_lock);
 
-    printf("\n");
+    fprintf(stderr, "\n");
 
 }
 
 
+// ------------------------------------------------------------------------------
+//   Wait For Device
+// ------------------------------------------------------------------------------
+/**
+ * Waits up to timeout_ms for the port to (re)appear. The directory of the
+ * port is watched with inotify for its name being created, renamed in or
+ * having its attributes changed (udev sets the permissions after the node
+ * shows up). Since that directory may itself come and go (/dev/serial/by-id
+ * goes away with the last adapter), /dev is watched too, and any node
+ * created there counts. Returns 1 on such an event, 0 on timeout or
+ * interrupt().
+ */
+SERIAL_PORT_TEMPLATE
+int
+SERIAL_PORT_CLASS::
+wait_for_device(int timeout_ms)
+{
+    std::string dir  = ".";
+    std::string name = uart_name;
+    size_t slash = uart_name.rfind('/');
+    if (slash != std::string::npos)
+    {
+        dir  = (slash == 0) ? "/" : uart_name.substr(0, slash);
+        name = uart_name.substr(slash + 1);
+    }
+
+    if (inotify_fd < 0)
+    {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if (inotify_fd >= 0 && dir_watch < 0)
+    {
+        dir_watch = inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+    }
+    if (inotify_fd >= 0 && dev_watch < 0 && dir != "/dev")
+    {
+        dev_watch = inotify_add_watch(inotify_fd, "/dev", IN_CREATE);
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd     = inotify_fd; // ignored by poll() when -1
+    fds[0].events = POLLIN;
+    fds[1].fd     = wake_fd;
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, timeout_ms) <= 0)
+    {
+        return 0;
+    }
+    if (fds[1].revents & POLLIN)
+    {
+        uint64_t count;
+        ssize_t drained = read(wake_fd, &count, sizeof(count));
+        (void)drained;
+        return 0;
+    }
+
+    bool appeared = false;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(inotify_fd, events, sizeof(events))) > 0)
+    {
+        for (char *p = events; p < events + len; )
+        {
+            const struct inotify_event *event = (const struct inotify_event*)p;
+            if (event->wd == dir_watch && (event->mask & IN_IGNORED))
+            {
+                dir_watch = -1; // the directory went away, watched again next time
+            }
+            else if (event->wd == dev_watch)
+            {
+                appeared = true;
+            }
+            else if (event->wd == dir_watch && event->len && name == event->name)
+            {
+                appeared = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return appeared ? 1 : 0;
+}
+
+
 // ------------------------------------------------------------------------------
 //   Convenience Functions
 // ------------------------------------------------------------------------------
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 start()
 {
     open_serial();
 }
 
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 stop()
 {
     close_serial();
@@ -254,8 +522,9 @@ stop()
 // ------------------------------------------------------------------------------
 //   Quit Handler
 // ------------------------------------------------------------------------------
+SERIAL_PORT_TEMPLATE
 void
-Serial_Port::
+SERIAL_PORT_CLASS::
 handle_quit()
 {
     try {
@@ -267,12 +536,24 @@ handle_quit()
 }
 
 
+SERIAL_PORT_TEMPLATE
+void
+SERIAL_PORT_CLASS::
+interrupt()
+{
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+
 // ------------------------------------------------------------------------------
 //   Helper Function - Open Serial Port File Descriptor
 // ------------------------------------------------------------------------------
 // Where the actual port opening happens, returns file descriptor 'fd'
+SERIAL_PORT_TEMPLATE
 int
-Serial_Port::
+SERIAL_PORT_CLASS::
 _open_port(const char* port)
 {
     // Open serial port
@@ -301,9 +582,10 @@ _open_port(const char* port)
 //   Helper Function - Setup Serial Port
 // ------------------------------------------------------------------------------
 // Sets configuration, flags, and baud rate
+SERIAL_PORT_TEMPLATE
 bool
-Serial_Port::
-_setup_port(int baud, int data_bits, int stop_bits, bool parity, bool hardware_control)
+SERIAL_PORT_CLASS::
+_setup_port(int baud)
 {
     // Check file descriptor
     if(!isatty(fd))
@@ -349,16 +631,12 @@ _setup_port(int baud, int data_bits, int stop_bits, bool parity, bool hardware_c
     // extended input processing off, signal chars off
     config.c_lflag &= ~(ECHO | ECHONL | ICANON | IEXTEN | ISIG);
 
-    // Turn off character processing
-    // clear current char size mask, no parity checking,
-    // no output processing, force 8 bit input
-    config.c_cflag &= ~(CSIZE | PARENB);
-    config.c_cflag |= CS8;
-
-    // One input byte is enough to return from read()
-    // Inter-character timer off
-    config.c_cc[VMIN]  = 1;
-    config.c_cc[VTIME] = 10; // was 0
+    // Character size, parity and stop bits, RTS/CTS, then VMIN/VTIME of
+    // the read strategy (Poll_Read: read() never blocks, read_message waits
+    // in poll() when it returns 0, so interrupt() can end the wait)
+    Framing::configure(config);
+    Flow::configure(config);
+    Read::configure(config);
 
     // Get the current options for the port
     ////struct termios options;
@@ -407,6 +685,13 @@ _setup_port(int baud, int data_bits, int stop_bits, bool parity, bool hardware_c
                 return false;
             }
             break;
+        case 230400:
+            if (cfsetispeed(&config, B230400) < 0 || cfsetospeed(&config, B230400) < 0)
+            {
+                fprintf(stderr, "\nERROR: Could not set desired baud rate of %d Baud\n", baud);
+                return false;
+            }
+            break;
 
         // These two non-standard (by the 70'ties ) rates are fully supported on
         // current Debian and Mac OS versions (tested since 2010).
@@ -445,35 +730,82 @@ _setup_port(int baud, int data_bits, int stop_bits, bool parity, bool hardware_c
 
 
 // ------------------------------------------------------------------------------
-//   Read Port with Lock
+//   Read policies - wait for the port
 // ------------------------------------------------------------------------------
-int
-Serial_Port::
-_read_port(uint8_t &cp)
+// true when the tty hung up: a read() of 0 bytes from it is not "no data"
+static bool
+hung_up(int fd)
 {
+    struct pollfd fds;
+    fds.fd     = fd;
+    fds.events = POLLIN;
+    return poll(&fds, 1, 0) > 0 && (fds.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
 
-    // Lock
-    pthread_mutex_lock(&lock);
-
-    int result = read(fd, &cp, 1);
+// the read already waited VTIME (or returned at once on a hangup)
+int
+Blocking_Read::
+wait(int fd, int wake_fd)
+{
+    (void)wake_fd;
+    return hung_up(fd) ? -1 : 0;
+}
 
-    // Unlock
-    pthread_mutex_unlock(&lock);
+// after a read with nothing buffered: wait for a byte, interrupt() or the
+// poll timeout; -1 when the port hung up
+int
+Poll_Read::
+wait(int fd, int wake_fd)
+{
+    struct pollfd fds[2];
+    fds[0].fd     = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = wake_fd;
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, SERIAL_PORT_POLL_MS) > 0)
+    {
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t count;
+            ssize_t drained = read(wake_fd, &count, sizeof(count));
+            (void)drained;
+        }
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            return -1; // unplugged, the caller backs off
+        }
+    }
+    return 0;
+}
 
-    return result;
+// no wait; a poll() for the hangup every SERIAL_PORT_BUSY_HUP empty reads
+// (per read thread)
+int
+Busy_Poll_Read::
+wait(int fd, int wake_fd)
+{
+    (void)wake_fd;
+    static thread_local unsigned empty_reads = 0;
+    if (++empty_reads < SERIAL_PORT_BUSY_HUP)
+    {
+        return 0;
+    }
+    empty_reads = 0;
+    return hung_up(fd) ? -1 : 0;
 }
 
 
 // ------------------------------------------------------------------------------
 //   Write Port with Lock
 // ------------------------------------------------------------------------------
+SERIAL_PORT_TEMPLATE
 int
-Serial_Port::
+SERIAL_PORT_CLASS::
 _write_port(const char *buf, unsigned len)
 {
 
     // Lock
-    pthread_mutex_lock(&lock);
+    pthread_mutex_lock(&write_lock);
 
     // Write packet via serial link
     const int bytesWritten = static_cast<int>(write(fd, buf, len));
@@ -482,8 +814,25 @@ _write_port(const char *buf, unsigned len)
     tcdrain(fd);
 
     // Unlock
-    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&write_lock);
 
 
     return bytesWritten;
 }
+
+
+// ------------------------------------------------------------------------------
+//   Instances
+// ------------------------------------------------------------------------------
+// every read strategy, buffer and flow control of the configured framing
+// (Serial_Port is one of them); bench.cpp times each on a pty
+#define SERIAL_PORT_INSTANCE(READ, BUFFER) \
+    template class Basic_Serial_Port<SERIAL_PORT_FRAMING, No_Flow_Control, READ, BUFFER>; \
+    template class Basic_Serial_Port<SERIAL_PORT_FRAMING, Rts_Cts_Flow, READ, BUFFER>;
+
+SERIAL_PORT_INSTANCE(Blocking_Read,  Byte_Buffer)
+SERIAL_PORT_INSTANCE(Blocking_Read,  Chunk_Buffer)
+SERIAL_PORT_INSTANCE(Poll_Read,      Byte_Buffer)
+SERIAL_PORT_INSTANCE(Poll_Read,      Chunk_Buffer)
+SERIAL_PORT_INSTANCE(Busy_Poll_Read, Byte_Buffer)
+SERIAL_PORT_INSTANCE(Busy_Poll_Read, Chunk_Buffer)
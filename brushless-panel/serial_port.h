@@ -16,6 +16,8 @@
 #include <signal.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
+#include <atomic>
 
 // ------------------------------------------------------------------------------
 //   Defines
@@ -33,17 +35,140 @@
 
 
 // Status flags
-#define SERIAL_PORT_OPEN   1;
-#define SERIAL_PORT_CLOSED 0;
-#define SERIAL_PORT_ERROR -1;
+#define SERIAL_PORT_OPEN   1
+#define SERIAL_PORT_CLOSED 0
+#define SERIAL_PORT_ERROR -1
+
+#define SERIAL_PORT_POLL_MS 100 // longest wait for a byte on a quiet port
+#define SERIAL_PORT_CHUNK   4096 // bytes per read() with Chunk_Buffer
+#define SERIAL_PORT_BUSY_HUP 1024 // empty reads between hangup checks (Busy_Poll_Read)
+
+#define SERIAL_PARITY_NONE 0
+#define SERIAL_PARITY_EVEN 1
+#define SERIAL_PARITY_ODD  2
+
+// the policies of Serial_Port, see below; e.g. SERIAL_FLAGS=-DSERIAL_PORT_READ=Busy_Poll_Read
+#ifndef SERIAL_PORT_FRAMING
+#define SERIAL_PORT_FRAMING Framing_8N1
+#endif
+
+#ifndef SERIAL_PORT_FLOW
+#define SERIAL_PORT_FLOW No_Flow_Control
+#endif
+
+#ifndef SERIAL_PORT_READ
+#define SERIAL_PORT_READ Poll_Read
+#endif
+
+#ifndef SERIAL_PORT_BUFFER
+#define SERIAL_PORT_BUFFER Chunk_Buffer
+#endif
 
 
 // ------------------------------------------------------------------------------
-//   Prototypes
+//   Policies
 // ------------------------------------------------------------------------------
+/*
+ * Framing and flow control only change the termios of the port. The read
+ * strategy sets VMIN/VTIME and what happens when a read comes back empty:
+ *
+ *   Blocking_Read   VTIME: the read itself waits in the tty driver, up to
+ *                   SERIAL_PORT_POLL_MS; interrupt() does not cut it short
+ *   Poll_Read       read() never waits, poll() on the port and the
+ *                   interrupt() eventfd does (the default)
+ *   Busy_Poll_Read  read() never waits and nothing else does either: the
+ *                   read loop spins on a core, for the lowest latency
+ *
+ * A hung-up tty (adapter unplugged) reads 0 bytes at once, like an empty
+ * one; every wait() tells them apart by POLLHUP/POLLERR and returns -1, so
+ * the caller sees the link go with any of the three (Busy_Poll_Read only
+ * every SERIAL_PORT_BUSY_HUP empty reads, a poll() on each would double
+ * the syscalls of the spin).
+ *
+ * The buffer is where read_message() takes its bytes from: Byte_Buffer is
+ * a read() per byte, Chunk_Buffer a read() of what the driver has (up to
+ * SERIAL_PORT_CHUNK), then lines out of it without a syscall.
+ */
+template <int DATA_BITS, int PARITY, int STOP_BITS>
+struct Serial_Framing
+{
+    static void configure(struct termios &config)
+    {
+        config.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+        config.c_cflag |= (DATA_BITS == 5) ? CS5 : (DATA_BITS == 6) ? CS6 : (DATA_BITS == 7) ? CS7 : CS8;
+        config.c_cflag |= (PARITY != SERIAL_PARITY_NONE) ? PARENB : 0;
+        config.c_cflag |= (PARITY == SERIAL_PARITY_ODD) ? PARODD : 0;
+        config.c_cflag |= (STOP_BITS == 2) ? CSTOPB : 0;
+        config.c_iflag |= (PARITY != SERIAL_PARITY_NONE) ? INPCK : 0;
+    }
+};
 
-//class Serial_Port;
+typedef Serial_Framing<8, SERIAL_PARITY_NONE, 1> Framing_8N1;
+typedef Serial_Framing<8, SERIAL_PARITY_EVEN, 1> Framing_8E1;
+typedef Serial_Framing<7, SERIAL_PARITY_EVEN, 1> Framing_7E1;
 
+struct No_Flow_Control
+{
+    static void configure(struct termios &config) { config.c_cflag &= ~CRTSCTS; config.c_iflag &= ~(IXON | IXOFF); }
+};
+
+struct Rts_Cts_Flow
+{
+    static void configure(struct termios &config) { config.c_cflag |= CRTSCTS; config.c_iflag &= ~(IXON | IXOFF); }
+};
+
+struct Blocking_Read
+{
+    static void configure(struct termios &config)
+    {
+        config.c_cc[VMIN]  = 0;
+        config.c_cc[VTIME] = SERIAL_PORT_POLL_MS/100;
+    }
+    static int wait(int fd, int wake_fd); // -1: hung up
+};
+
+struct Poll_Read
+{
+    static void configure(struct termios &config)
+    {
+        config.c_cc[VMIN]  = 0;
+        config.c_cc[VTIME] = 0;
+    }
+    static int wait(int fd, int wake_fd); // -1: hung up
+};
+
+struct Busy_Poll_Read
+{
+    static void configure(struct termios &config)
+    {
+        config.c_cc[VMIN]  = 0;
+        config.c_cc[VTIME] = 0;
+    }
+    static int wait(int fd, int wake_fd); // -1: hung up
+};
+
+struct Byte_Buffer
+{
+    uint8_t byte;
+    bool    full;
+
+    Byte_Buffer() : byte(0), full(false) {}
+    void clear() { full = false; }
+    int  fill(int fd) { ssize_t n = read(fd, &byte, 1); full = (n == 1); return (int)n; }
+    bool next(uint8_t &c) { if (!full) return false; c = byte; full = false; return true; }
+};
+
+struct Chunk_Buffer
+{
+    uint8_t data[SERIAL_PORT_CHUNK];
+    int     head;
+    int     tail;
+
+    Chunk_Buffer() : head(0), tail(0) {}
+    void clear() { head = tail = 0; }
+    int  fill(int fd) { ssize_t n = read(fd, data, sizeof(data)); head = 0; tail = (n > 0) ? (int)n : 0; return (int)n; }
+    bool next(uint8_t &c) { if (head == tail) return false; c = data[head++]; return true; }
+};
 
 
 // ----------------------------------------------------------------------------------
@@ -56,47 +181,86 @@
  * serial port over which we'll communicate.  It also has methods to write
  * a byte stream buffer.  MAVlink is not used in this object yet, it's just
  * a serialization interface.  To help with read and write pthreading, it
- * gaurds any port operation with a pthread mutex.
+ * gaurds reads and writes with one pthread mutex each (the tty directions
+ * are independent, so a writer never waits behind the read loop).
+ *
+ * With Poll_Read, a read with nothing buffered waits in poll() on the port
+ * and on an eventfd; interrupt() signals the eventfd so the thread stopping
+ * the read loop does not wait out SERIAL_PORT_POLL_MS. The port is closed
+ * by the destructor if it is still open.
+ *
+ * try_open() and wait_for_device() are what BrushlessSerial reconnects
+ * with when the adapter goes away: the open swaps fd under the write
+ * lock, so other threads may keep calling write_message() meanwhile (it
+ * fails while the port is closed). status may be read from any thread.
+ *
+ * The framing, flow control, read strategy and buffer are template
+ * policies (above), resolved at compile time, so the read loop has no
+ * virtual call or branch on the configuration. Serial_Port is the one the
+ * builds use, chosen with the SERIAL_PORT_* defines; serial_port.cpp
+ * instantiates every read/buffer/flow combination of that framing, which
+ * bench.cpp measures on a pty.
  */
-class Serial_Port
+template <class Framing, class Flow, class Read, class Buffer>
+class Basic_Serial_Port
 {
 
 public:
 
-    Serial_Port();
-    Serial_Port(const char *uart_name_, int baudrate_);
+    Basic_Serial_Port();
+    Basic_Serial_Port(const char *uart_name_, int baudrate_);
     void initialize_defaults();
-    ~Serial_Port();
+    ~Basic_Serial_Port();
 
     bool debug;
-    const char *uart_name;
+    std::string uart_name;
     int  baudrate;
-    int  status;
+    std::atomic<int> status;
 
-    int read_message(/*mavlink_message_t &message*/);
-    int write_message(const std::string message);
+    int read_message(std::string &message);
+    int read_lines(std::vector<std::string> &lines);
+    int file_descriptor(); // -1 while closed
+    int write_message(const std::string &message);
+    int write_message(const char *buf, unsigned len);
 
     void open_serial();
     void close_serial();
+    bool try_open();
+
+    // inotify wait for the port to show up again, see serial_port.cpp
+    int  wait_for_device(int timeout_ms);
 
     void start();
     void stop();
 
     void handle_quit();
 
+    // wakes a read waiting on the port (it returns 0)
+    void interrupt();
+
 private:
 
     int  fd;
+    int  wake_fd; // eventfd, see interrupt()
+    int  inotify_fd; // wait_for_device(), -1 while the port is open
+    int  dir_watch;
+    int  dev_watch;
+    Buffer rx_buffer; // read, not yet parsed (read thread)
+    std::string rx_line; // partial line, completed by read_message
+    uint64_t rx_line_start; // trace_now() of its first byte (0: not traced)
     // mavlink_status_t lastStatus;
-    pthread_mutex_t  lock;
+    pthread_mutex_t  lock;       // reads
+    pthread_mutex_t  write_lock; // writes, so a blocked read never delays them
 
     int  _open_port(const char* port);
-    bool _setup_port(int baud, int data_bits, int stop_bits, bool parity, bool hardware_control);
-    int  _read_port(uint8_t &cp);
-    int _write_port(const char *buf, unsigned len);
+    bool _setup_port(int baud);
+    int  _write_port(const char *buf, unsigned len);
+    int  _line_byte(uint8_t cp, std::string &message);
 
 };
 
+typedef Basic_Serial_Port<SERIAL_PORT_FRAMING, SERIAL_PORT_FLOW, SERIAL_PORT_READ, SERIAL_PORT_BUFFER> Serial_Port;
+
 
 
 #endif // SERIAL_PORT_H_
@@ -0,0 +1,330 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "strip_plot.h"
+#include "plot_decimation.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Strip_Plot::
+Strip_Plot()
+{
+    hold        = false;
+    held        = false;
+    window      = 0;
+    valid       = false;
+    point_count = 0;
+    reset_view();
+}
+
+void
+Strip_Plot::
+reset_view()
+{
+    span      = 0;
+    end_age   = 0;
+    cursor[0] = -1;
+    cursor[1] = -1;
+    valid     = false;
+}
+
+int
+Strip_Plot::
+points() const
+{
+    return point_count;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Draw
+// ------------------------------------------------------------------------------
+void
+Strip_Plot::
+draw(const char *id, const Strip_Channel *channels, int n, uint32_t version,
+     float ymin, float ymax, double period, const ImVec2 &size)
+{
+    n = std::min(n, STRIP_PLOT_CHANNELS);
+
+    // hold: measures on a copy of the rings as they were when it was set
+    if (hold && !held)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            const Strip_Channel &ch = channels[k];
+            frozen_ring[k].resize(ch.count);
+            for (int i = 0; i < ch.count; i++)
+            {
+                frozen_ring[k][i] = ch.ring[(ch.offset + i) % ch.capacity];
+            }
+            frozen[k]          = ch;
+            frozen[k].ring     = frozen_ring[k].data();
+            frozen[k].capacity = std::max(1, ch.count);
+            frozen[k].offset   = 0;
+        }
+        held  = true;
+        valid = false;
+    }
+    else if (!hold && held)
+    {
+        held  = false;
+        valid = false;
+    }
+    const Strip_Channel *data = held ? frozen : channels;
+    const int count = (n > 0) ? data[0].count : 0;
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImVec2 p0 = ImGui::GetCursorScreenPos();
+    const float left = 40;                      // y labels
+    const float top  = ImGui::GetTextLineHeight(); // legend and cursors
+    ImVec2 a(p0.x + left, p0.y + top);
+    ImVec2 b(p0.x + size.x, p0.y + size.y - 14);
+    ImGui::InvisibleButton(id, size);
+    const bool hovered = ImGui::IsItemHovered();
+    if (b.x - a.x < 1 || b.y - a.y < 1)
+    {
+        return;
+    }
+    // view: from STRIP_PLOT_MIN_SPAN to the whole history, or the window
+    // while the history is shorter (empty on the left)
+    const double longest = std::max(1.0, std::max((double)count, (double)window));
+    if (hovered)
+    {
+        input(a, b, longest);
+    }
+    const double shortest = std::min((double)STRIP_PLOT_MIN_SPAN, longest);
+    const double initial  = (window > 0) ? window : longest;
+    span    = std::max(shortest, std::min((span > 0) ? span : initial, longest));
+    end_age = std::max(0.0, std::min(end_age, count - span));
+
+    if (!valid || (!held && version != cached_version) || n != cached_n ||
+        a.x != cached_a.x || a.y != cached_a.y || b.x != cached_b.x || b.y != cached_b.y ||
+        span != cached_span || end_age != cached_end)
+    {
+        decimate(data, n, a, b, ymin, ymax);
+        valid          = true;
+        cached_version = version;
+        cached_n       = n;
+        cached_a       = a;
+        cached_b       = b;
+        cached_span    = span;
+        cached_end     = end_age;
+    }
+
+    const float  width = b.x - a.x;
+    const double first = count - end_age - span;
+    auto x_of = [&](double index){ return a.x + (float)((index - first)/span)*width; };
+    auto y_of = [&](float v){ return b.y - (v - ymin)/(ymax - ymin)*(b.y - a.y); };
+
+    const ImU32 frame = ImColor(120, 120, 120);
+    const ImU32 minor = ImColor(70, 70, 70);
+    const ImU32 label = ImColor(200, 200, 200);
+    draw_list->AddRectFilled(a, b, ImColor(30, 30, 30));
+
+    // grid: 4 rows, and time ticks of 1, 2 or 5 x 10^k s about 80 px apart
+    for (int r = 0; r <= 4; r++)
+    {
+        float v = ymin + (ymax - ymin)*r/4;
+        float y = y_of(v);
+        draw_list->AddLine(ImVec2(a.x, y), ImVec2(b.x, y), minor);
+        char text[16];
+        snprintf(text, sizeof(text), "%.0f", v);
+        draw_list->AddText(ImVec2(p0.x, y - 7), label, text);
+    }
+    if (count > 0 && period > 0)
+    {
+        double seconds = span*period;
+        double step = pow(10, floor(log10(seconds*80/width)));
+        step *= (seconds*80/width > 5*step) ? 5 : (seconds*80/width > 2*step) ? 2 : 1;
+        for (double t = step*ceil(end_age*period/step); t <= (end_age + span)*period; t += step)
+        {
+            float x = x_of(count - 1 - t/period);
+            draw_list->AddLine(ImVec2(x, a.y), ImVec2(x, b.y), minor);
+            char text[16];
+            snprintf(text, sizeof(text), "%g", -t);
+            draw_list->AddText(ImVec2(x - 8, b.y + 1), label, text);
+        }
+    }
+    draw_list->AddRect(a, b, frame);
+
+    for (int k = 0; k < n; k++)
+    {
+        if (line[k].size() > 1)
+        {
+            draw_list->AddPolyline(line[k].data(), (int)line[k].size(), ImColor(data[k].color), false, 1.0f, true);
+        }
+    }
+
+    // legend, then the cursors: values of the first channel, A - B
+    float text_x = a.x;
+    for (int k = 0; k < n; k++)
+    {
+        draw_list->AddText(ImVec2(text_x, p0.y), ImColor(data[k].color), data[k].name);
+        text_x += ImGui::CalcTextSize(data[k].name).x + 12;
+    }
+    const ImU32 cursor_color[2] = {ImColor(255, 255, 255), ImColor(80, 200, 255)};
+    char text[128];
+    for (int c = 0; c < 2 && n > 0; c++)
+    {
+        if (cursor[c] < 0 || cursor[c] >= count)
+        {
+            continue;
+        }
+        float x = x_of(count - 1 - cursor[c]);
+        if (x >= a.x && x <= b.x)
+        {
+            draw_list->AddLine(ImVec2(x, a.y), ImVec2(x, b.y), cursor_color[c]);
+        }
+        float v = ring_value(data[0].ring, data[0].capacity, data[0].offset, count, cursor[c]);
+        snprintf(text, sizeof(text), "%c %.2f s %.0f", "AB"[c], -cursor[c]*period, v);
+        draw_list->AddText(ImVec2(text_x, p0.y), cursor_color[c], text);
+        text_x += ImGui::CalcTextSize(text).x + 12;
+    }
+    if (n > 0 && cursor[0] >= 0 && cursor[1] >= 0 && cursor[0] < count && cursor[1] < count)
+    {
+        float va = ring_value(data[0].ring, data[0].capacity, data[0].offset, count, cursor[0]);
+        float vb = ring_value(data[0].ring, data[0].capacity, data[0].offset, count, cursor[1]);
+        snprintf(text, sizeof(text), "B-A %.3f s %+.0f", (cursor[0] - cursor[1])*period, vb - va);
+        draw_list->AddText(ImVec2(text_x, p0.y), label, text);
+    }
+
+    // hover: the sample under the mouse only
+    if (hovered && count > 0)
+    {
+        float mx  = ImGui::GetIO().MousePos.x;
+        int   age = (int)lround(end_age + (b.x - mx)/width*span);
+        age = std::max(0, std::min(age, count - 1));
+        float x = x_of(count - 1 - age);
+        draw_list->AddLine(ImVec2(x, a.y), ImVec2(x, b.y), frame);
+
+        int len = snprintf(text, sizeof(text), "%.2f s", -age*period);
+        for (int k = 0; k < n && len < (int)sizeof(text); k++)
+        {
+            len += snprintf(text + len, sizeof(text) - len, "\n%s %.0f", data[k].name,
+                            ring_value(data[k].ring, data[k].capacity, data[k].offset, data[k].count, age));
+        }
+        ImGui::SetTooltip("%s", text);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Input
+// ------------------------------------------------------------------------------
+void
+Strip_Plot::
+input(const ImVec2 &a, const ImVec2 &b, double longest)
+{
+    ImGuiIO &io = ImGui::GetIO();
+    const double width   = b.x - a.x;
+    const double current = (span > 0) ? span : (window > 0) ? window : longest;
+    const double mouse   = std::max(0.0, std::min(1.0, (io.MousePos.x - a.x)/width)); // 0: left edge
+    const int    age     = (int)lround(end_age + (1 - mouse)*current);
+
+    if (io.MouseWheel != 0)
+    {
+        if (io.KeyShift)
+        {
+            end_age -= 0.1*io.MouseWheel*current; // up: towards the newest
+        }
+        else
+        {
+            // the sample under the mouse stays there
+            double at = end_age + (1 - mouse)*current;
+            span    = current*pow(STRIP_PLOT_ZOOM, io.MouseWheel);
+            span    = std::max(std::min((double)STRIP_PLOT_MIN_SPAN, longest), std::min(span, longest));
+            end_age = at - (1 - mouse)*span;
+        }
+    }
+
+    if (ImGui::IsMouseDoubleClicked(0))
+    {
+        reset_view();
+    }
+    else if (ImGui::IsMouseClicked(0))
+    {
+        cursor[0] = age;
+    }
+    if (ImGui::IsMouseClicked(1))
+    {
+        cursor[1] = age;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Decimation
+// ------------------------------------------------------------------------------
+void
+Strip_Plot::
+decimate(const Strip_Channel *channels, int n, const ImVec2 &a, const ImVec2 &b, float ymin, float ymax)
+{
+    const float  width   = b.x - a.x;
+    const int    columns = std::max(1, (int)width);
+    auto y_of = [&](float v){
+        float t = (v - ymin)/(ymax - ymin);
+        t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+        return b.y - t*(b.y - a.y);
+    };
+
+    point_count = 0;
+    for (int k = 0; k < n; k++)
+    {
+        const Strip_Channel &ch = channels[k];
+        const double first = ch.count - end_age - span;
+        std::vector<ImVec2> &points = line[k];
+        points.clear();
+        if (ch.count <= 0)
+        {
+            continue;
+        }
+
+        if (span > columns)
+        {
+            // two points per column, starting on the side nearest the last
+            // one; the columns left of the oldest sample stay empty
+            int c0 = (first < 0) ? (int)ceil(-first/span*columns) : 0;
+            if (c0 >= columns)
+            {
+                continue;
+            }
+            column_min[k].resize(columns);
+            column_max[k].resize(columns);
+            decimate_min_max(ch.ring, ch.capacity, ch.offset, ch.count, first + span*c0/columns,
+                             span*(columns - c0)/columns, columns - c0,
+                             &column_min[k][c0], &column_max[k][c0]);
+            for (int c = c0; c < columns; c++)
+            {
+                float x  = a.x + c + 0.5f;
+                float lo = y_of(column_min[k][c]);
+                float hi = y_of(column_max[k][c]);
+                bool  low_first = !points.empty() && fabsf(points.back().y - lo) < fabsf(points.back().y - hi);
+                points.push_back(ImVec2(x, low_first ? lo : hi));
+                if (lo != hi)
+                {
+                    points.push_back(ImVec2(x, low_first ? hi : lo));
+                }
+            }
+        }
+        else
+        {
+            // zoomed in: every sample in view, fewer than the columns
+            int i0 = std::max(0, (int)floor(first));
+            int i1 = std::min(ch.count - 1, (int)ceil(first + span));
+            for (int i = i0; i <= i1; i++)
+            {
+                float x = a.x + (float)((i - first)/span)*width;
+                points.push_back(ImVec2(std::max(a.x, std::min(x, b.x)),
+                                        y_of(ch.ring[(ch.offset + i) % ch.capacity])));
+            }
+        }
+        point_count += (int)points.size();
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef STRIP_PLOT_H_
+#define STRIP_PLOT_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <vector>
+#include <imgui.h>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define STRIP_PLOT_CHANNELS 4
+#define STRIP_PLOT_MIN_SPAN 16   // samples across the plot at the deepest zoom
+#define STRIP_PLOT_ZOOM     0.8  // span factor per wheel notch
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+struct Strip_Channel
+{
+    const char  *name;
+    ImVec4       color;
+    const float *ring;     // count values from offset, wrapping at capacity
+    int          capacity; // (a Sample_View column)
+    int          offset;
+    int          count;
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Strip Plot Class
+// ----------------------------------------------------------------------------------
+/*
+ * Strip Plot Class
+ *
+ * Draw list plot of a few channels of the telemetry ring, in place of
+ * ImGui::PlotLines (a segment per sample, and the hover lookup per
+ * point). Each channel is decimated to the min and max of every pixel
+ * column (plot_decimation.h) before anything reaches the draw list, so
+ * a channel costs at most two points per column however many samples
+ * the view spans. The columns and points are kept in member buffers and
+ * only recomputed when `version` (the last seq), the view or the plot
+ * rectangle change, so a frame without new samples submits the cached
+ * lines. The channels are read in place (Sample_View columns), and only
+ * the columns of the view are visited.
+ *
+ * wheel: zoom around the mouse; shift + wheel: pan; left/right click:
+ * cursor A/B (values and time difference above the plot); double click:
+ * back to the last `window` samples, no cursors. Zooming out goes up to
+ * the whole history. The view and the cursors are in samples before
+ * the newest, so they scroll with the data; `hold` freezes a copy of the
+ * channels to measure on.
+ */
+class Strip_Plot
+{
+
+public:
+
+    Strip_Plot();
+
+    void draw(const char *id, const Strip_Channel *channels, int n, uint32_t version,
+              float ymin, float ymax, double period, const ImVec2 &size);
+    void reset_view();
+
+    bool hold;
+    int  window;         // samples across the plot after reset_view (0: all)
+    int  points() const; // polyline points submitted by the last draw
+
+private:
+
+    double span;      // samples across the plot, 0: window
+    double end_age;   // samples between the right edge and the newest
+    int    cursor[2]; // A and B, samples before the newest (-1: none)
+
+    // cache of the last decimation
+    bool     valid;
+    uint32_t cached_version;
+    ImVec2   cached_a, cached_b;
+    double   cached_span, cached_end;
+    int      cached_n;
+    std::vector<float>  column_min[STRIP_PLOT_CHANNELS];
+    std::vector<float>  column_max[STRIP_PLOT_CHANNELS];
+    std::vector<ImVec2> line[STRIP_PLOT_CHANNELS];
+    int      point_count;
+
+    // hold
+    bool          held;
+    Strip_Channel frozen[STRIP_PLOT_CHANNELS];
+    std::vector<float> frozen_ring[STRIP_PLOT_CHANNELS];
+
+    void input(const ImVec2 &a, const ImVec2 &b, double longest);
+    void decimate(const Strip_Channel *channels, int n, const ImVec2 &a, const ImVec2 &b,
+                  float ymin, float ymax);
+
+};
+
+
+#endif // STRIP_PLOT_H_
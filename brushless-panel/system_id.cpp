@@ -0,0 +1,269 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "system_id.h"
+
+#include <math.h>
+#include <string.h>
+#include <complex>
+#include <algorithm>
+
+// scaled units: krpm and 100us
+#define Y_SCALE 1e-3
+#define U_SCALE 1e-2
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+System_Id::
+System_Id(int delay_)
+{
+    delay = std::max(1, std::min(delay_, (int)MAXLAG - 2));
+    pthread_mutex_init(&lock, NULL);
+    reset_pending = false;
+    clear();
+}
+
+System_Id::
+~System_Id()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+// the next update() starts over (safe while the read thread runs)
+void
+System_Id::
+reset()
+{
+    pthread_mutex_lock(&lock);
+    reset_pending = true;
+    memset(&current, 0, sizeof(current));
+    pthread_mutex_unlock(&lock);
+}
+
+void
+System_Id::
+clear()
+{
+    memset(theta, 0, sizeof(theta));
+    memset(P, 0, sizeof(P));
+    for (int i = 0; i < IDENT_PARAMS; i++)
+    {
+        P[i][i] = IDENT_P0;
+    }
+    memset(y_hist, 0, sizeof(y_hist));
+    memset(u_hist, 0, sizeof(u_hist));
+    filled      = 0;
+    pending     = 0;
+    y_sum       = 0;
+    u_sum       = 0;
+    last_time   = -1;
+    updates     = 0;
+    start_time  = -1;
+    error2      = 0;
+    u_mean      = 0;
+    u_var       = 0;
+    drift_since = -1;
+    drifted     = false;
+    memset(&current, 0, sizeof(current));
+}
+
+
+// ------------------------------------------------------------------------------
+//   Recursive Least Squares
+// ------------------------------------------------------------------------------
+void
+System_Id::
+update(const Telemetry_Sample &sample)
+{
+    pthread_mutex_lock(&lock);
+    bool restart = reset_pending;
+    reset_pending = false;
+    pthread_mutex_unlock(&lock);
+    if (restart)
+    {
+        clear();
+    }
+
+    // lost lines or a firmware reset: the lags are no longer consecutive
+    if (last_time >= 0 && fabs(sample.time - last_time - TELEMETRY_TICK_PERIOD) > 0.5*TELEMETRY_TICK_PERIOD)
+    {
+        filled = 0;
+        pending = 0;
+    }
+    last_time = sample.time;
+
+    // block averages of IDENT_DECIMATE samples
+    y_sum += sample.rpm;
+    u_sum += sample.pulse;
+    if (++pending < IDENT_DECIMATE)
+    {
+        return;
+    }
+    const double y = Y_SCALE*y_sum/IDENT_DECIMATE;
+    const double u = U_SCALE*u_sum/IDENT_DECIMATE;
+    y_sum = u_sum = 0;
+    pending = 0;
+
+    if (filled > delay)
+    {
+        double phi[IDENT_PARAMS] = { -y_hist[0], -y_hist[1], u_hist[delay - 1], u_hist[delay], 1 };
+
+        double Pphi[IDENT_PARAMS];
+        double denom = IDENT_FORGET;
+        double prediction = 0;
+        for (int i = 0; i < IDENT_PARAMS; i++)
+        {
+            Pphi[i] = 0;
+            for (int j = 0; j < IDENT_PARAMS; j++)
+            {
+                Pphi[i] += P[i][j]*phi[j];
+            }
+            denom      += phi[i]*Pphi[i];
+            prediction += theta[i]*phi[i];
+        }
+
+        double error = y - prediction;
+        double trace = 0;
+        for (int i = 0; i < IDENT_PARAMS; i++)
+        {
+            double k = Pphi[i]/denom;
+            theta[i] += k*error;
+            for (int j = 0; j < IDENT_PARAMS; j++)
+            {
+                P[i][j] = (P[i][j] - k*Pphi[j])/IDENT_FORGET;
+            }
+        }
+        for (int i = 0; i < IDENT_PARAMS; i++)
+        {
+            for (int j = i + 1; j < IDENT_PARAMS; j++)
+            {
+                P[i][j] = P[j][i] = 0.5*(P[i][j] + P[j][i]);
+            }
+            trace += P[i][i];
+        }
+        if (trace > IDENT_TRACE_MAX)
+        {
+            double scale = IDENT_TRACE_MAX/trace;
+            for (int i = 0; i < IDENT_PARAMS; i++)
+            {
+                for (int j = 0; j < IDENT_PARAMS; j++)
+                {
+                    P[i][j] *= scale;
+                }
+            }
+        }
+
+        error2 = (updates == 0) ? error*error : 0.99*error2 + 0.01*error*error;
+        if (updates == 0)
+        {
+            start_time = sample.time;
+            u_mean     = u;
+        }
+        // input variance over the same memory as the estimate
+        double du = u - u_mean;
+        u_mean += (1 - IDENT_FORGET)*du;
+        u_var   = IDENT_FORGET*(u_var + (1 - IDENT_FORGET)*du*du);
+        updates++;
+        publish(sample.time);
+    }
+
+    // shift the lags
+    y_hist[1] = y_hist[0];
+    y_hist[0] = y;
+    memmove(&u_hist[1], &u_hist[0], (MAXLAG - 1)*sizeof(u_hist[0]));
+    u_hist[0] = u;
+    if (filled < MAXLAG)
+    {
+        filled++;
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Estimate
+// ------------------------------------------------------------------------------
+void
+System_Id::
+publish(double time)
+{
+    Identification id;
+    id.time    = time;
+    id.updates = updates;
+
+    const double a1 = theta[0];
+    const double a2 = theta[1];
+    id.theta[0] = a1;
+    id.theta[1] = a2;
+    id.theta[2] = theta[2]*U_SCALE/Y_SCALE;
+    id.theta[3] = theta[3]*U_SCALE/Y_SCALE;
+    id.theta[4] = theta[4]/Y_SCALE;
+
+    double den = 1 + a1 + a2;
+    id.gain  = (fabs(den) > 1e-9) ? (id.theta[2] + id.theta[3])/den : 0;
+    id.drift = id.gain/IDENT_NOMINAL_GAIN - 1;
+
+    // z^2 + a1 z + a2 = 0, s = ln(z)/T
+    std::complex<double> root = std::sqrt(std::complex<double>(a1*a1 - 4*a2, 0));
+    std::complex<double> z[2] = { 0.5*(-a1 + root), 0.5*(-a1 - root) };
+    for (int i = 0; i < 2; i++)
+    {
+        std::complex<double> s = (std::abs(z[i]) > 0) ? std::log(z[i])/IDENT_PERIOD
+                                                      : std::complex<double>(-INFINITY, 0);
+        id.pole_re[i] = z[i].real();
+        id.pole_im[i] = z[i].imag();
+        id.s_re[i]    = s.real();
+        id.s_im[i]    = s.imag();
+    }
+
+    id.error_rms = sqrt(error2)/Y_SCALE;
+    id.excitation = sqrt(u_var)/U_SCALE;
+    id.valid = (time - start_time >= IDENT_SETTLE) && id.excitation >= IDENT_EXCITATION
+               && std::isfinite(id.gain) && id.gain > 0;
+
+    // retuning: gN scales the controller gains, so the loop gain stays
+    // nominal with N = 100*nominal/estimated
+    id.retune_gain = id.valid ? std::max(1, std::min(1000, (int)lround(100/(1 + id.drift)))) : 100;
+
+    // without excitation the estimate is only held: keep the drift state
+    bool fire = false;
+    if (id.valid)
+    {
+        if (fabs(id.drift) <= IDENT_DRIFT)
+        {
+            drift_since = -1;
+            drifted     = false;
+        }
+        else if (drift_since < 0)
+        {
+            drift_since = time;
+        }
+        else if (!drifted && time - drift_since >= IDENT_DRIFT_HOLD)
+        {
+            drifted = true;
+            fire    = true;
+        }
+    }
+    id.drifted = drifted;
+
+    pthread_mutex_lock(&lock);
+    current = id;
+    pthread_mutex_unlock(&lock);
+
+    if (fire && on_drift)
+    {
+        on_drift(id);
+    }
+}
+
+Identification
+System_Id::
+estimate()
+{
+    pthread_mutex_lock(&lock);
+    Identification id = current;
+    pthread_mutex_unlock(&lock);
+    return id;
+}
@@ -0,0 +1,130 @@
+#ifndef SYSTEM_ID_H_
+#define SYSTEM_ID_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <functional>
+#include "telemetry.h"
+#include "plant_model.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+// ARX(2, 2) with dead time: y[k] = -a1 y[k-1] - a2 y[k-2]
+//                                  + b1 u[k-d] + b2 u[k-d-1] + c
+#define IDENT_PARAMS     5
+#define IDENT_DECIMATE   4      // telemetry samples averaged per update (40ms)
+#define IDENT_PERIOD     (IDENT_DECIMATE*TELEMETRY_TICK_PERIOD)
+#define IDENT_DELAY      ((int)(PLANT_DELAY/IDENT_PERIOD + 0.5)) // updates of IDENT_PERIOD (2)
+#define IDENT_FORGET     0.996  // forgetting factor, ~10s memory at 25Hz
+#define IDENT_P0         1e4    // initial covariance (scaled units)
+#define IDENT_TRACE_MAX  1e5    // covariance trace limit (windup without excitation)
+
+// nominal plant (plant_model.h), the model of the Smith predictor
+#define IDENT_NOMINAL_GAIN   PLANT_GAIN   // rpm/us
+#define IDENT_NOMINAL_POLE1  PLANT_POLE1  // 1/s
+#define IDENT_NOMINAL_POLE2  PLANT_POLE2
+
+#define IDENT_DRIFT      0.2    // relative gain change that asks for retuning
+#define IDENT_DRIFT_HOLD 5.0    // s the drift must last
+#define IDENT_SETTLE     3.0    // s of data before the estimate is trusted
+#define IDENT_EXCITATION 5.0    // us, pulse deviation needed to trust it
+
+// ------------------------------------------------------------------------------
+//   Types
+// ------------------------------------------------------------------------------
+
+struct Identification
+{
+    double   time;        // firmware time base of the last update
+    uint32_t updates;     // samples used since reset
+    bool     valid;       // enough data and excitation to trust the estimate
+
+    double   theta[IDENT_PARAMS]; // a1 a2 b1 b2 c (rpm, us)
+    double   gain;        // static gain, rpm/us
+    double   drift;       // gain/IDENT_NOMINAL_GAIN - 1
+    double   pole_re[2];  // discrete poles (IDENT_PERIOD)
+    double   pole_im[2];
+    double   s_re[2];     // continuous equivalents, 1/s
+    double   s_im[2];
+    double   error_rms;   // one step prediction error, rpm
+    double   excitation;  // pulse standard deviation, us
+    bool     drifted;     // |drift| > IDENT_DRIFT for IDENT_DRIFT_HOLD
+    int      retune_gain; // "gN" that keeps the loop gain nominal, %
+};
+
+
+// ----------------------------------------------------------------------------------
+//   System Id Class
+// ----------------------------------------------------------------------------------
+/*
+ * System Id Class
+ *
+ * Recursive least squares with exponential forgetting on the pulse/rpm
+ * telemetry. Samples are averaged in blocks of IDENT_DECIMATE: at 10ms
+ * the poles sit too close to z = 1 and the rpm noise in the regressor
+ * biases the estimate. Each block costs one O(n^2) covariance update
+ * (n = 5); values are scaled to krpm and 100us so P stays well
+ * conditioned, and the trace of P is bounded so it does not blow up while
+ * the input is constant. A gap in the firmware time base refills the
+ * regressor before updating again.
+ *
+ * update() runs on the telemetry thread; estimate() copies the last
+ * Identification under a mutex and reset() is applied by the next
+ * update(). on_drift is called from update() when the gain has drifted
+ * for IDENT_DRIFT_HOLD seconds with enough excitation (once per episode).
+ */
+class System_Id
+{
+
+public:
+
+    System_Id(int delay_ = IDENT_DELAY); // in updates of IDENT_PERIOD
+    ~System_Id();
+
+    void reset();
+    void update(const Telemetry_Sample &sample);
+    Identification estimate();
+
+    std::function<void(const Identification&)> on_drift;
+
+private:
+
+    int    delay;
+    double theta[IDENT_PARAMS];
+    double P[IDENT_PARAMS][IDENT_PARAMS];
+
+    // y[k-1], y[k-2] and u[k-1] .. u[k-MAXLAG]
+    enum { MAXLAG = 32 };
+    double y_hist[2];
+    double u_hist[MAXLAG];
+    int    filled;       // consecutive samples in the history
+    int    pending;      // telemetry samples in the current block
+    double y_sum;
+    double u_sum;
+    double last_time;
+
+    uint32_t updates;
+    double   start_time;
+    double   error2;     // smoothed squared prediction error (krpm^2)
+    double   u_mean;
+    double   u_var;
+    double   drift_since;
+    bool     drifted;
+
+    pthread_mutex_t lock;
+    Identification  current;
+    bool            reset_pending;
+
+    void clear();
+    void publish(double time);
+
+};
+
+
+#endif // SYSTEM_ID_H_
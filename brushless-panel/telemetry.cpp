@@ -0,0 +1,187 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Telemetry::
+Telemetry()
+{
+    reset();
+}
+
+void
+Telemetry::
+reset()
+{
+    received = 0;
+    dropped  = 0;
+    overruns = 0;
+    restarts = 0;
+
+    first     = true;
+    last_seq  = 0;
+    seq_base  = 0;
+    last_tick = 0;
+    tick_base = 0;
+    time_base = 0;
+
+    last_delay   = 0;
+    resync_pending = false;
+    jitter_sum2  = 0;
+    jitter_peak  = 0;
+    jitter_count = 0;
+}
+
+
+void
+Telemetry::
+resync()
+{
+    resync_pending = true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Parse Line
+// ------------------------------------------------------------------------------
+/**
+ * Returns true and fills sample if line is a telemetry sample. Any other
+ * line (firmware messages such as "*** idle 97.5% ***") returns false.
+ */
+bool
+Telemetry::
+parse_line(const std::string &line, double host_time, Telemetry_Sample &sample)
+{
+    unsigned seq, tick;
+    int rpm, setpoint, pulse;
+    char extra;
+
+    if (sscanf(line.c_str(), "%u\t%u\t%d\t%d\t%d %c", &seq, &tick, &rpm, &setpoint, &pulse, &extra) != 5)
+    {
+        return false;
+    }
+
+    if (first)
+    {
+        first = false;
+    }
+    else
+    {
+        uint16_t seq_gap  = (uint16_t)(seq - last_seq);
+        uint32_t tick_gap = tick - last_tick;
+
+        // --------------------------------------------------------------------------
+        //   FIRMWARE RESTART
+        // --------------------------------------------------------------------------
+        // seq and tick restart from zero: keep the time base going from the
+        // last sample instead of jumping back
+        if (seq_gap == 0 || seq_gap > 0x8000 || tick < last_tick)
+        {
+            restarts++;
+            seq_base  += last_seq + 1;
+            time_base += (last_tick - tick_base + 1)*TELEMETRY_TICK_PERIOD;
+            tick_base  = tick;
+            seq_base  -= seq;
+        }
+        else
+        {
+            dropped += seq_gap - 1;
+            if (tick_gap > seq_gap)
+            {
+                overruns += tick_gap - seq_gap;
+            }
+            if (seq < last_seq)
+            {
+                seq_base += 0x10000; // 16 bit wrap
+            }
+        }
+    }
+
+    if (received == 0)
+    {
+        tick_base = tick;
+    }
+
+    sample.seq       = seq_base + seq;
+    sample.tick      = tick;
+    sample.time      = time_base + (tick - tick_base)*TELEMETRY_TICK_PERIOD;
+    sample.host_time = host_time;
+    sample.rpm       = rpm;
+    sample.setpoint  = setpoint;
+    sample.pulse     = pulse;
+
+    // --------------------------------------------------------------------------
+    //   JITTER
+    // --------------------------------------------------------------------------
+    // change of the host delay between consecutive samples
+    double delay = host_time - sample.time;
+    if (received > 0 && !resync_pending)
+    {
+        double jitter = fabs(delay - last_delay);
+        jitter_sum2 += jitter*jitter;
+        jitter_count++;
+        if (jitter > jitter_peak)
+        {
+            jitter_peak = jitter;
+        }
+    }
+    last_delay = delay;
+    resync_pending = false;
+
+    last_seq  = seq;
+    last_tick = tick;
+    received++;
+
+    return true;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Statistics
+// ------------------------------------------------------------------------------
+double
+Telemetry::
+drop_rate() const
+{
+    if (received + dropped == 0)
+    {
+        return 0;
+    }
+    return (double)dropped/(received + dropped);
+}
+
+double
+Telemetry::
+jitter_rms() const
+{
+    if (jitter_count == 0)
+    {
+        return 0;
+    }
+    return sqrt(jitter_sum2/jitter_count);
+}
+
+double
+Telemetry::
+jitter_max() const
+{
+    return jitter_peak;
+}
+
+double
+Telemetry::
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
@@ -0,0 +1,92 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+// Firmware sampling period (one TIMER0_A1 tick), in seconds
+#define TELEMETRY_TICK_PERIOD 0.01
+
+
+// ------------------------------------------------------------------------------
+//   Sample
+// ------------------------------------------------------------------------------
+/*
+ * One telemetry line from the firmware, "seq\ttick\trpm\tsetpoint\tpulse".
+ * seq counts the lines the firmware sent and tick the 10ms sampling
+ * periods; both are unwrapped here so they never go backwards.
+ */
+struct Telemetry_Sample
+{
+    uint32_t seq;       // unwrapped line sequence
+    uint32_t tick;      // firmware sampling tick
+    double   time;      // firmware time base, seconds since the first sample
+    double   host_time; // host arrival time, seconds (CLOCK_MONOTONIC)
+    int      rpm;
+    int      setpoint;  // 0 in WRITE mode
+    int      pulse;     // servo pulse, us
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Telemetry Class
+// ----------------------------------------------------------------------------------
+/*
+ * Telemetry Class
+ *
+ * Parses the firmware telemetry lines and keeps link statistics: lines
+ * dropped between the firmware and the panel (gaps in seq), samples the
+ * firmware itself skipped (tick advancing more than seq) and the jitter of
+ * the host arrival times against the firmware time base. The time base of
+ * each sample comes from its tick, so plots and recordings keep the real
+ * 10ms spacing even when the host delivers lines late or in bursts.
+ */
+class Telemetry
+{
+
+public:
+
+    Telemetry();
+
+    void reset();
+    void resync(); // the link was down: no jitter across the gap
+
+    bool parse_line(const std::string &line, double host_time, Telemetry_Sample &sample);
+
+    uint32_t received;  // sample lines parsed
+    uint32_t dropped;   // lines lost on the link (seq gaps)
+    uint32_t overruns;  // ticks the firmware skipped
+    uint32_t restarts;  // firmware resets detected (seq/tick going back)
+
+    double drop_rate() const;
+    double jitter_rms() const;
+    double jitter_max() const;
+
+    static double now();
+
+private:
+
+    bool     first;
+    uint16_t last_seq;
+    uint32_t seq_base;
+    uint32_t last_tick;
+    uint32_t tick_base;    // tick of the first sample of this firmware run
+    double   time_base;    // time of the first sample of this firmware run
+    double   last_delay;   // host_time - time of the previous sample
+    bool     resync_pending;
+    double   jitter_sum2;
+    double   jitter_peak;
+    uint32_t jitter_count;
+
+};
+
+
+#endif // TELEMETRY_H_
@@ -0,0 +1,470 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "telemetry_server.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <poll.h>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Telemetry_Server::
+Telemetry_Server()
+{
+    slots = new Subscriber[SERVER_MAX_CLIENTS];
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        slots[i].active.store(false);
+        slots[i].fd = -1;
+    }
+    publishing.store(0);
+    active_count.store(0);
+
+    listen_fd = -1;
+    wake_fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC); // outlives publish()
+    started   = false;
+    quit.store(false);
+}
+
+Telemetry_Server::
+~Telemetry_Server()
+{
+    stop();
+    close(wake_fd);
+    delete[] slots;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Start / Stop
+// ------------------------------------------------------------------------------
+bool
+Telemetry_Server::
+start(const std::string &address)
+{
+    stop();
+
+    listen_fd = listen_local(address, unix_path);
+    if (listen_fd < 0)
+    {
+        return false;
+    }
+
+    quit.store(false);
+    if (pthread_create(&tid, NULL, &Telemetry_Server::start_server_thread, this))
+    {
+        fprintf(stderr, "telemetry server: could not start the thread\n");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    started = true;
+    fprintf(stderr, "SERVING TELEMETRY ON %s\n", address.c_str());
+    return true;
+}
+
+void
+Telemetry_Server::
+stop()
+{
+    if (!started)
+    {
+        return;
+    }
+    quit.store(true);
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+    pthread_join(tid, NULL);
+    started = false;
+
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        if (slots[i].active.load())
+        {
+            remove(slots[i]);
+        }
+    }
+    close(listen_fd);
+    listen_fd = -1;
+    if (!unix_path.empty())
+    {
+        unlink(unix_path.c_str());
+        unix_path.clear();
+    }
+}
+
+bool
+Telemetry_Server::
+running() const
+{
+    return started;
+}
+
+// ------------------------------------------------------------------------------
+//   Publish (ingest thread)
+// ------------------------------------------------------------------------------
+void
+Telemetry_Server::
+publish(const Telemetry_Sample &sample)
+{
+    if (active_count.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    Wire_Sample frame;
+    frame.type     = SERVER_FRAME_SAMPLE;
+    frame.size     = sizeof(Wire_Sample);
+    frame.seq      = sample.seq;
+    frame.tick     = sample.tick;
+    frame.rpm      = sample.rpm;
+    frame.setpoint = sample.setpoint;
+    frame.pulse    = sample.pulse;
+
+    bool wake = false;
+    publishing.fetch_add(1);
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        Subscriber &s = slots[i];
+        if (!s.active.load())
+        {
+            continue;
+        }
+        uint32_t head = s.head.load(std::memory_order_relaxed);
+        if (head - s.tail.load(std::memory_order_acquire) >= SERVER_RING)
+        {
+            s.lost++; // full: this subscriber is behind
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        frame.dropped = (uint16_t)std::min(s.lost, (uint32_t)0xffff);
+        s.ring[head % SERVER_RING] = frame;
+        s.lost = 0;
+        s.head.store(head + 1);
+
+        // the server drained this ring and may be asleep; otherwise it is
+        // still flushing and will see the new head (both sides seq_cst)
+        if (s.tail.load() == head)
+        {
+            wake = true;
+        }
+    }
+    publishing.fetch_add(1);
+
+    if (wake)
+    {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void
+Telemetry_Server::
+subscribers(std::vector<Subscriber_Stats> &out)
+{
+    out.clear();
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+    {
+        Subscriber &s = slots[i];
+        if (!s.active.load())
+        {
+            continue;
+        }
+        Subscriber_Stats stats;
+        stats.slot    = i;
+        stats.sent    = s.sent.load(std::memory_order_relaxed);
+        stats.dropped = s.dropped.load(std::memory_order_relaxed);
+        stats.queued  = s.head.load(std::memory_order_acquire) - s.tail.load(std::memory_order_acquire);
+        out.push_back(stats);
+    }
+}
+
+
+// ------------------------------------------------------------------------------
+//   Server Thread
+// ------------------------------------------------------------------------------
+void
+Telemetry_Server::
+run()
+{
+    trace_thread_name("telemetry server");
+
+    struct pollfd fds[2 + SERVER_MAX_CLIENTS];
+    int           slot_of[2 + SERVER_MAX_CLIENTS];
+    char          scratch[256];
+
+    while (!quit.load())
+    {
+        int n = 0;
+        fds[n].fd = wake_fd;   fds[n].events = POLLIN; n++;
+        fds[n].fd = listen_fd; fds[n].events = POLLIN; n++;
+        for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+        {
+            if (!slots[i].active.load())
+            {
+                continue;
+            }
+            fds[n].fd     = slots[i].fd;
+            fds[n].events = POLLIN | ((slots[i].out_pos < slots[i].out_len) ? POLLOUT : 0);
+            slot_of[n]    = i;
+            n++;
+        }
+
+        if (poll(fds, n, -1) < 0)
+        {
+            continue; // EINTR
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t count;
+            ssize_t drained = read(wake_fd, &count, sizeof(count));
+            (void)drained;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            accept_client();
+        }
+
+        // subscribers only send to hang up; anything else is ignored
+        for (int k = 2; k < n; k++)
+        {
+            Subscriber &s = slots[slot_of[k]];
+            if (fds[k].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                remove(s);
+                continue;
+            }
+            if (fds[k].revents & POLLIN)
+            {
+                ssize_t got = recv(s.fd, scratch, sizeof(scratch), MSG_DONTWAIT);
+                if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+                {
+                    remove(s);
+                }
+            }
+        }
+
+        for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+        {
+            if (slots[i].active.load() && !flush(slots[i]))
+            {
+                remove(slots[i]);
+            }
+        }
+    }
+}
+
+void
+Telemetry_Server::
+accept_client()
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    Subscriber *s = NULL;
+    for (int i = 0; i < SERVER_MAX_CLIENTS && !s; i++)
+    {
+        if (!slots[i].active.load())
+        {
+            s = &slots[i];
+        }
+    }
+    if (!s)
+    {
+        fprintf(stderr, "telemetry server: %d subscribers already, refused\n", SERVER_MAX_CLIENTS);
+        close(fd);
+        return;
+    }
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // fails on Unix sockets, harmless
+
+    // fits in any empty socket buffer
+    Wire_Hello hello;
+    memcpy(hello.magic, "BLTM", 4);
+    hello.version    = SERVER_VERSION;
+    hello.frame_size = sizeof(Wire_Sample);
+    hello.tick_us    = (uint16_t)(TELEMETRY_TICK_PERIOD*1e6 + 0.5);
+    if (send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello))
+    {
+        close(fd);
+        return;
+    }
+
+    s->fd      = fd;
+    s->head.store(0);
+    s->tail.store(0);
+    s->lost    = 0;
+    s->dropped.store(0);
+    s->sent.store(0);
+    s->out_len = 0;
+    s->out_pos = 0;
+    s->active.store(true); // publish() sees the fields above from here
+    active_count.fetch_add(1);
+}
+
+// server thread (or stop(), after it)
+void
+Telemetry_Server::
+remove(Subscriber &s)
+{
+    s.active.store(false);
+
+    // a publish() that saw it active may still be writing its ring
+    uint32_t walking = publishing.load();
+    if (walking & 1)
+    {
+        while (publishing.load() == walking)
+        {
+            sched_yield();
+        }
+    }
+
+    close(s.fd);
+    s.fd = -1;
+    active_count.fetch_sub(1);
+}
+
+// ring -> socket until either runs dry; false when the subscriber is gone
+bool
+Telemetry_Server::
+flush(Subscriber &s)
+{
+    while (true)
+    {
+        if (s.out_pos == s.out_len)
+        {
+            uint32_t tail  = s.tail.load(std::memory_order_relaxed);
+            uint32_t count = std::min(s.head.load() - tail, (uint32_t)SERVER_BATCH);
+            if (count == 0)
+            {
+                return true;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                s.out[i] = s.ring[(tail + i) % SERVER_RING];
+            }
+            s.tail.store(tail + count); // see publish()
+            s.out_len = count*sizeof(Wire_Sample);
+            s.out_pos = 0;
+        }
+
+        ssize_t n = send(s.fd, (const char*)s.out + s.out_pos, s.out_len - s.out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; // full: wait for POLLOUT
+        }
+        s.out_pos += n;
+        if (s.out_pos == s.out_len)
+        {
+            s.sent.fetch_add(s.out_len/sizeof(Wire_Sample), std::memory_order_relaxed);
+        }
+    }
+}
+
+void*
+Telemetry_Server::
+start_server_thread(void *args)
+{
+    Telemetry_Server *server = (Telemetry_Server*)args;
+    server->run();
+    return NULL;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Local sockets
+// ------------------------------------------------------------------------------
+// "unix:/path" or a path, "tcp:port" or a port (127.0.0.1 only)
+int
+listen_local(const std::string &address, std::string &unix_path)
+{
+    std::string where = address;
+    bool tcp;
+    if (where.compare(0, 4, "tcp:") == 0)
+    {
+        where = where.substr(4);
+        tcp   = true;
+    }
+    else if (where.compare(0, 5, "unix:") == 0)
+    {
+        where = where.substr(5);
+        tcp   = false;
+    }
+    else
+    {
+        tcp = !where.empty() && where.find_first_not_of("0123456789") == std::string::npos;
+    }
+
+    int fd;
+    if (tcp)
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons((uint16_t)atoi(where.c_str()));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            perror(address.c_str());
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (where.empty() || where.size() >= sizeof(addr.sun_path))
+        {
+            fprintf(stderr, "telemetry server: bad socket path %s\n", address.c_str());
+            return -1;
+        }
+        strcpy(addr.sun_path, where.c_str());
+        unlink(addr.sun_path); // left by an earlier run
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            perror(address.c_str());
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        unix_path = where;
+    }
+
+    if (listen(fd, SERVER_MAX_CLIENTS) < 0)
+    {
+        perror(address.c_str());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
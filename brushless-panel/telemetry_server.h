@@ -0,0 +1,141 @@
+#ifndef TELEMETRY_SERVER_H_
+#define TELEMETRY_SERVER_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "telemetry.h"
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define SERVER_MAX_CLIENTS 8
+#define SERVER_RING        1024   // frames per subscriber (10s at 100 Hz)
+#define SERVER_BATCH       64     // frames per send()
+#define SERVER_VERSION     1
+
+#define SERVER_FRAME_SAMPLE 1
+
+// ------------------------------------------------------------------------------
+//   Wire format
+// ------------------------------------------------------------------------------
+// Little endian (host order), no padding. A subscriber first gets one
+// Wire_Hello, then a Wire_Sample per sample.
+
+struct Wire_Hello
+{
+    char     magic[4];   // "BLTM"
+    uint8_t  version;    // SERVER_VERSION
+    uint8_t  frame_size; // sizeof(Wire_Sample)
+    uint16_t tick_us;    // firmware sampling period
+};
+
+struct Wire_Sample
+{
+    uint8_t  type;       // SERVER_FRAME_SAMPLE
+    uint8_t  size;       // sizeof(Wire_Sample)
+    uint16_t dropped;    // samples this subscriber lost right before this one (saturated)
+    uint32_t seq;
+    uint32_t tick;
+    int32_t  rpm;
+    int32_t  setpoint;
+    int32_t  pulse;
+};
+
+// listening socket for "unix:/path" (or a path) or "tcp:port" (or a port)
+// on 127.0.0.1; unix_path is set for the caller to unlink. -1 on errors.
+int listen_local(const std::string &address, std::string &unix_path);
+
+struct Subscriber_Stats
+{
+    int      slot;
+    uint32_t sent;       // frames handed to the socket
+    uint32_t dropped;    // frames lost to a full ring
+    uint32_t queued;     // frames in the ring now
+};
+
+
+// ----------------------------------------------------------------------------------
+//   Telemetry Server Class
+// ----------------------------------------------------------------------------------
+/*
+ * Telemetry Server Class
+ *
+ * Streams the decoded samples to local subscribers (loggers, scripts, a
+ * second panel) over a Unix socket ("unix:/path", or any path) or TCP on
+ * 127.0.0.1 ("tcp:port", or a bare port), so they all share the one
+ * serial link.
+ *
+ * publish() runs on the ingest thread (BrushlessSerial) and never waits:
+ * it copies the frame into the ring of each subscriber, or counts it as
+ * dropped when that ring is full. A server thread moves the rings to the
+ * sockets, so a slow subscriber only loses its own samples, and the gap
+ * shows in the "dropped" field of its next frame.
+ *
+ * Subscribers are fixed slots. The server thread is the only one to add
+ * or remove them; after taking a slot away it waits for a publish()
+ * already in progress to leave before the slot is reused.
+ */
+class Telemetry_Server
+{
+
+public:
+
+    Telemetry_Server();
+    ~Telemetry_Server();
+
+    bool start(const std::string &address); // false if it can't listen
+    void stop();
+    bool running() const;
+
+    void publish(const Telemetry_Sample &sample);
+
+    void subscribers(std::vector<Subscriber_Stats> &out);
+
+private:
+
+    struct Subscriber
+    {
+        std::atomic<bool>     active;
+        int                   fd;       // server thread
+        Wire_Sample           ring[SERVER_RING];
+        std::atomic<uint32_t> head;     // publish()
+        std::atomic<uint32_t> tail;     // server thread
+        uint32_t              lost;     // publish(): since the last queued frame
+        std::atomic<uint32_t> dropped;
+        std::atomic<uint32_t> sent;
+
+        // frames taken from the ring but not yet in the socket
+        Wire_Sample out[SERVER_BATCH];
+        size_t      out_len;            // bytes
+        size_t      out_pos;
+    };
+
+    Subscriber            *slots;
+    std::atomic<uint32_t>  publishing; // odd while publish() walks the slots
+    std::atomic<int>       active_count;
+
+    int         listen_fd;
+    int         wake_fd;   // eventfd: new frames, or stop()
+    std::string unix_path; // unlinked on stop()
+    pthread_t   tid;
+    bool        started;
+    std::atomic<bool> quit;
+
+    static void* start_server_thread(void *args);
+    void run();
+    void accept_client();
+    void remove(Subscriber &s);
+    bool flush(Subscriber &s);
+
+};
+
+
+#endif // TELEMETRY_SERVER_H_
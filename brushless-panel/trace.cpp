@@ -0,0 +1,319 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+// ------------------------------------------------------------------------------
+//   Rings
+// ------------------------------------------------------------------------------
+struct Trace_Slot
+{
+    std::atomic<const char*> name;
+    std::atomic<uint64_t>    start;
+    std::atomic<uint64_t>    end;
+};
+
+struct Trace_Buffer
+{
+    Trace_Slot            slots[TRACE_EVENTS];
+    std::atomic<uint64_t> claimed;   // bumped before a slot is written
+    std::atomic<uint64_t> committed; // bumped after
+    std::atomic<bool>     in_use;
+    int                   id;
+    char                  name[32];  // registry lock
+};
+
+// releases the ring when its thread exits
+struct Trace_Handle
+{
+    Trace_Buffer *buffer;
+
+    Trace_Handle() : buffer(NULL) {}
+    ~Trace_Handle()
+    {
+        if (buffer)
+        {
+            buffer->in_use.store(false);
+        }
+    }
+};
+
+std::atomic<bool> trace_on(false);
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<Trace_Buffer*> registry;
+static thread_local Trace_Handle handle;
+static thread_local char thread_name[32]; // until the ring exists
+
+// TSC against CLOCK_MONOTONIC, taken when tracing is first enabled
+static uint64_t base_ticks;
+static double   base_time;
+
+static double monotonic()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static Trace_Buffer* thread_buffer()
+{
+    if (handle.buffer)
+    {
+        return handle.buffer;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    Trace_Buffer *buffer = NULL;
+    for (size_t i = 0; i < registry.size() && !buffer; i++)
+    {
+        bool idle = false;
+        if (registry[i]->in_use.compare_exchange_strong(idle, true))
+        {
+            buffer = registry[i];
+        }
+    }
+    if (!buffer)
+    {
+        buffer = new Trace_Buffer();
+        buffer->claimed.store(0);
+        buffer->committed.store(0);
+        buffer->in_use.store(true);
+        buffer->id = (int)registry.size() + 1;
+        registry.push_back(buffer);
+    }
+    if (thread_name[0])
+    {
+        snprintf(buffer->name, sizeof(buffer->name), "%s", thread_name);
+    }
+    else
+    {
+        snprintf(buffer->name, sizeof(buffer->name), "thread %d", buffer->id);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    handle.buffer = buffer;
+    return buffer;
+}
+
+
+// ------------------------------------------------------------------------------
+//   Recording
+// ------------------------------------------------------------------------------
+uint64_t
+trace_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void
+trace_enable(bool on)
+{
+    pthread_mutex_lock(&registry_lock);
+    if (on && base_time == 0)
+    {
+        base_ticks = trace_now();
+        base_time  = monotonic();
+    }
+    pthread_mutex_unlock(&registry_lock);
+    trace_on.store(on);
+}
+
+// kept for the ring, which is only allocated on the first event
+void
+trace_thread_name(const char *name)
+{
+    snprintf(thread_name, sizeof(thread_name), "%s", name);
+    if (handle.buffer)
+    {
+        pthread_mutex_lock(&registry_lock);
+        snprintf(handle.buffer->name, sizeof(handle.buffer->name), "%s", name);
+        pthread_mutex_unlock(&registry_lock);
+    }
+}
+
+void
+trace_record(const char *name, uint64_t start, uint64_t end)
+{
+    Trace_Buffer *buffer = thread_buffer();
+
+    uint64_t n = buffer->claimed.load(std::memory_order_relaxed);
+    buffer->claimed.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Trace_Slot &slot = buffer->slots[n % TRACE_EVENTS];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+
+    buffer->committed.store(n + 1, std::memory_order_release);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Reading
+// ------------------------------------------------------------------------------
+struct Trace_Event
+{
+    const char *name;
+    uint64_t    start;
+    uint64_t    end;
+};
+
+// copies the events still in the ring, oldest first
+static void copy_ring(Trace_Buffer *buffer, std::vector<Trace_Event> &out)
+{
+    out.clear();
+    uint64_t last  = buffer->committed.load(std::memory_order_acquire);
+    uint64_t first = (last > TRACE_EVENTS) ? last - TRACE_EVENTS : 0;
+    for (uint64_t i = first; i < last; i++)
+    {
+        const Trace_Slot &slot = buffer->slots[i % TRACE_EVENTS];
+        Trace_Event e;
+        e.name  = slot.name.load(std::memory_order_relaxed);
+        e.start = slot.start.load(std::memory_order_relaxed);
+        e.end   = slot.end.load(std::memory_order_relaxed);
+        out.push_back(e);
+    }
+
+    // slots claimed meanwhile may have been overwritten under us
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = buffer->claimed.load(std::memory_order_relaxed);
+    if (claimed > first + TRACE_EVENTS)
+    {
+        size_t lost = std::min((size_t)(claimed - first - TRACE_EVENTS), out.size());
+        out.erase(out.begin(), out.begin() + lost);
+    }
+}
+
+// TSC ticks per microsecond, measured since tracing was enabled
+static double ticks_per_us(uint64_t ticks0, double time0)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    double elapsed = monotonic() - time0;
+    if (time0 == 0 || elapsed < 0.01)
+    {
+        struct timespec ts = {0, 20000000};
+        uint64_t t0 = trace_now();
+        double   m0 = monotonic();
+        nanosleep(&ts, NULL);
+        return (trace_now() - t0)/(1e6*(monotonic() - m0));
+    }
+    return (trace_now() - ticks0)/(1e6*elapsed);
+#else
+    return 1e3;
+#endif
+}
+
+static void registry_copy(std::vector<Trace_Buffer*> &buffers, std::vector<std::string> &names,
+                          uint64_t &ticks0, double &time0)
+{
+    pthread_mutex_lock(&registry_lock);
+    ticks0  = base_ticks;
+    time0   = base_time;
+    buffers = registry;
+    names.clear();
+    for (size_t i = 0; i < registry.size(); i++)
+    {
+        names.push_back(registry[i]->name);
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+bool
+trace_export(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    std::vector<Trace_Buffer*> buffers;
+    std::vector<std::string>   names;
+    std::vector<Trace_Event>   events;
+    uint64_t ticks0;
+    double   time0;
+    registry_copy(buffers, names, ticks0, time0);
+    const double rate = ticks_per_us(ticks0, time0);
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffers[b]->id, names[b].c_str());
+        first = false;
+
+        copy_ring(buffers[b], events);
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const Trace_Event &e = events[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.name, buffers[b]->id, ((double)e.start - (double)ticks0)/rate,
+                    (double)(e.end - e.start)/rate);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+void
+trace_stages(std::vector<Trace_Stage> &out)
+{
+    std::vector<Trace_Buffer*> buffers;
+    std::vector<std::string>   names;
+    std::vector<Trace_Event>   events;
+    uint64_t ticks0;
+    double   time0;
+    registry_copy(buffers, names, ticks0, time0);
+    const double rate = ticks_per_us(ticks0, time0);
+
+    std::map<std::string, std::vector<double> > durations;
+    std::map<std::string, const char*> literal;
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        copy_ring(buffers[b], events);
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            durations[events[i].name].push_back((events[i].end - events[i].start)/rate);
+            literal[events[i].name] = events[i].name;
+        }
+    }
+
+    out.clear();
+    for (std::map<std::string, std::vector<double> >::iterator it = durations.begin(); it != durations.end(); ++it)
+    {
+        std::vector<double> &d = it->second;
+        std::sort(d.begin(), d.end());
+        Trace_Stage s;
+        s.name  = literal[it->first];
+        s.count = (uint32_t)d.size();
+        s.p50   = d[(size_t)(0.50*(d.size() - 1))];
+        s.p90   = d[(size_t)(0.90*(d.size() - 1))];
+        s.p99   = d[(size_t)(0.99*(d.size() - 1))];
+        s.max   = d.back();
+        out.push_back(s);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// ------------------------------------------------------------------------------
+//   Defines
+// ------------------------------------------------------------------------------
+
+#define TRACE_EVENTS 16384 // per thread ring (oldest events are overwritten)
+
+// TRACE_SCOPE("stage"): one event from here to the end of the block. The
+// name must be a string literal (only the pointer is kept). Build with
+// -DTRACE_DISABLED to compile the trace points out.
+#ifdef TRACE_DISABLED
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace_Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#endif
+
+// ------------------------------------------------------------------------------
+//   Functions
+// ------------------------------------------------------------------------------
+/*
+ * Hot path tracing. Each thread writes its events to its own ring: the
+ * slot fields are relaxed atomics (plain stores on x86) and the head is
+ * published with a release store, so recording takes no lock and the
+ * exporter can read any ring while it is being written, discarding slots
+ * that were overwritten during the copy. Timestamps are TSC reads,
+ * converted to microseconds against CLOCK_MONOTONIC when exported.
+ *
+ * The rings are allocated on the first event of each thread and reused
+ * by later threads once their owner exits, so reopening the port does
+ * not grow memory.
+ */
+
+extern std::atomic<bool> trace_on;
+
+void     trace_enable(bool on);
+void     trace_thread_name(const char *name); // shown in the Chrome trace
+uint64_t trace_now();                         // TSC ticks
+void     trace_record(const char *name, uint64_t start, uint64_t end);
+
+// chrome://tracing / Perfetto "traceEvents" JSON of every ring
+bool     trace_export(const char *path);
+
+struct Trace_Stage
+{
+    const char *name;
+    uint32_t    count;
+    double      p50;   // us
+    double      p90;
+    double      p99;
+    double      max;
+};
+
+// duration percentiles per event name, over what the rings still hold
+void     trace_stages(std::vector<Trace_Stage> &out);
+
+// ----------------------------------------------------------------------------------
+//   Trace Scope Class
+// ----------------------------------------------------------------------------------
+class Trace_Scope
+{
+
+public:
+
+    Trace_Scope(const char *name_)
+    {
+        name  = name_;
+        start = trace_on.load(std::memory_order_relaxed) ? trace_now() : 0;
+    }
+
+    ~Trace_Scope()
+    {
+        if (start)
+        {
+            trace_record(name, start, trace_now());
+        }
+    }
+
+private:
+
+    const char *name;
+    uint64_t    start;
+
+};
+
+
+#endif // TRACE_H_
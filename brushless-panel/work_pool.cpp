@@ -0,0 +1,221 @@
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include "work_pool.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+
+// ------------------------------------------------------------------------------
+//   Con/De structors
+// ------------------------------------------------------------------------------
+Work_Pool::
+Work_Pool(int threads_)
+{
+    count = threads_ > 0 ? threads_ : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+    {
+        count = 1;
+    }
+
+    queues = new Queue[count];
+    for (int i = 0; i < count; i++)
+    {
+        pthread_mutex_init(&queues[i].lock, NULL);
+    }
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&start_cond, NULL);
+    pthread_cond_init(&done_cond, NULL);
+    generation = 0;
+    active     = 0;
+    quit       = false;
+    job        = NULL;
+    stolen.store(0);
+
+    for (int i = 1; i < count; i++)
+    {
+        Worker *worker = new Worker;
+        worker->pool = this;
+        worker->id   = i;
+        if (pthread_create(&worker->tid, NULL, &Work_Pool::start_worker, worker))
+        {
+            fprintf(stderr, "work pool: could not start a thread, %d of %d\n", i, count);
+            delete worker;
+            count = i;
+            break;
+        }
+        workers.push_back(worker);
+    }
+}
+
+Work_Pool::
+~Work_Pool()
+{
+    pthread_mutex_lock(&lock);
+    quit = true;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        pthread_join(workers[i]->tid, NULL);
+        delete workers[i];
+    }
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&start_cond);
+    pthread_mutex_destroy(&lock);
+    for (int i = 0; i < count; i++)
+    {
+        pthread_mutex_destroy(&queues[i].lock);
+    }
+    delete[] queues;
+}
+
+int
+Work_Pool::
+threads() const
+{
+    return count;
+}
+
+uint32_t
+Work_Pool::
+steals() const
+{
+    return stolen.load();
+}
+
+
+// ------------------------------------------------------------------------------
+//   Run
+// ------------------------------------------------------------------------------
+void
+Work_Pool::
+run(size_t tasks, const std::function<void(size_t, int)> &work_)
+{
+    stolen.store(0);
+
+    // contiguous runs: neighbouring tasks (files of the same session)
+    // stay on one thread unless stolen
+    for (int i = 0; i < count; i++)
+    {
+        size_t begin = tasks*i/count;
+        size_t end   = tasks*(i + 1)/count;
+        pthread_mutex_lock(&queues[i].lock);
+        for (size_t t = begin; t < end; t++)
+        {
+            queues[i].tasks.push_back(t);
+        }
+        pthread_mutex_unlock(&queues[i].lock);
+    }
+
+    pthread_mutex_lock(&lock);
+    job    = &work_;
+    active = count - 1;
+    generation++;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&lock);
+
+    work(0);
+
+    pthread_mutex_lock(&lock);
+    while (active > 0)
+    {
+        pthread_cond_wait(&done_cond, &lock);
+    }
+    job = NULL;
+    pthread_mutex_unlock(&lock);
+}
+
+
+// ------------------------------------------------------------------------------
+//   Workers
+// ------------------------------------------------------------------------------
+void*
+Work_Pool::
+start_worker(void *args)
+{
+    Worker *worker = (Worker*)args;
+    worker->pool->wait_batches(worker);
+    return NULL;
+}
+
+void
+Work_Pool::
+wait_batches(Worker *worker)
+{
+    trace_thread_name("work pool");
+
+    uint32_t seen = 0;
+    pthread_mutex_lock(&lock);
+    while (true)
+    {
+        while (generation == seen && !quit)
+        {
+            pthread_cond_wait(&start_cond, &lock);
+        }
+        if (quit)
+        {
+            break;
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        work(worker->id);
+
+        pthread_mutex_lock(&lock);
+        if (--active == 0)
+        {
+            pthread_cond_signal(&done_cond);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// no task is added during a batch: when every queue is empty the worker
+// is done with it
+void
+Work_Pool::
+work(int worker)
+{
+    size_t task;
+    while (take(worker, task))
+    {
+        (*job)(task, worker);
+    }
+}
+
+bool
+Work_Pool::
+take(int worker, size_t &task)
+{
+    Queue &own = queues[worker];
+    pthread_mutex_lock(&own.lock);
+    if (!own.tasks.empty())
+    {
+        task = own.tasks.front();
+        own.tasks.pop_front();
+        pthread_mutex_unlock(&own.lock);
+        return true;
+    }
+    pthread_mutex_unlock(&own.lock);
+
+    for (int k = 1; k < count; k++)
+    {
+        Queue &victim = queues[(worker + k) % count];
+        pthread_mutex_lock(&victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            pthread_mutex_unlock(&victim.lock);
+            stolen++;
+            return true;
+        }
+        pthread_mutex_unlock(&victim.lock);
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef WORK_POOL_H_
+#define WORK_POOL_H_
+
+// ------------------------------------------------------------------------------
+//   Includes
+// ------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+
+
+// ----------------------------------------------------------------------------------
+//   Work Pool Class
+// ----------------------------------------------------------------------------------
+/*
+ * Work Pool Class
+ *
+ * Runs a batch of independent tasks of very different costs (recordings
+ * of a few seconds next to ones of hours) on a fixed set of threads with
+ * work stealing. run() splits the task numbers in contiguous runs, one
+ * queue per worker; a worker takes from the front of its own queue and,
+ * when it is empty, steals from the back of another's, so the long tasks
+ * don't leave the other threads idle at the end.
+ *
+ * The threads are created once and wait between batches. The caller of
+ * run() works as worker 0 and returns when every task is done; run() is
+ * not reentrant.
+ */
+class Work_Pool
+{
+
+public:
+
+    Work_Pool(int threads = 0); // 0: one per CPU
+    ~Work_Pool();
+
+    int  threads() const;
+
+    // work(task, worker) for every task in [0, count)
+    void run(size_t count, const std::function<void(size_t, int)> &work);
+
+    uint32_t steals() const; // tasks taken from another worker, last run
+
+private:
+
+    struct Queue
+    {
+        pthread_mutex_t    lock;
+        std::deque<size_t> tasks;
+    };
+
+    struct Worker
+    {
+        Work_Pool *pool;
+        int        id;
+        pthread_t  tid;
+    };
+
+    int      count;
+    Queue   *queues;
+    std::vector<Worker*> workers; // 1 .. count-1, worker 0 is run()'s caller
+
+    pthread_mutex_t lock;
+    pthread_cond_t  start_cond;
+    pthread_cond_t  done_cond;
+    uint32_t generation; // of the batch, wakes the workers
+    int      active;     // workers still in this batch
+    bool     quit;
+    const std::function<void(size_t, int)> *job;
+    std::atomic<uint32_t> stolen;
+
+    static void* start_worker(void *args);
+    void wait_batches(Worker *worker);
+    void work(int worker);
+    bool take(int worker, size_t &task);
+
+};
+
+
+#endif // WORK_POOL_H_